@@ -0,0 +1,409 @@
+#include "assetpack.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include "hash.hpp"
+#include "programcache.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+AssetPack gAssetPack;
+
+static size_t
+alignToPack(size_t offset) {
+    return (offset + ASSET_PACK_ALIGNMENT - 1) & ~(size_t)(ASSET_PACK_ALIGNMENT - 1);
+}
+
+AssetPack::AssetPack() {
+    mLooseOverride = false;
+}
+
+std::string
+AssetPack::normalizePath(const std::string& filePath) {
+    std::string Normalized = filePath;
+    std::replace(Normalized.begin(), Normalized.end(), '\\', '/');
+    while (Normalized.compare(0, 2, "./") == 0) {
+        Normalized.erase(0, 2);
+    }
+    return Normalized;
+}
+
+bool
+AssetPack::Open(const std::string& packPath) {
+    Close();
+    if (!mFile.Open(packPath)) {
+        std::cout << "[Info] No asset pack at " << packPath << ", reading loose files" << std::endl;
+        return false;
+    }
+
+    AssetPackHeader Header;
+    if (mFile.Size() < sizeof(Header)) {
+        std::cerr << "[Err] Asset pack " << packPath << " is truncated" << std::endl;
+        Close();
+        return false;
+    }
+    memcpy(&Header, mFile.Data(), sizeof(Header));
+    size_t PathsOffset = sizeof(Header) + (size_t)Header.EntryCount * sizeof(AssetPackEntry);
+    if (Header.Magic != ASSET_PACK_MAGIC || Header.Version != ASSET_PACK_VERSION || PathsOffset + Header.PathBytes > mFile.Size()) {
+        std::cerr << "[Err] Asset pack " << packPath << " has an unknown format, run --pack again" << std::endl;
+        Close();
+        return false;
+    }
+
+    const char* Paths = (const char*)mFile.Data() + PathsOffset;
+    for (unsigned EntryIdx = 0; EntryIdx < Header.EntryCount; ++EntryIdx) {
+        AssetPackEntry Entry;
+        memcpy(&Entry, mFile.Data() + sizeof(Header) + EntryIdx * sizeof(Entry), sizeof(Entry));
+        if (Entry.PathOffset + Entry.PathLength > Header.PathBytes || Entry.Offset + Entry.Size > mFile.Size()) {
+            std::cerr << "[Err] Asset pack " << packPath << " is corrupt" << std::endl;
+            Close();
+            return false;
+        }
+        mEntries[std::string(Paths + Entry.PathOffset, Entry.PathLength)] = Entry;
+    }
+
+    std::cout << "[Info] Asset pack " << packPath << ": " << mEntries.size() << " files, " << mFile.Size() / 1024 << " KiB" << std::endl;
+    return true;
+}
+
+void
+AssetPack::Close() {
+    mEntries.clear();
+    mVerifiedBlobs.clear();
+    mFile.Close();
+}
+
+bool
+AssetPack::verifyBlob(const std::string& filePath, const AssetPackEntry& entry) const {
+    {
+        std::lock_guard<std::mutex> Lock(mVerifyMutex);
+        std::unordered_map<uint64_t, bool>::const_iterator VerifiedIt = mVerifiedBlobs.find(entry.Offset);
+        if (VerifiedIt != mVerifiedBlobs.end()) {
+            return VerifiedIt->second;
+        }
+    }
+
+    // NOTE: Hashed outside the lock, two threads opening the same blob at once both hash it
+    bool Intact = HashBytes(mFile.Data() + entry.Offset, entry.Size) == entry.Hash;
+    std::lock_guard<std::mutex> Lock(mVerifyMutex);
+    if (!Intact && !mVerifiedBlobs.count(entry.Offset)) {
+        std::cerr << "[Err] Packed file " << filePath << " is corrupt, reading it loose instead" << std::endl;
+    }
+    mVerifiedBlobs[entry.Offset] = Intact;
+    return Intact;
+}
+
+bool
+AssetPack::Find(const std::string& filePath, const unsigned char*& data, size_t& size) const {
+    if (mEntries.empty()) {
+        return false;
+    }
+
+    std::unordered_map<std::string, AssetPackEntry>::const_iterator EntryIt = mEntries.find(normalizePath(filePath));
+    if (EntryIt == mEntries.end()) {
+        return false;
+    }
+
+    if (!verifyBlob(filePath, EntryIt->second)) {
+        return false;
+    }
+
+    data = mFile.Data() + EntryIt->second.Offset;
+    size = EntryIt->second.Size;
+    return true;
+}
+
+void
+AssetPack::SetLooseOverride(bool enabled) {
+    mLooseOverride = enabled;
+}
+
+bool
+AssetPack::GetLooseOverride() const {
+    return mLooseOverride;
+}
+
+#ifdef _WIN32
+void
+AssetPack::listFiles(const std::string& directory, std::vector<std::string>& files) {
+    WIN32_FIND_DATAA FindData;
+    HANDLE Find = FindFirstFileA((directory + "/*").c_str(), &FindData);
+    if (Find == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    do {
+        std::string Name = FindData.cFileName;
+        if (Name == "." || Name == "..") {
+            continue;
+        }
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            listFiles(directory + "/" + Name, files);
+        } else {
+            files.push_back(directory + "/" + Name);
+        }
+    } while (FindNextFileA(Find, &FindData));
+    FindClose(Find);
+}
+#else
+void
+AssetPack::listFiles(const std::string& directory, std::vector<std::string>& files) {
+    DIR* Directory = opendir(directory.c_str());
+    if (!Directory) {
+        return;
+    }
+
+    while (dirent* Entry = readdir(Directory)) {
+        std::string Name = Entry->d_name;
+        if (Name == "." || Name == "..") {
+            continue;
+        }
+        struct stat EntryStat;
+        std::string Path = directory + "/" + Name;
+        if (stat(Path.c_str(), &EntryStat) != 0) {
+            continue;
+        }
+        if (S_ISDIR(EntryStat.st_mode)) {
+            listFiles(Path, files);
+        } else {
+            files.push_back(Path);
+        }
+    }
+    closedir(Directory);
+}
+#endif
+
+bool
+AssetPack::Build(const std::string& packPath, const std::vector<std::string>& directories) {
+    std::vector<std::string> Files;
+    for (unsigned DirectoryIdx = 0; DirectoryIdx < directories.size(); ++DirectoryIdx) {
+        // NOTE: Sorted per directory, so related files sit next to each other in the pack
+        size_t First = Files.size();
+        listFiles(normalizePath(directories[DirectoryIdx]), Files);
+        std::sort(Files.begin() + First, Files.end());
+    }
+
+    std::vector<AssetPackEntry> Entries;
+    std::vector<std::string> EntryPaths;
+    std::string Paths;
+    // NOTE: Blobs to write, in offset order. Duplicates point at an earlier blob instead
+    std::vector<unsigned> Blobs;
+    std::unordered_map<uint64_t, unsigned> BlobsByHash;
+    std::vector<MappedFile*> Sources;
+    for (unsigned FileIdx = 0; FileIdx < Files.size(); ++FileIdx) {
+        std::string Path = normalizePath(Files[FileIdx]);
+        if (Path == normalizePath(packPath)) {
+            continue;
+        }
+        // NOTE: Program binaries only load on the driver that built them, older builds left them next to the shaders
+        size_t ExtensionLength = strlen(PROGRAM_CACHE_EXTENSION);
+        if (Path.size() > ExtensionLength && !Path.compare(Path.size() - ExtensionLength, ExtensionLength, PROGRAM_CACHE_EXTENSION)) {
+            continue;
+        }
+        MappedFile* Source = new MappedFile();
+        if (!Source->Open(Files[FileIdx])) {
+            std::cout << "[Info] Skipping empty or unreadable file " << Files[FileIdx] << std::endl;
+            delete Source;
+            continue;
+        }
+
+        AssetPackEntry Entry;
+        Entry.Offset = 0;
+        Entry.Size = Source->Size();
+        Entry.Hash = HashBytes(Source->Data(), Source->Size());
+        Entry.PathOffset = Paths.size();
+        Entry.PathLength = Path.size();
+        Paths += Path;
+
+        std::unordered_map<uint64_t, unsigned>::iterator BlobIt = BlobsByHash.find(Entry.Hash);
+        if (BlobIt != BlobsByHash.end() && Entries[BlobIt->second].Size == Entry.Size
+            && !memcmp(Sources[BlobIt->second]->Data(), Source->Data(), Source->Size())) {
+            Entry.Offset = BlobIt->second;
+            delete Source;
+            Source = 0;
+        } else {
+            BlobsByHash[Entry.Hash] = Entries.size();
+            Blobs.push_back(Entries.size());
+        }
+        Entries.push_back(Entry);
+        Sources.push_back(Source);
+    }
+
+    // NOTE: Offsets are assigned once the table of contents size is known
+    size_t Offset = alignToPack(sizeof(AssetPackHeader) + Entries.size() * sizeof(AssetPackEntry) + Paths.size());
+    size_t PackedBytes = 0;
+    for (unsigned BlobIdx = 0; BlobIdx < Blobs.size(); ++BlobIdx) {
+        AssetPackEntry& Entry = Entries[Blobs[BlobIdx]];
+        Entry.Offset = Offset;
+        Offset = alignToPack(Offset + Entry.Size);
+        PackedBytes += Entry.Size;
+    }
+    for (unsigned EntryIdx = 0; EntryIdx < Entries.size(); ++EntryIdx) {
+        if (!Sources[EntryIdx]) {
+            Entries[EntryIdx].Offset = Entries[Entries[EntryIdx].Offset].Offset;
+        }
+    }
+
+    bool Success = false;
+    std::ofstream Out(packPath, std::ios::binary | std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to open asset pack for writing: " << packPath << std::endl;
+    } else {
+        AssetPackHeader Header = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, (uint32_t)Entries.size(), (uint32_t)Paths.size() };
+        Out.write((const char*)&Header, sizeof(Header));
+        Out.write((const char*)Entries.data(), Entries.size() * sizeof(AssetPackEntry));
+        Out.write(Paths.data(), Paths.size());
+        std::vector<char> Padding(ASSET_PACK_ALIGNMENT, 0);
+        for (unsigned BlobIdx = 0; BlobIdx < Blobs.size(); ++BlobIdx) {
+            const AssetPackEntry& Entry = Entries[Blobs[BlobIdx]];
+            Out.write(Padding.data(), Entry.Offset - (size_t)Out.tellp());
+            Out.write((const char*)Sources[Blobs[BlobIdx]]->Data(), Entry.Size);
+        }
+        Success = (bool)Out;
+        if (!Success) {
+            std::cerr << "[Err] Failed to write asset pack: " << packPath << std::endl;
+        } else {
+            std::cout << "[Info] Packed " << Entries.size() << " files (" << Entries.size() - Blobs.size() << " duplicates) into "
+                      << packPath << ", " << PackedBytes / 1024 << " KiB of data" << std::endl;
+        }
+    }
+
+    for (unsigned SourceIdx = 0; SourceIdx < Sources.size(); ++SourceIdx) {
+        delete Sources[SourceIdx];
+    }
+    return Success;
+}
+
+Asset::Asset() {
+    mData = 0;
+    mSize = 0;
+}
+
+bool
+Asset::Open(const std::string& filePath) {
+    bool Loose = gAssetPack.GetLooseOverride() && mLoose.Open(filePath);
+    if (!Loose && gAssetPack.Find(filePath, mData, mSize)) {
+        return true;
+    }
+    if (Loose || mLoose.Open(filePath)) {
+        mData = mLoose.Data();
+        mSize = mLoose.Size();
+        return true;
+    }
+    return false;
+}
+
+const unsigned char*
+Asset::Data() const {
+    return mData;
+}
+
+size_t
+Asset::Size() const {
+    return mSize;
+}
+
+/**
+ * @brief Read-only Assimp stream over an Asset
+ *
+ */
+class AssetIOStream : public Assimp::IOStream {
+public:
+    Asset mAsset;
+    size_t mPosition;
+
+    AssetIOStream() {
+        mPosition = 0;
+    }
+
+    size_t
+    Read(void* buffer, size_t size, size_t count) {
+        if (!size) {
+            return 0;
+        }
+        size_t Count = std::min(count, (mAsset.Size() - mPosition) / size);
+        memcpy(buffer, mAsset.Data() + mPosition, Count * size);
+        mPosition += Count * size;
+        return Count;
+    }
+
+    size_t
+    Write(const void*, size_t, size_t) {
+        return 0;
+    }
+
+    aiReturn
+    Seek(size_t offset, aiOrigin origin) {
+        size_t Base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? mPosition : mAsset.Size();
+        if (Base + offset > mAsset.Size()) {
+            return aiReturn_FAILURE;
+        }
+        mPosition = Base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t
+    Tell() const {
+        return mPosition;
+    }
+
+    size_t
+    FileSize() const {
+        return mAsset.Size();
+    }
+
+    void
+    Flush() {
+    }
+};
+
+/**
+ * @brief Lets Assimp open the model and the files it references (.mtl) from the pack
+ *
+ */
+class AssetIOSystem : public Assimp::IOSystem {
+public:
+    bool
+    Exists(const char* filePath) const {
+        Asset Probe;
+        return Probe.Open(filePath);
+    }
+
+    char
+    getOsSeparator() const {
+        return '/';
+    }
+
+    Assimp::IOStream*
+    Open(const char* filePath, const char* mode) {
+        if (strchr(mode, 'w') || strchr(mode, 'a')) {
+            return 0;
+        }
+        AssetIOStream* Stream = new AssetIOStream();
+        if (!Stream->mAsset.Open(filePath)) {
+            delete Stream;
+            return 0;
+        }
+        return Stream;
+    }
+
+    void
+    Close(Assimp::IOStream* stream) {
+        delete stream;
+    }
+};
+
+Assimp::IOSystem*
+AssetPack::CreateIOSystem() {
+    return new AssetIOSystem();
+}
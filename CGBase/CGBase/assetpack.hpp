@@ -0,0 +1,158 @@
+/**
+ * @file assetpack.hpp
+ * @brief Single-file asset pack, mapped once and read in place
+ *
+ * Layout: AssetPackHeader | AssetPackEntry[EntryCount] | path strings | blobs,
+ * with every blob starting on an ASSET_PACK_ALIGNMENT boundary.
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mappedfile.hpp"
+
+#define ASSET_PACK_MAGIC 0x4B504743 // NOTE: "CGPK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 4096
+#define ASSET_PACK_PATH "assets.cgpack"
+
+namespace Assimp {
+    class IOSystem;
+}
+
+struct AssetPackHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    uint32_t PathBytes;
+};
+
+struct AssetPackEntry {
+    uint64_t Offset;
+    uint64_t Size;
+    uint64_t Hash;
+    uint32_t PathOffset;
+    uint32_t PathLength;
+};
+
+class AssetPack {
+public:
+    AssetPack();
+
+    /**
+     * @brief Maps the pack and indexes its table of contents
+     *
+     * @param packPath Pack file path
+     *
+     * @returns true - Success, false - Missing or corrupt pack
+     */
+    bool Open(const std::string& packPath);
+
+    /**
+     * @brief Unmaps the pack. Spans handed out before become invalid
+     *
+     */
+    void Close();
+
+    /**
+     * @brief Looks up a packed file. Safe to call from worker threads once the pack is open.
+     * The first lookup of a blob checks it against its table of contents hash
+     *
+     * @param filePath File path as it would be opened loose, relative to the working directory
+     * @param data Output, start of the file inside the mapping
+     * @param size Output, file size
+     *
+     * @returns true - Found, false - Not in the pack, corrupt or no pack open
+     */
+    bool Find(const std::string& filePath, const unsigned char*& data, size_t& size) const;
+
+    /**
+     * @brief Makes loose files win over packed ones, for editing assets without repacking
+     *
+     * @param enabled Override state
+     */
+    void SetLooseOverride(bool enabled);
+
+    /**
+     * @brief Returns whether loose files win over packed ones
+     *
+     * @returns Override state
+     */
+    bool GetLooseOverride() const;
+
+    /**
+     * @brief Packs every file below the given directories. Identical files are stored once
+     *
+     * @param packPath Output pack path
+     * @param directories Directories to pack, relative to the working directory
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool Build(const std::string& packPath, const std::vector<std::string>& directories);
+
+    /**
+     * @brief Creates an Assimp IO handler that opens files through Asset. The importer owns it
+     *
+     * @returns IO handler
+     */
+    static Assimp::IOSystem* CreateIOSystem();
+
+private:
+    MappedFile mFile;
+    std::unordered_map<std::string, AssetPackEntry> mEntries;
+    bool mLooseOverride;
+    // NOTE: Blob offset to whether its hash matched, filled in by Find
+    mutable std::mutex mVerifyMutex;
+    mutable std::unordered_map<uint64_t, bool> mVerifiedBlobs;
+
+    bool verifyBlob(const std::string& filePath, const AssetPackEntry& entry) const;
+    static std::string normalizePath(const std::string& filePath);
+    static void listFiles(const std::string& directory, std::vector<std::string>& files);
+};
+
+extern AssetPack gAssetPack;
+
+/**
+ * @brief A file read from gAssetPack or, when it isn't packed, mapped loose. No copies either way
+ *
+ */
+class Asset {
+public:
+    Asset();
+
+    /**
+     * @brief Opens a file, from the pack unless the loose override is on
+     *
+     * @param filePath File path
+     *
+     * @returns true - Success, false - Neither packed nor readable loose
+     */
+    bool Open(const std::string& filePath);
+
+    /**
+     * @brief Returns the file contents, valid while the Asset and the pack are open
+     *
+     * @returns File bytes
+     */
+    const unsigned char* Data() const;
+
+    /**
+     * @brief Returns the file size
+     *
+     * @returns Size in bytes
+     */
+    size_t Size() const;
+
+private:
+    MappedFile mLoose;
+    const unsigned char* mData;
+    size_t mSize;
+
+    Asset(const Asset&);
+    Asset& operator=(const Asset&);
+};
@@ -0,0 +1,216 @@
+#include "bcencoder.hpp"
+#include <cstring>
+#include "simd.hpp"
+
+// NOTE: Maps the projection level (0 at the min endpoint) to palette indices
+static const unsigned char COLOR_LEVEL_INDEX[4] = { 1, 3, 2, 0 };
+
+static unsigned short
+pack565(const int* color) {
+    return (unsigned short)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void
+unpack565(unsigned short packed, int* color) {
+    int R = (packed >> 11) & 31;
+    int G = (packed >> 5) & 63;
+    int B = packed & 31;
+    color[0] = (R << 3) | (R >> 2);
+    color[1] = (G << 2) | (G >> 4);
+    color[2] = (B << 3) | (B >> 2);
+}
+
+/**
+ * @brief Shrinks the colour bounding box by 1/16 on each side, then snaps to 565.
+ * Writes both endpoints and returns the decoded ones through min/max
+ *
+ * @returns false - Endpoints collapsed to one colour, all indices are 0
+ */
+static bool
+fitColorEndpoints(int* minColor, int* maxColor, unsigned char* output) {
+    for (unsigned Channel = 0; Channel < 3; ++Channel) {
+        int Inset = (maxColor[Channel] - minColor[Channel]) >> 4;
+        minColor[Channel] += Inset;
+        maxColor[Channel] -= Inset;
+    }
+
+    unsigned short Color0 = pack565(maxColor);
+    unsigned short Color1 = pack565(minColor);
+    output[0] = Color0 & 0xFF;
+    output[1] = Color0 >> 8;
+    output[2] = Color1 & 0xFF;
+    output[3] = Color1 >> 8;
+    memset(output + 4, 0, 4);
+    unpack565(Color0, maxColor);
+    unpack565(Color1, minColor);
+    return Color0 != Color1;
+}
+
+static void
+writeColorIndices(const int* levels, unsigned char* output) {
+    unsigned Indices = 0;
+    for (unsigned PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+        Indices |= (unsigned)COLOR_LEVEL_INDEX[levels[PixelIdx]] << (PixelIdx * 2);
+    }
+    output[4] = Indices & 0xFF;
+    output[5] = (Indices >> 8) & 0xFF;
+    output[6] = (Indices >> 16) & 0xFF;
+    output[7] = Indices >> 24;
+}
+
+void
+BCEncoder::encodeColorBlock(const unsigned char* rgba, unsigned char* output) {
+    int Min[3] = { 255, 255, 255 };
+    int Max[3] = { 0, 0, 0 };
+    for (unsigned PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+        for (unsigned Channel = 0; Channel < 3; ++Channel) {
+            int Value = rgba[PixelIdx * 4 + Channel];
+            Min[Channel] = Value < Min[Channel] ? Value : Min[Channel];
+            Max[Channel] = Value > Max[Channel] ? Value : Max[Channel];
+        }
+    }
+    if (!fitColorEndpoints(Min, Max, output)) {
+        return;
+    }
+
+    // NOTE: Project onto the endpoint axis. Level = round(3 * t), done with exact integer
+    // thresholds so the SIMD path produces identical blocks
+    int Axis[3] = { Max[0] - Min[0], Max[1] - Min[1], Max[2] - Min[2] };
+    int AxisLength = Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2];
+    int Levels[16];
+    for (unsigned PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+        const unsigned char* P = rgba + PixelIdx * 4;
+        int Dot6 = 6 * ((P[0] - Min[0]) * Axis[0] + (P[1] - Min[1]) * Axis[1] + (P[2] - Min[2]) * Axis[2]);
+        Levels[PixelIdx] = (Dot6 >= AxisLength) + (Dot6 >= 3 * AxisLength) + (Dot6 >= 5 * AxisLength);
+    }
+    writeColorIndices(Levels, output);
+}
+
+void
+BCEncoder::encodeColorBlockSSE2(const unsigned char* rgba, unsigned char* output) {
+#ifdef CG_SSE2
+    __m128i Pixels[4];
+    for (unsigned RowIdx = 0; RowIdx < 4; ++RowIdx) {
+        Pixels[RowIdx] = _mm_loadu_si128((const __m128i*)(rgba + RowIdx * 16));
+    }
+
+    __m128i MinV = _mm_min_epu8(_mm_min_epu8(Pixels[0], Pixels[1]), _mm_min_epu8(Pixels[2], Pixels[3]));
+    __m128i MaxV = _mm_max_epu8(_mm_max_epu8(Pixels[0], Pixels[1]), _mm_max_epu8(Pixels[2], Pixels[3]));
+    MinV = _mm_min_epu8(MinV, _mm_shuffle_epi32(MinV, _MM_SHUFFLE(1, 0, 3, 2)));
+    MaxV = _mm_max_epu8(MaxV, _mm_shuffle_epi32(MaxV, _MM_SHUFFLE(1, 0, 3, 2)));
+    MinV = _mm_min_epu8(MinV, _mm_shuffle_epi32(MinV, _MM_SHUFFLE(2, 3, 0, 1)));
+    MaxV = _mm_max_epu8(MaxV, _mm_shuffle_epi32(MaxV, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned MinPacked = (unsigned)_mm_cvtsi128_si32(MinV);
+    unsigned MaxPacked = (unsigned)_mm_cvtsi128_si32(MaxV);
+    int Min[3] = { (int)(MinPacked & 0xFF), (int)((MinPacked >> 8) & 0xFF), (int)((MinPacked >> 16) & 0xFF) };
+    int Max[3] = { (int)(MaxPacked & 0xFF), (int)((MaxPacked >> 8) & 0xFF), (int)((MaxPacked >> 16) & 0xFF) };
+    if (!fitColorEndpoints(Min, Max, output)) {
+        return;
+    }
+
+    int AxisLength = (Max[0] - Min[0]) * (Max[0] - Min[0]) + (Max[1] - Min[1]) * (Max[1] - Min[1]) + (Max[2] - Min[2]) * (Max[2] - Min[2]);
+    __m128i Origin = _mm_setr_epi16(Min[0], Min[1], Min[2], 0, Min[0], Min[1], Min[2], 0);
+    __m128i Axis = _mm_setr_epi16(Max[0] - Min[0], Max[1] - Min[1], Max[2] - Min[2], 0, Max[0] - Min[0], Max[1] - Min[1], Max[2] - Min[2], 0);
+    __m128i Threshold1 = _mm_set1_epi32(AxisLength - 1);
+    __m128i Threshold2 = _mm_set1_epi32(3 * AxisLength - 1);
+    __m128i Threshold3 = _mm_set1_epi32(5 * AxisLength - 1);
+    __m128i Zero = _mm_setzero_si128();
+    int Levels[16];
+    for (unsigned RowIdx = 0; RowIdx < 4; ++RowIdx) {
+        // NOTE: madd leaves RG and BA partial sums per pixel, the float shuffles pair them up
+        __m128i Low = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(Pixels[RowIdx], Zero), Origin), Axis);
+        __m128i High = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(Pixels[RowIdx], Zero), Origin), Axis);
+        __m128i Even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(Low), _mm_castsi128_ps(High), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i Odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(Low), _mm_castsi128_ps(High), _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i Dot = _mm_add_epi32(Even, Odd);
+        __m128i Dot6 = _mm_add_epi32(_mm_slli_epi32(Dot, 2), _mm_slli_epi32(Dot, 1));
+        __m128i Level = _mm_add_epi32(_mm_add_epi32(_mm_cmpgt_epi32(Dot6, Threshold1), _mm_cmpgt_epi32(Dot6, Threshold2)), _mm_cmpgt_epi32(Dot6, Threshold3));
+        _mm_storeu_si128((__m128i*)(Levels + RowIdx * 4), _mm_sub_epi32(Zero, Level));
+    }
+    writeColorIndices(Levels, output);
+#else
+    encodeColorBlock(rgba, output);
+#endif
+}
+
+void
+BCEncoder::encodeValueBlock(const unsigned char* values, unsigned char* output) {
+    int Min = 255;
+    int Max = 0;
+    for (unsigned PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+        Min = values[PixelIdx] < Min ? values[PixelIdx] : Min;
+        Max = values[PixelIdx] > Max ? values[PixelIdx] : Max;
+    }
+
+    // NOTE: Max first selects the 8 value mode, interpolants 2-7 run from Max towards Min
+    output[0] = (unsigned char)Max;
+    output[1] = (unsigned char)Min;
+    unsigned long long Indices = 0;
+    int Range = Max - Min;
+    for (unsigned PixelIdx = 0; PixelIdx < 16 && Range; ++PixelIdx) {
+        int Offset14 = 14 * (values[PixelIdx] - Min);
+        int Level = 0;
+        for (int Step = 1; Step < 8; ++Step) {
+            Level += Offset14 >= (2 * Step - 1) * Range;
+        }
+        unsigned long long Index = Level == 0 ? 1 : Level == 7 ? 0 : 8 - Level;
+        Indices |= Index << (PixelIdx * 3);
+    }
+    for (unsigned ByteIdx = 0; ByteIdx < 6; ++ByteIdx) {
+        output[2 + ByteIdx] = (unsigned char)(Indices >> (ByteIdx * 8));
+    }
+}
+
+size_t
+BCEncoder::GetCompressedSize(BCFormat format, int width, int height) {
+    size_t BlockBytes = format == BC_FORMAT_BC1 || format == BC_FORMAT_BC4 ? 8 : 16;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes;
+}
+
+void
+BCEncoder::Encode(BCFormat format, const unsigned char* pixels, int width, int height, int channels, unsigned char* output, bool allowSIMD) {
+    unsigned char Block[64];
+    unsigned char Values[2][16];
+    for (int BlockY = 0; BlockY < height; BlockY += 4) {
+        for (int BlockX = 0; BlockX < width; BlockX += 4) {
+            for (int PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+                int X = BlockX + (PixelIdx & 3);
+                int Y = BlockY + (PixelIdx >> 2);
+                X = X < width ? X : width - 1;
+                Y = Y < height ? Y : height - 1;
+                const unsigned char* In = pixels + ((size_t)Y * width + X) * channels;
+                unsigned char* Out = Block + PixelIdx * 4;
+                Out[0] = In[0];
+                Out[1] = channels >= 3 ? In[1] : In[0];
+                Out[2] = channels >= 3 ? In[2] : In[0];
+                Out[3] = channels == 4 ? In[3] : channels == 2 ? In[1] : 255;
+                Values[0][PixelIdx] = In[0];
+                Values[1][PixelIdx] = channels >= 2 ? In[1] : 0;
+            }
+
+            switch (format) {
+            case BC_FORMAT_BC1:
+                allowSIMD ? encodeColorBlockSSE2(Block, output) : encodeColorBlock(Block, output);
+                output += 8;
+                break;
+            case BC_FORMAT_BC3:
+                for (unsigned PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+                    Values[0][PixelIdx] = Block[PixelIdx * 4 + 3];
+                }
+                encodeValueBlock(Values[0], output);
+                allowSIMD ? encodeColorBlockSSE2(Block, output + 8) : encodeColorBlock(Block, output + 8);
+                output += 16;
+                break;
+            case BC_FORMAT_BC4:
+                encodeValueBlock(Values[0], output);
+                output += 8;
+                break;
+            case BC_FORMAT_BC5:
+                encodeValueBlock(Values[0], output);
+                encodeValueBlock(Values[1], output + 8);
+                output += 16;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file bcencoder.hpp
+ * @brief CPU block compression (BC1, BC3, BC4, BC5) for GPU textures. Quality is that of a
+ * real-time range fit encoder, good enough for diffuse and specular maps
+ *
+ */
+
+#pragma once
+#include <cstddef>
+
+enum BCFormat {
+    // NOTE: RGB, 8 bytes per 4x4 block
+    BC_FORMAT_BC1 = 0,
+    // NOTE: RGBA, BC1 colour plus a BC4 alpha block, 16 bytes per block
+    BC_FORMAT_BC3 = 1,
+    // NOTE: Single channel, 8 bytes per block
+    BC_FORMAT_BC4 = 2,
+    // NOTE: Two independent BC4 channels, 16 bytes per block
+    BC_FORMAT_BC5 = 3,
+};
+
+class BCEncoder {
+public:
+    /**
+     * @brief Returns compressed size of one mip level
+     *
+     * @param format Block format
+     * @param width Level width in pixels
+     * @param height Level height in pixels
+     *
+     * @returns Size in bytes
+     */
+    static size_t GetCompressedSize(BCFormat format, int width, int height);
+
+    /**
+     * @brief Compresses one mip level. Partial edge blocks repeat the last row/column.
+     * Channels map as: BC1/BC3 - RGB(A), grey is replicated; BC4 - channel 0; BC5 - channels 0 and 1
+     *
+     * @param format Block format
+     * @param pixels Interleaved 8-bit pixels
+     * @param width Width in pixels
+     * @param height Height in pixels
+     * @param channels Channels per pixel, 1 to 4
+     * @param output Output blocks, GetCompressedSize bytes
+     * @param allowSIMD false forces the scalar encoder, used by the benchmark
+     */
+    static void Encode(BCFormat format, const unsigned char* pixels, int width, int height, int channels, unsigned char* output, bool allowSIMD = true);
+
+private:
+    static void encodeColorBlock(const unsigned char* rgba, unsigned char* output);
+    static void encodeColorBlockSSE2(const unsigned char* rgba, unsigned char* output);
+    static void encodeValueBlock(const unsigned char* values, unsigned char* output);
+};
@@ -0,0 +1,306 @@
+#include "benchmark.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "mesh.hpp"
+#include "bcencoder.hpp"
+#include "mipbuilder.hpp"
+#include "frustumculler.hpp"
+
+static const unsigned PACKING_VERTEX_COUNT = 250000;
+static const unsigned PACKING_ITERATIONS = 20;
+static const int COMPRESSION_IMAGE_SIZE = 1024;
+static const unsigned COMPRESSION_ITERATIONS = 10;
+static const int MIP_IMAGE_SIZE = 2048;
+static const unsigned MIP_ITERATIONS = 5;
+static const unsigned CULLING_OBJECT_COUNT = 100000;
+static const unsigned CULLING_ITERATIONS = 100;
+// NOTE: Objects are scattered in a cube of this half size around the camera
+static const float CULLING_WORLD_SIZE = 500.0f;
+
+static double
+secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Fills an Assimp mesh with a deterministic pseudo-random triangle soup
+ *
+ */
+static void
+fillSyntheticMesh(aiMesh& mesh, unsigned vertexCount) {
+    mesh.mNumVertices = vertexCount;
+    mesh.mVertices = new aiVector3D[vertexCount];
+    mesh.mNormals = new aiVector3D[vertexCount];
+    mesh.mTextureCoords[0] = new aiVector3D[vertexCount];
+    unsigned Seed = 12345;
+    for (unsigned VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        float Values[8];
+        for (unsigned ValueIdx = 0; ValueIdx < 8; ++ValueIdx) {
+            Seed = Seed * 1664525u + 1013904223u;
+            Values[ValueIdx] = (Seed >> 8) / (float)(1 << 24);
+        }
+        mesh.mVertices[VertexIdx] = aiVector3D(Values[0], Values[1], Values[2]);
+        mesh.mNormals[VertexIdx] = aiVector3D(Values[3], Values[4], Values[5]);
+        mesh.mTextureCoords[0][VertexIdx] = aiVector3D(Values[6], Values[7], 0.0f);
+    }
+}
+
+/**
+ * @brief The packing loop Mesh used before the single-pass kernel, kept as the baseline
+ *
+ */
+static void
+packVerticesLegacy(const aiMesh* mesh, std::vector<float>& vertices) {
+    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+    for (unsigned VertexIndex = 0; VertexIndex < mesh->mNumVertices; ++VertexIndex) {
+        std::vector<float> Position = { mesh->mVertices[VertexIndex].x, mesh->mVertices[VertexIndex].y, mesh->mVertices[VertexIndex].z };
+        vertices.insert(vertices.end(), Position.begin(), Position.end());
+        std::vector<float> Normals = { mesh->mNormals[VertexIndex].x, mesh->mNormals[VertexIndex].y, mesh->mNormals[VertexIndex].z };
+        vertices.insert(vertices.end(), Normals.begin(), Normals.end());
+        const aiVector3D* TexCoords = mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][VertexIndex]) : &Zero3D;
+        std::vector<float> UV = { TexCoords->x, TexCoords->y };
+        vertices.insert(vertices.end(), UV.begin(), UV.end());
+    }
+}
+
+void
+Benchmark::vertexPacking() {
+    aiMesh SyntheticMesh;
+    fillSyntheticMesh(SyntheticMesh, PACKING_VERTEX_COUNT);
+    double TotalVertices = (double)PACKING_VERTEX_COUNT * PACKING_ITERATIONS;
+
+    std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+    for (unsigned Iteration = 0; Iteration < PACKING_ITERATIONS; ++Iteration) {
+        std::vector<float> Vertices;
+        packVerticesLegacy(&SyntheticMesh, Vertices);
+    }
+    double LegacySeconds = secondsSince(StartTime);
+
+    std::vector<float> Packed;
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
+    StartTime = std::chrono::steady_clock::now();
+    for (unsigned Iteration = 0; Iteration < PACKING_ITERATIONS; ++Iteration) {
+        std::vector<float> Vertices((size_t)PACKING_VERTEX_COUNT * MESH_VERTEX_FLOATS);
+        Mesh::PackVertices(&SyntheticMesh, Vertices.data(), BoundsMin, BoundsMax);
+        Packed.swap(Vertices);
+    }
+    double PackedSeconds = secondsSince(StartTime);
+
+    std::vector<float> Reference;
+    packVerticesLegacy(&SyntheticMesh, Reference);
+    bool Matches = Reference == Packed;
+
+    std::cout << "Vertex packing, " << PACKING_VERTEX_COUNT << " vertices x " << PACKING_ITERATIONS << std::endl
+              << "    legacy:      " << TotalVertices / LegacySeconds / 1e6 << " Mvertices/s" << std::endl
+              << "    single pass: " << TotalVertices / PackedSeconds / 1e6 << " Mvertices/s ("
+              << LegacySeconds / PackedSeconds << "x)" << std::endl
+              << "    output " << (Matches ? "matches" : "DOES NOT match") << " legacy packing" << std::endl;
+}
+
+/**
+ * @brief Fills an RGB image with smooth gradients plus noise, roughly like a photo texture
+ *
+ */
+static void
+fillSyntheticImage(std::vector<unsigned char>& pixels, int size) {
+    pixels.resize((size_t)size * size * 3);
+    unsigned Seed = 12345;
+    for (int Y = 0; Y < size; ++Y) {
+        for (int X = 0; X < size; ++X) {
+            Seed = Seed * 1664525u + 1013904223u;
+            int Noise = (int)(Seed >> 28) - 8;
+            unsigned char* P = &pixels[((size_t)Y * size + X) * 3];
+            P[0] = (unsigned char)glm::clamp(X * 255 / size + Noise, 0, 255);
+            P[1] = (unsigned char)glm::clamp(Y * 255 / size + Noise, 0, 255);
+            P[2] = (unsigned char)glm::clamp(((X ^ Y) & 255) / 2 + 64 + Noise, 0, 255);
+        }
+    }
+}
+
+/**
+ * @brief Decodes BC1 blocks back to RGB for error measurement
+ *
+ */
+static double
+measureBC1PSNR(const std::vector<unsigned char>& pixels, const std::vector<unsigned char>& blocks, int size) {
+    double SquaredError = 0.0;
+    const unsigned char* Block = blocks.data();
+    for (int BlockY = 0; BlockY < size; BlockY += 4) {
+        for (int BlockX = 0; BlockX < size; BlockX += 4) {
+            int Palette[4][3];
+            unsigned Colors[2] = { (unsigned)(Block[0] | Block[1] << 8), (unsigned)(Block[2] | Block[3] << 8) };
+            for (unsigned Endpoint = 0; Endpoint < 2; ++Endpoint) {
+                int R = (Colors[Endpoint] >> 11) & 31, G = (Colors[Endpoint] >> 5) & 63, B = Colors[Endpoint] & 31;
+                Palette[Endpoint][0] = (R << 3) | (R >> 2);
+                Palette[Endpoint][1] = (G << 2) | (G >> 4);
+                Palette[Endpoint][2] = (B << 3) | (B >> 2);
+            }
+            for (unsigned Channel = 0; Channel < 3; ++Channel) {
+                Palette[2][Channel] = (2 * Palette[0][Channel] + Palette[1][Channel]) / 3;
+                Palette[3][Channel] = (Palette[0][Channel] + 2 * Palette[1][Channel]) / 3;
+            }
+            unsigned Indices = Block[4] | Block[5] << 8 | Block[6] << 16 | (unsigned)Block[7] << 24;
+            for (int PixelIdx = 0; PixelIdx < 16; ++PixelIdx) {
+                const unsigned char* P = &pixels[((size_t)(BlockY + PixelIdx / 4) * size + BlockX + PixelIdx % 4) * 3];
+                const int* Decoded = Palette[(Indices >> (PixelIdx * 2)) & 3];
+                for (unsigned Channel = 0; Channel < 3; ++Channel) {
+                    double Error = P[Channel] - Decoded[Channel];
+                    SquaredError += Error * Error;
+                }
+            }
+            Block += 8;
+        }
+    }
+
+    double MSE = SquaredError / ((double)size * size * 3);
+    return 10.0 * log10(255.0 * 255.0 / MSE);
+}
+
+void
+Benchmark::blockCompression() {
+    std::vector<unsigned char> Pixels;
+    fillSyntheticImage(Pixels, COMPRESSION_IMAGE_SIZE);
+    size_t CompressedSize = BCEncoder::GetCompressedSize(BC_FORMAT_BC1, COMPRESSION_IMAGE_SIZE, COMPRESSION_IMAGE_SIZE);
+    std::vector<unsigned char> Scalar(CompressedSize);
+    std::vector<unsigned char> SIMD(CompressedSize);
+    double TotalPixels = (double)COMPRESSION_IMAGE_SIZE * COMPRESSION_IMAGE_SIZE * COMPRESSION_ITERATIONS;
+
+    std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+    for (unsigned Iteration = 0; Iteration < COMPRESSION_ITERATIONS; ++Iteration) {
+        BCEncoder::Encode(BC_FORMAT_BC1, Pixels.data(), COMPRESSION_IMAGE_SIZE, COMPRESSION_IMAGE_SIZE, 3, Scalar.data(), false);
+    }
+    double ScalarSeconds = secondsSince(StartTime);
+
+    StartTime = std::chrono::steady_clock::now();
+    for (unsigned Iteration = 0; Iteration < COMPRESSION_ITERATIONS; ++Iteration) {
+        BCEncoder::Encode(BC_FORMAT_BC1, Pixels.data(), COMPRESSION_IMAGE_SIZE, COMPRESSION_IMAGE_SIZE, 3, SIMD.data());
+    }
+    double SIMDSeconds = secondsSince(StartTime);
+
+    std::cout << "BC1 compression, " << COMPRESSION_IMAGE_SIZE << "x" << COMPRESSION_IMAGE_SIZE << " RGB x " << COMPRESSION_ITERATIONS << std::endl
+              << "    scalar: " << TotalPixels / ScalarSeconds / 1e6 << " Mpixels/s" << std::endl
+              << "    SIMD:   " << TotalPixels / SIMDSeconds / 1e6 << " Mpixels/s (" << ScalarSeconds / SIMDSeconds << "x)" << std::endl
+              << "    size " << Pixels.size() / 1024 << " KiB -> " << CompressedSize / 1024 << " KiB, PSNR "
+              << measureBC1PSNR(Pixels, SIMD, COMPRESSION_IMAGE_SIZE) << " dB" << std::endl
+              << "    output " << (Scalar == SIMD ? "matches" : "DOES NOT match") << " scalar encoder" << std::endl;
+}
+
+void
+Benchmark::mipGeneration() {
+    std::vector<unsigned char> RGB;
+    fillSyntheticImage(RGB, MIP_IMAGE_SIZE);
+    size_t PixelCount = (size_t)MIP_IMAGE_SIZE * MIP_IMAGE_SIZE;
+    double TotalPixels = (double)PixelCount * MIP_ITERATIONS;
+    std::cout << "Mip chain generation, " << MIP_IMAGE_SIZE << "x" << MIP_IMAGE_SIZE << " x " << MIP_ITERATIONS << std::endl;
+
+    const int ChannelCounts[3] = { 1, 3, 4 };
+    for (unsigned CountIdx = 0; CountIdx < 3; ++CountIdx) {
+        int Channels = ChannelCounts[CountIdx];
+        std::vector<unsigned char> Pixels(PixelCount * Channels);
+        for (size_t PixelIdx = 0; PixelIdx < PixelCount; ++PixelIdx) {
+            for (int Channel = 0; Channel < Channels; ++Channel) {
+                // NOTE: Alpha reuses the blue pattern so it isn't constant
+                Pixels[PixelIdx * Channels + Channel] = RGB[PixelIdx * 3 + (Channel < 3 ? Channel : 2)];
+            }
+        }
+
+        std::vector<unsigned char> Scalar;
+        std::vector<unsigned char> SIMD;
+        std::vector<unsigned> LevelSizes;
+        std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+        for (unsigned Iteration = 0; Iteration < MIP_ITERATIONS; ++Iteration) {
+            MipBuilder::Build(Pixels.data(), MIP_IMAGE_SIZE, MIP_IMAGE_SIZE, Channels, Channels > 1, Scalar, LevelSizes, false);
+        }
+        double ScalarSeconds = secondsSince(StartTime);
+
+        StartTime = std::chrono::steady_clock::now();
+        for (unsigned Iteration = 0; Iteration < MIP_ITERATIONS; ++Iteration) {
+            MipBuilder::Build(Pixels.data(), MIP_IMAGE_SIZE, MIP_IMAGE_SIZE, Channels, Channels > 1, SIMD, LevelSizes);
+        }
+        double SIMDSeconds = secondsSince(StartTime);
+
+        std::cout << "    " << Channels << " channel" << (Channels > 1 ? "s" : " ") << ", " << LevelSizes.size() << " levels" << std::endl
+                  << "        scalar: " << TotalPixels / ScalarSeconds / 1e6 << " Mpixels/s" << std::endl
+                  << "        SIMD:   " << TotalPixels / SIMDSeconds / 1e6 << " Mpixels/s (" << ScalarSeconds / SIMDSeconds << "x)" << std::endl
+                  << "        output " << (Scalar == SIMD ? "matches" : "DOES NOT match") << " scalar kernels" << std::endl;
+    }
+}
+
+void
+Benchmark::frustumCulling() {
+    FrustumCuller Culler;
+    unsigned Seed = 12345;
+    for (unsigned ObjectIdx = 0; ObjectIdx < CULLING_OBJECT_COUNT; ++ObjectIdx) {
+        float Values[5];
+        for (unsigned ValueIdx = 0; ValueIdx < 5; ++ValueIdx) {
+            Seed = Seed * 1664525u + 1013904223u;
+            Values[ValueIdx] = (Seed >> 8) / (float)(1 << 24);
+        }
+        glm::vec3 Position = glm::vec3(Values[0] * 2.0f - 1.0f, Values[1] * 2.0f - 1.0f, Values[2] * 2.0f - 1.0f) * CULLING_WORLD_SIZE;
+        glm::vec3 Size = glm::vec3(0.5f + Values[3] * 4.0f, 0.5f + Values[4] * 4.0f, 1.0f);
+        glm::mat4 Model = glm::scale(glm::translate(glm::mat4(1.0f), Position), Size);
+        Culler.Add(Bounds::FromBox(glm::vec3(-0.5f), glm::vec3(0.5f)), Model);
+    }
+
+    glm::mat4 Projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, CULLING_WORLD_SIZE);
+    glm::mat4 View = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.3f, 0.1f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum ViewFrustum = Frustum::FromMatrix(Projection * View);
+    double TotalObjects = (double)CULLING_OBJECT_COUNT * CULLING_ITERATIONS;
+
+    std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+    for (unsigned Iteration = 0; Iteration < CULLING_ITERATIONS; ++Iteration) {
+        Culler.Cull(ViewFrustum, false);
+    }
+    double ScalarSeconds = secondsSince(StartTime);
+    std::vector<bool> Scalar(CULLING_OBJECT_COUNT);
+    for (unsigned ObjectIdx = 0; ObjectIdx < CULLING_OBJECT_COUNT; ++ObjectIdx) {
+        Scalar[ObjectIdx] = Culler.IsVisible(ObjectIdx);
+    }
+
+    StartTime = std::chrono::steady_clock::now();
+    for (unsigned Iteration = 0; Iteration < CULLING_ITERATIONS; ++Iteration) {
+        Culler.Cull(ViewFrustum);
+    }
+    double SIMDSeconds = secondsSince(StartTime);
+    unsigned Mismatches = 0;
+    for (unsigned ObjectIdx = 0; ObjectIdx < CULLING_OBJECT_COUNT; ++ObjectIdx) {
+        Mismatches += Scalar[ObjectIdx] != Culler.IsVisible(ObjectIdx);
+    }
+
+    std::cout << "Frustum culling, " << CULLING_OBJECT_COUNT << " objects x " << CULLING_ITERATIONS << std::endl
+              << "    scalar: " << TotalObjects / ScalarSeconds / 1e6 << " Mobjects/s" << std::endl
+              << "    SIMD:   " << TotalObjects / SIMDSeconds / 1e6 << " Mobjects/s (" << ScalarSeconds / SIMDSeconds << "x)" << std::endl
+              << "    " << Culler.GetVisibleCount() << " visible, " << CULLING_OBJECT_COUNT - Culler.GetVisibleCount() << " culled" << std::endl
+              << "    output " << (Mismatches ? "DOES NOT match" : "matches") << " scalar culling" << std::endl;
+}
+
+bool
+Benchmark::Run(const std::string& name) {
+    bool All = name == "all";
+    bool Found = false;
+    if (All || name == "packing") {
+        vertexPacking();
+        Found = true;
+    }
+    if (All || name == "compression") {
+        blockCompression();
+        Found = true;
+    }
+    if (All || name == "mips") {
+        mipGeneration();
+        Found = true;
+    }
+    if (All || name == "culling") {
+        frustumCulling();
+        Found = true;
+    }
+
+    if (!Found) {
+        std::cerr << "[Err] Unknown benchmark: " << name << std::endl;
+    }
+    return Found;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file benchmark.hpp
+ * @brief Offline micro-benchmarks, run with: CGBase --bench <name>
+ * None of them need a window or GL context
+ *
+ */
+
+#pragma once
+#include <string>
+
+class Benchmark {
+public:
+    /**
+     * @brief Runs the benchmark with the given name and prints results
+     *
+     * @param name Benchmark name, "all" runs every benchmark
+     *
+     * @returns true - Benchmark found and run, false - Unknown name
+     */
+    static bool Run(const std::string& name);
+
+private:
+    static void vertexPacking();
+    static void blockCompression();
+    static void mipGeneration();
+    static void frustumCulling();
+};
@@ -0,0 +1,51 @@
+#include "framestats.hpp"
+#include <iostream>
+
+FrameStats gFrameStats;
+
+FrameStats::FrameStats() {
+    Reset();
+}
+
+void
+FrameStats::Reset() {
+    MeshletsTested = 0;
+    MeshletsBackfaceCulled = 0;
+    MeshletsFrustumCulled = 0;
+    TrianglesTested = 0;
+    TrianglesCulled = 0;
+    TrianglesLODSkipped = 0;
+    TextureBytesStreamed = 0;
+    DrawCalls = 0;
+    DrawPackets = 0;
+    InstancesDrawn = 0;
+    InstanceBytes = 0;
+    IndirectCommands = 0;
+    TextureBinds = 0;
+    TextureBindsSkipped = 0;
+    UniformLocationLookups = 0;
+    UniformBufferUpdates = 0;
+    UniformBufferBytes = 0;
+    StateCalls = 0;
+    StateCallsSkipped = 0;
+    ObjectsTested = 0;
+    ObjectsCulled = 0;
+}
+
+void
+FrameStats::Print() const {
+    std::cout << "[Stats] Objects: " << ObjectsTested << " tested, " << ObjectsCulled << " frustum culled, "
+              << ObjectsTested - ObjectsCulled << " drawn" << std::endl;
+    if (TrianglesTested) {
+        std::cout << "[Stats] Meshlets: " << MeshletsTested << " tested, " << MeshletsBackfaceCulled << " backface culled, "
+                  << MeshletsFrustumCulled << " frustum culled. Triangles culled: " << TrianglesCulled << "/" << TrianglesTested
+                  << " (" << 100.0f * TrianglesCulled / TrianglesTested << "%), " << TrianglesLODSkipped << " skipped by LOD" << std::endl;
+    }
+    std::cout << "[Stats] Draws: " << DrawCalls << " from " << DrawPackets << " packets (" << InstancesDrawn << " instances, " << InstanceBytes << " bytes, " << IndirectCommands << " indirect commands), texture binds: " << TextureBinds << " (" << TextureBindsSkipped << " redundant skipped), uniform location lookups: "
+              << UniformLocationLookups << std::endl;
+    std::cout << "[Stats] Uniform buffer updates: " << UniformBufferUpdates << " (" << UniformBufferBytes << " bytes), GL state calls: "
+              << StateCalls << " issued, " << StateCallsSkipped << " redundant skipped" << std::endl;
+    if (TextureBytesStreamed) {
+        std::cout << "[Stats] Textures streamed: " << TextureBytesStreamed / 1024 << " KiB" << std::endl;
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * @file framestats.hpp
+ * @brief Per-frame renderer counters, reset at the start of every frame
+ *
+ */
+
+#pragma once
+#include <cstddef>
+
+struct FrameStats {
+    // NOTE: Objects (cubes, model meshes) tested by FrustumCuller, drawn ones are the difference
+    unsigned ObjectsTested;
+    unsigned ObjectsCulled;
+    unsigned MeshletsTested;
+    unsigned MeshletsBackfaceCulled;
+    unsigned MeshletsFrustumCulled;
+    unsigned TrianglesTested;
+    unsigned TrianglesCulled;
+    // NOTE: Full detail triangles not drawn because a coarser LOD was selected
+    unsigned TrianglesLODSkipped;
+    size_t TextureBytesStreamed;
+    unsigned DrawCalls;
+    // NOTE: Packets sorted and issued by the render queue
+    unsigned DrawPackets;
+    // NOTE: Copies drawn by instanced draws, each of those counts once in DrawCalls
+    unsigned InstancesDrawn;
+    size_t InstanceBytes;
+    // NOTE: Commands issued by multi-draw indirect calls, each call counts once in DrawCalls
+    unsigned IndirectCommands;
+    unsigned TextureBinds;
+    // NOTE: Binds of a texture that was already bound to the unit
+    unsigned TextureBindsSkipped;
+    // NOTE: glGetUniformLocation calls outside shader reflection, zero once every name has been resolved
+    unsigned UniformLocationLookups;
+    unsigned UniformBufferUpdates;
+    size_t UniformBufferBytes;
+    // NOTE: State changes gGLState passed on to GL, and the redundant ones it dropped
+    unsigned StateCalls;
+    unsigned StateCallsSkipped;
+
+    FrameStats();
+
+    /**
+     * @brief Zeroes all counters
+     *
+     */
+    void Reset();
+
+    /**
+     * @brief Prints the counters of the frame
+     *
+     */
+    void Print() const;
+};
+
+extern FrameStats gFrameStats;
@@ -0,0 +1,45 @@
+#include "frustum.hpp"
+
+Frustum
+Frustum::FromMatrix(const glm::mat4& m) {
+    glm::vec4 Row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 Row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 Row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 Row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum Result;
+    Result.Planes[FRUSTUM_LEFT] = Row3 + Row0;
+    Result.Planes[FRUSTUM_RIGHT] = Row3 - Row0;
+    Result.Planes[FRUSTUM_BOTTOM] = Row3 + Row1;
+    Result.Planes[FRUSTUM_TOP] = Row3 - Row1;
+    Result.Planes[FRUSTUM_NEAR] = Row3 + Row2;
+    Result.Planes[FRUSTUM_FAR] = Row3 - Row2;
+    for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT; ++PlaneIdx) {
+        glm::vec4& Plane = Result.Planes[PlaneIdx];
+        float Length = glm::length(glm::vec3(Plane));
+        if (Length > 0.0f) {
+            Plane = Plane / Length;
+        }
+    }
+    return Result;
+}
+
+bool
+Frustum::IntersectsSphere(const glm::vec3& center, float radius) const {
+    for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT; ++PlaneIdx) {
+        const glm::vec4& Plane = Planes[PlaneIdx];
+        if (glm::dot(glm::vec3(Plane), center) + Plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Bounds
+Bounds::FromBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    Bounds Result;
+    Result.Center = (boundsMin + boundsMax) * 0.5f;
+    Result.Extent = (boundsMax - boundsMin) * 0.5f;
+    Result.Radius = glm::length(Result.Extent);
+    return Result;
+}
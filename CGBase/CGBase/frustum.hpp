@@ -0,0 +1,77 @@
+/**
+ * @file frustum.hpp
+ * @brief View frustum planes and the per-frame view description passed to renderables
+ *
+ */
+
+#pragma once
+#include <glm/glm.hpp>
+
+enum EFrustumPlane {
+    FRUSTUM_LEFT = 0,
+    FRUSTUM_RIGHT = 1,
+    FRUSTUM_BOTTOM = 2,
+    FRUSTUM_TOP = 3,
+    FRUSTUM_NEAR = 4,
+    FRUSTUM_FAR = 5,
+    FRUSTUM_PLANE_COUNT = 6,
+};
+
+struct Frustum {
+    // NOTE: xyz - inward facing normal, w - distance. Point p is inside when dot(xyz, p) + w >= 0
+    glm::vec4 Planes[FRUSTUM_PLANE_COUNT];
+
+    /**
+     * @brief Extracts normalized planes from a (model-)view-projection matrix (Gribb-Hartmann).
+     * Planes end up in whatever space the matrix transforms from
+     *
+     * @param m Clip space transform
+     *
+     * @returns Frustum
+     */
+    static Frustum FromMatrix(const glm::mat4& m);
+
+    /**
+     * @brief Tests a bounding sphere against all planes
+     *
+     * @param center Sphere center
+     * @param radius Sphere radius
+     *
+     * @returns true - Sphere is at least partially inside
+     */
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+};
+
+/**
+ * @brief Bounding box and bounding sphere of an object, both around the box center
+ *
+ */
+struct Bounds {
+    glm::vec3 Center;
+    // NOTE: Half the box size
+    glm::vec3 Extent;
+    float Radius;
+
+    /**
+     * @brief Box bounds with the sphere through its corners, for primitives without vertex data at hand
+     *
+     * @param boundsMin Minimum corner
+     * @param boundsMax Maximum corner
+     *
+     * @returns Bounds
+     */
+    static Bounds FromBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+/**
+ * @brief Camera state for the current frame
+ *
+ */
+struct RenderView {
+    glm::mat4 View;
+    glm::mat4 Projection;
+    glm::mat4 ViewProjection;
+    glm::vec3 Position;
+    // NOTE: Pixels, for projecting LOD errors to the screen
+    float ViewportHeight;
+};
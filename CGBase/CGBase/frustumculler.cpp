@@ -0,0 +1,187 @@
+#include "frustumculler.hpp"
+#include <cmath>
+#include "framestats.hpp"
+#include "simd.hpp"
+
+FrustumCuller::FrustumCuller() {
+    mVisibleCount = 0;
+}
+
+void
+FrustumCuller::Clear() {
+    mCenterX.clear();
+    mCenterY.clear();
+    mCenterZ.clear();
+    mExtentX.clear();
+    mExtentY.clear();
+    mExtentZ.clear();
+    mRadius.clear();
+    mVisible.clear();
+    mVisibleCount = 0;
+}
+
+unsigned
+FrustumCuller::Add(const Bounds& bounds, const glm::mat4& model) {
+    glm::vec3 Center = glm::vec3(model * glm::vec4(bounds.Center, 1.0f));
+    // NOTE: Extent of the transformed box along each world axis, |M| * extent (Arvo)
+    glm::vec3 Extent;
+    for (unsigned Axis = 0; Axis < 3; ++Axis) {
+        Extent[Axis] = fabsf(model[0][Axis]) * bounds.Extent.x + fabsf(model[1][Axis]) * bounds.Extent.y + fabsf(model[2][Axis]) * bounds.Extent.z;
+    }
+    float Scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    mCenterX.push_back(Center.x);
+    mCenterY.push_back(Center.y);
+    mCenterZ.push_back(Center.z);
+    mExtentX.push_back(Extent.x);
+    mExtentY.push_back(Extent.y);
+    mExtentZ.push_back(Extent.z);
+    mRadius.push_back(bounds.Radius * Scale);
+    return mCenterX.size() - 1;
+}
+
+void
+FrustumCuller::Cull(const Frustum& frustum, bool allowSIMD) {
+    unsigned Count = mCenterX.size();
+    mVisible.resize(Count);
+    mVisibleCount = 0;
+
+    // NOTE: Each kernel handles whole batches from First on and returns where it stopped
+    unsigned First = 0;
+    if (allowSIMD) {
+        First = cullAVX(frustum, First);
+        First = cullSSE(frustum, First);
+    }
+    cullScalar(frustum, First);
+
+    gFrameStats.ObjectsTested += Count;
+    gFrameStats.ObjectsCulled += Count - mVisibleCount;
+}
+
+bool
+FrustumCuller::IsVisible(unsigned object) const {
+    return mVisible[object] != 0;
+}
+
+unsigned
+FrustumCuller::GetCount() const {
+    return mCenterX.size();
+}
+
+unsigned
+FrustumCuller::GetVisibleCount() const {
+    return mVisibleCount;
+}
+
+unsigned
+FrustumCuller::cullScalar(const Frustum& frustum, unsigned first) {
+    unsigned Count = mCenterX.size();
+    for (unsigned ObjectIdx = first; ObjectIdx < Count; ++ObjectIdx) {
+        bool Inside = true;
+        for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT && Inside; ++PlaneIdx) {
+            const glm::vec4& Plane = frustum.Planes[PlaneIdx];
+            float Distance = Plane.x * mCenterX[ObjectIdx] + Plane.y * mCenterY[ObjectIdx] + Plane.z * mCenterZ[ObjectIdx] + Plane.w;
+            // NOTE: How far the box reaches towards the plane. Whichever volume is tighter decides
+            float BoxRadius = fabsf(Plane.x) * mExtentX[ObjectIdx] + fabsf(Plane.y) * mExtentY[ObjectIdx] + fabsf(Plane.z) * mExtentZ[ObjectIdx];
+            Inside = Distance + glm::min(BoxRadius, mRadius[ObjectIdx]) >= 0.0f;
+        }
+        mVisible[ObjectIdx] = Inside;
+        mVisibleCount += Inside;
+    }
+    return Count;
+}
+
+unsigned
+FrustumCuller::cullSSE(const Frustum& frustum, unsigned first) {
+#ifdef CG_SSE2
+    // NOTE: Plane components broadcast once: x, y, z, w, |x|, |y|, |z|
+    __m128 Planes[FRUSTUM_PLANE_COUNT][7];
+    for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT; ++PlaneIdx) {
+        const glm::vec4& Plane = frustum.Planes[PlaneIdx];
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            Planes[PlaneIdx][Component] = _mm_set1_ps(Plane[Component]);
+        }
+        for (unsigned Component = 0; Component < 3; ++Component) {
+            Planes[PlaneIdx][4 + Component] = _mm_set1_ps(fabsf(Plane[Component]));
+        }
+    }
+
+    unsigned Count = mCenterX.size();
+    unsigned ObjectIdx = first;
+    __m128 Zero = _mm_setzero_ps();
+    for (; ObjectIdx + 4 <= Count; ObjectIdx += 4) {
+        __m128 CenterX = _mm_loadu_ps(&mCenterX[ObjectIdx]);
+        __m128 CenterY = _mm_loadu_ps(&mCenterY[ObjectIdx]);
+        __m128 CenterZ = _mm_loadu_ps(&mCenterZ[ObjectIdx]);
+        __m128 ExtentX = _mm_loadu_ps(&mExtentX[ObjectIdx]);
+        __m128 ExtentY = _mm_loadu_ps(&mExtentY[ObjectIdx]);
+        __m128 ExtentZ = _mm_loadu_ps(&mExtentZ[ObjectIdx]);
+        __m128 Radius = _mm_loadu_ps(&mRadius[ObjectIdx]);
+        __m128 Outside = Zero;
+        for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT; ++PlaneIdx) {
+            const __m128* P = Planes[PlaneIdx];
+            __m128 Distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(P[0], CenterX), _mm_mul_ps(P[1], CenterY)), _mm_mul_ps(P[2], CenterZ)), P[3]);
+            __m128 BoxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(P[4], ExtentX), _mm_mul_ps(P[5], ExtentY)), _mm_mul_ps(P[6], ExtentZ));
+            Outside = _mm_or_ps(Outside, _mm_cmplt_ps(_mm_add_ps(Distance, _mm_min_ps(BoxRadius, Radius)), Zero));
+        }
+
+        int OutsideMask = _mm_movemask_ps(Outside);
+        for (unsigned Lane = 0; Lane < 4; ++Lane) {
+            bool Inside = !((OutsideMask >> Lane) & 1);
+            mVisible[ObjectIdx + Lane] = Inside;
+            mVisibleCount += Inside;
+        }
+    }
+    return ObjectIdx;
+#else
+    (void)frustum;
+    return first;
+#endif
+}
+
+unsigned
+FrustumCuller::cullAVX(const Frustum& frustum, unsigned first) {
+#ifdef CG_AVX
+    __m256 Planes[FRUSTUM_PLANE_COUNT][7];
+    for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT; ++PlaneIdx) {
+        const glm::vec4& Plane = frustum.Planes[PlaneIdx];
+        for (unsigned Component = 0; Component < 4; ++Component) {
+            Planes[PlaneIdx][Component] = _mm256_set1_ps(Plane[Component]);
+        }
+        for (unsigned Component = 0; Component < 3; ++Component) {
+            Planes[PlaneIdx][4 + Component] = _mm256_set1_ps(fabsf(Plane[Component]));
+        }
+    }
+
+    unsigned Count = mCenterX.size();
+    unsigned ObjectIdx = first;
+    __m256 Zero = _mm256_setzero_ps();
+    for (; ObjectIdx + 8 <= Count; ObjectIdx += 8) {
+        __m256 CenterX = _mm256_loadu_ps(&mCenterX[ObjectIdx]);
+        __m256 CenterY = _mm256_loadu_ps(&mCenterY[ObjectIdx]);
+        __m256 CenterZ = _mm256_loadu_ps(&mCenterZ[ObjectIdx]);
+        __m256 ExtentX = _mm256_loadu_ps(&mExtentX[ObjectIdx]);
+        __m256 ExtentY = _mm256_loadu_ps(&mExtentY[ObjectIdx]);
+        __m256 ExtentZ = _mm256_loadu_ps(&mExtentZ[ObjectIdx]);
+        __m256 Radius = _mm256_loadu_ps(&mRadius[ObjectIdx]);
+        __m256 Outside = Zero;
+        for (unsigned PlaneIdx = 0; PlaneIdx < FRUSTUM_PLANE_COUNT; ++PlaneIdx) {
+            const __m256* P = Planes[PlaneIdx];
+            __m256 Distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(P[0], CenterX), _mm256_mul_ps(P[1], CenterY)), _mm256_mul_ps(P[2], CenterZ)), P[3]);
+            __m256 BoxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(P[4], ExtentX), _mm256_mul_ps(P[5], ExtentY)), _mm256_mul_ps(P[6], ExtentZ));
+            Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(_mm256_add_ps(Distance, _mm256_min_ps(BoxRadius, Radius)), Zero, _CMP_LT_OQ));
+        }
+
+        int OutsideMask = _mm256_movemask_ps(Outside);
+        for (unsigned Lane = 0; Lane < 8; ++Lane) {
+            bool Inside = !((OutsideMask >> Lane) & 1);
+            mVisible[ObjectIdx + Lane] = Inside;
+            mVisibleCount += Inside;
+        }
+    }
+    return ObjectIdx;
+#else
+    (void)frustum;
+    return first;
+#endif
+}
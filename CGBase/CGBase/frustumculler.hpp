@@ -0,0 +1,81 @@
+/**
+ * @file frustumculler.hpp
+ * @brief Per-object frustum culling. World space bounds are kept as structure of arrays
+ * so 4 (SSE) objects are tested against a plane per instruction, 8 in builds with AVX enabled
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.hpp"
+
+/**
+ * @brief Collects the bounds of the frame's objects, culls them in one pass and answers
+ * visibility queries by the index Add returned
+ *
+ */
+class FrustumCuller {
+public:
+    FrustumCuller();
+
+    /**
+     * @brief Removes all objects, keeps the storage
+     *
+     */
+    void Clear();
+
+    /**
+     * @brief Adds an object. The box is transformed conservatively, the sphere radius is
+     * scaled by the largest axis scale of the model matrix
+     *
+     * @param bounds Object space bounds
+     * @param model Model matrix
+     *
+     * @returns Object index
+     */
+    unsigned Add(const Bounds& bounds, const glm::mat4& model);
+
+    /**
+     * @brief Tests every object against the frustum. An object is culled once its box or its
+     * sphere is fully outside one of the planes
+     *
+     * @param frustum World space frustum
+     * @param allowSIMD false forces the scalar loop, used by the benchmark
+     */
+    void Cull(const Frustum& frustum, bool allowSIMD = true);
+
+    /**
+     * @brief Returns whether an object survived the last Cull
+     *
+     * @param object Index returned by Add
+     */
+    bool IsVisible(unsigned object) const;
+
+    /**
+     * @brief Returns the number of objects
+     *
+     */
+    unsigned GetCount() const;
+
+    /**
+     * @brief Returns the number of objects that survived the last Cull
+     *
+     */
+    unsigned GetVisibleCount() const;
+
+private:
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mExtentX;
+    std::vector<float> mExtentY;
+    std::vector<float> mExtentZ;
+    std::vector<float> mRadius;
+    std::vector<unsigned char> mVisible;
+    unsigned mVisibleCount;
+
+    unsigned cullScalar(const Frustum& frustum, unsigned first);
+    unsigned cullSSE(const Frustum& frustum, unsigned first);
+    unsigned cullAVX(const Frustum& frustum, unsigned first);
+};
@@ -0,0 +1,146 @@
+#include "geometrypool.hpp"
+#include <iostream>
+#include "framestats.hpp"
+#include "glstate.hpp"
+#include "mesh.hpp"
+
+GeometryPool::GeometryPool() {
+    mVAO = 0;
+    mVBO = 0;
+    mEBO = 0;
+    mIndirectBuffer = 0;
+    mIndirectCapacity = 0;
+}
+
+bool
+GeometryPool::IsSupported() {
+    // NOTE: Before 4.2 / ARB_base_instance the BaseInstance field of indirect commands must be 0
+    return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+unsigned
+GeometryPool::Add(const std::vector<float>& vertices, const std::vector<unsigned>& indices) {
+    GeometryAllocation Allocation;
+    Allocation.FirstIndex = mIndices.size();
+    Allocation.IndexCount = indices.size();
+    Allocation.BaseVertex = mVertices.size() / MESH_VERTEX_FLOATS;
+    mVertices.insert(mVertices.end(), vertices.begin(), vertices.end());
+    mIndices.insert(mIndices.end(), indices.begin(), indices.end());
+    mAllocations.push_back(Allocation);
+    return mAllocations.size() - 1;
+}
+
+const GeometryAllocation&
+GeometryPool::GetAllocation(unsigned allocation) const {
+    return mAllocations[allocation];
+}
+
+bool
+GeometryPool::Create() {
+    if (mIndices.empty()) {
+        std::cerr << "[Err] Geometry pool is empty" << std::endl;
+        return false;
+    }
+
+    glGenVertexArrays(1, &mVAO);
+    glGenBuffers(1, &mVBO);
+    glGenBuffers(1, &mEBO);
+    glGenBuffers(1, &mIndirectBuffer);
+    if (!mVAO || !mVBO || !mEBO || !mIndirectBuffer || !mInstances.Create()) {
+        std::cerr << "[Err] Failed to create geometry pool buffers" << std::endl;
+        Destroy();
+        return false;
+    }
+
+    gGLState.BindVertexArray(mVAO);
+    gGLState.BindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(float), mVertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    mInstances.BindAttributes();
+
+    // NOTE: The element buffer binding is recorded in the VAO, it must stay bound while the VAO is
+    gGLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(unsigned), mIndices.data(), GL_STATIC_DRAW);
+
+    std::cout << "[Info] Geometry pool: " << mAllocations.size() << " meshes, " << mVertices.size() / MESH_VERTEX_FLOATS
+              << " vertices, " << mIndices.size() / 3 << " triangles" << std::endl;
+    std::vector<float>().swap(mVertices);
+    std::vector<unsigned>().swap(mIndices);
+    return true;
+}
+
+void
+GeometryPool::Destroy() {
+    gGLState.DeleteVertexArray(mVAO);
+    gGLState.DeleteBuffer(mVBO);
+    gGLState.DeleteBuffer(mEBO);
+    gGLState.DeleteBuffer(mIndirectBuffer);
+    mInstances.Destroy();
+    mVAO = mVBO = mEBO = mIndirectBuffer = 0;
+    mIndirectCapacity = 0;
+}
+
+void
+GeometryPool::Clear() {
+    mInstances.Clear();
+    mCommands.clear();
+}
+
+unsigned
+GeometryPool::AddInstance(const ObjectTransform& transform) {
+    return mInstances.Add(transform, INSTANCE_NO_LAYER, INSTANCE_NO_LAYER);
+}
+
+void
+GeometryPool::AddCommand(unsigned instance, unsigned indexCount, unsigned firstIndex, GLint baseVertex) {
+    DrawElementsIndirectCommand Command;
+    Command.Count = indexCount;
+    Command.InstanceCount = 1;
+    Command.FirstIndex = firstIndex;
+    Command.BaseVertex = baseVertex;
+    Command.BaseInstance = instance;
+    mCommands.push_back(Command);
+}
+
+unsigned
+GeometryPool::GetCommandCount() const {
+    return mCommands.size();
+}
+
+void
+GeometryPool::Upload() {
+    if (mCommands.empty() || !mIndirectBuffer) {
+        return;
+    }
+
+    mInstances.Upload();
+    size_t Bytes = mCommands.size() * sizeof(DrawElementsIndirectCommand);
+    gGLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+    // NOTE: Same doubling and orphaning as InstanceBuffer::Upload
+    if (Bytes > mIndirectCapacity) {
+        mIndirectCapacity = glm::max(Bytes, mIndirectCapacity * 2);
+    }
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, mIndirectCapacity, 0, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, Bytes, mCommands.data());
+}
+
+void
+GeometryPool::Draw(unsigned firstCommand, unsigned commandCount) {
+    if (!commandCount) {
+        return;
+    }
+    gGLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(firstCommand * sizeof(DrawElementsIndirectCommand)), commandCount, 0);
+    gFrameStats.DrawCalls++;
+    gFrameStats.IndirectCommands += commandCount;
+}
+
+GLuint
+GeometryPool::GetVAO() const {
+    return mVAO;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file geometrypool.hpp
+ * @brief Shared vertex and index buffers for static meshes. Draws of pooled meshes become
+ * indirect commands, issued a material at a time with glMultiDrawElementsIndirect
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include "instancebuffer.hpp"
+
+/**
+ * @brief Command layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+ *
+ */
+struct DrawElementsIndirectCommand {
+    GLuint Count;
+    GLuint InstanceCount;
+    GLuint FirstIndex;
+    GLint BaseVertex;
+    // NOTE: Index of the draw's per-draw data, read through the instance attributes
+    GLuint BaseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match the GL layout");
+
+/**
+ * @brief Where a mesh landed in the pool. Indices stay relative to the mesh's own vertices
+ *
+ */
+struct GeometryAllocation {
+    unsigned FirstIndex;
+    unsigned IndexCount;
+    GLint BaseVertex;
+};
+
+/**
+ * @brief Float vertices (MESH_VERTEX_FLOATS) and 32-bit indices of many meshes in one VAO.
+ * Per-draw transforms live in an instance buffer, each command points at its draw's entry
+ * with BaseInstance, so the INSTANCED permutation of basic.vert draws pooled meshes unchanged
+ *
+ */
+class GeometryPool {
+public:
+    GeometryPool();
+
+    /**
+     * @brief Whether the context has multi-draw indirect with a per-command base instance (GL 4.3)
+     *
+     */
+    static bool IsSupported();
+
+    /**
+     * @brief Appends mesh data to the pool. Only valid before Create
+     *
+     * @param vertices Interleaved float vertices, MESH_VERTEX_FLOATS per vertex
+     * @param indices Triangle indices into vertices
+     * @returns Allocation index for GetAllocation
+     */
+    unsigned Add(const std::vector<float>& vertices, const std::vector<unsigned>& indices);
+
+    /**
+     * @brief Returns where an added mesh is stored
+     *
+     */
+    const GeometryAllocation& GetAllocation(unsigned allocation) const;
+
+    /**
+     * @brief Uploads everything added so far and sets up the shared VAO. Frees the CPU copy
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Create();
+
+    /**
+     * @brief Deletes the buffers and the VAO
+     *
+     */
+    void Destroy();
+
+    /**
+     * @brief Removes the draws of the previous frame, keeps the storage
+     *
+     */
+    void Clear();
+
+    /**
+     * @brief Stores per-draw data
+     *
+     * @param transform Object transform of the draw
+     * @returns Index for AddCommand
+     */
+    unsigned AddInstance(const ObjectTransform& transform);
+
+    /**
+     * @brief Appends an indirect command
+     *
+     * @param instance Per-draw data index returned by AddInstance
+     * @param indexCount Index count
+     * @param firstIndex First index in the pool's element buffer
+     * @param baseVertex Added to every index, see GeometryAllocation
+     */
+    void AddCommand(unsigned instance, unsigned indexCount, unsigned firstIndex, GLint baseVertex);
+
+    /**
+     * @brief Returns the number of commands added since Clear
+     *
+     */
+    unsigned GetCommandCount() const;
+
+    /**
+     * @brief Uploads the frame's per-draw data and commands, orphaning last frame's storage
+     *
+     */
+    void Upload();
+
+    /**
+     * @brief Issues a range of uploaded commands with one glMultiDrawElementsIndirect.
+     * The pool's VAO, the program and the textures must be bound
+     *
+     * @param firstCommand First command of the range
+     * @param commandCount Number of commands
+     */
+    void Draw(unsigned firstCommand, unsigned commandCount);
+
+    /**
+     * @brief Returns the shared VAO, 0 before Create
+     *
+     */
+    GLuint GetVAO() const;
+
+private:
+    GLuint mVAO;
+    GLuint mVBO;
+    GLuint mEBO;
+    GLuint mIndirectBuffer;
+    size_t mIndirectCapacity;
+    // NOTE: Staging for Add, released by Create
+    std::vector<float> mVertices;
+    std::vector<unsigned> mIndices;
+    std::vector<GeometryAllocation> mAllocations;
+    InstanceBuffer mInstances;
+    std::vector<DrawElementsIndirectCommand> mCommands;
+};
@@ -0,0 +1,219 @@
+#include "glstate.hpp"
+#include "framestats.hpp"
+
+GLState gGLState;
+
+GLState::GLState() {
+    Invalidate();
+}
+
+void
+GLState::Invalidate() {
+    mProgram = UNKNOWN;
+    mVAO = UNKNOWN;
+    for (unsigned TargetIdx = 0; TargetIdx < BUFFER_TARGET_COUNT; ++TargetIdx) {
+        mBuffers[TargetIdx] = UNKNOWN;
+    }
+    mActiveUnit = UNKNOWN;
+    for (unsigned Unit = 0; Unit < GL_STATE_TEXTURE_UNITS; ++Unit) {
+        mTextures[Unit][0] = UNKNOWN;
+        mTextures[Unit][1] = UNKNOWN;
+    }
+    for (unsigned CapabilityIdx = 0; CapabilityIdx < CAPABILITY_COUNT; ++CapabilityIdx) {
+        mCapabilities[CapabilityIdx] = -1;
+    }
+    mDepthFunc = UNKNOWN;
+    mDepthWrite = -1;
+    mCullFace = UNKNOWN;
+    mBlendSrc = UNKNOWN;
+    mBlendDst = UNKNOWN;
+    mViewport[0] = mViewport[1] = mViewport[2] = mViewport[3] = -1;
+}
+
+bool
+GLState::filter(bool redundant) {
+    if (redundant) {
+        gFrameStats.StateCallsSkipped++;
+        return true;
+    }
+    gFrameStats.StateCalls++;
+    return false;
+}
+
+int
+GLState::bufferSlot(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER: return BUFFER_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT_ARRAY;
+    case GL_UNIFORM_BUFFER: return BUFFER_UNIFORM;
+    case GL_PIXEL_UNPACK_BUFFER: return BUFFER_PIXEL_UNPACK;
+    case GL_DRAW_INDIRECT_BUFFER: return BUFFER_DRAW_INDIRECT;
+    default: return -1;
+    }
+}
+
+int
+GLState::capabilitySlot(GLenum capability) {
+    switch (capability) {
+    case GL_DEPTH_TEST: return CAPABILITY_DEPTH_TEST;
+    case GL_CULL_FACE: return CAPABILITY_CULL_FACE;
+    case GL_BLEND: return CAPABILITY_BLEND;
+    default: return -1;
+    }
+}
+
+void
+GLState::UseProgram(GLuint program) {
+    if (filter(mProgram == program)) {
+        return;
+    }
+    glUseProgram(program);
+    mProgram = program;
+}
+
+void
+GLState::BindVertexArray(GLuint vao) {
+    if (filter(mVAO == vao)) {
+        return;
+    }
+    glBindVertexArray(vao);
+    mVAO = vao;
+    // NOTE: Each VAO remembers its own element buffer
+    mBuffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+}
+
+void
+GLState::BindBuffer(GLenum target, GLuint buffer) {
+    int Slot = bufferSlot(target);
+    if (filter(Slot >= 0 && mBuffers[Slot] == buffer)) {
+        return;
+    }
+    glBindBuffer(target, buffer);
+    if (Slot >= 0) {
+        mBuffers[Slot] = buffer;
+    }
+}
+
+void
+GLState::BindTexture(unsigned unit, GLenum target, GLuint texture) {
+    GLuint& Bound = mTextures[unit][target == GL_TEXTURE_2D_ARRAY];
+    if (filter(Bound == texture)) {
+        gFrameStats.TextureBindsSkipped++;
+        return;
+    }
+
+    if (mActiveUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        mActiveUnit = unit;
+        gFrameStats.StateCalls++;
+    }
+    glBindTexture(target, texture);
+    Bound = texture;
+    gFrameStats.TextureBinds++;
+}
+
+void
+GLState::SetCapability(GLenum capability, bool enabled) {
+    int Slot = capabilitySlot(capability);
+    if (filter(Slot >= 0 && mCapabilities[Slot] == (int)enabled)) {
+        return;
+    }
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    if (Slot >= 0) {
+        mCapabilities[Slot] = enabled;
+    }
+}
+
+void
+GLState::SetDepth(GLenum func, bool write) {
+    if (!filter(mDepthFunc == func)) {
+        glDepthFunc(func);
+        mDepthFunc = func;
+    }
+    if (!filter(mDepthWrite == (int)write)) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        mDepthWrite = write;
+    }
+}
+
+void
+GLState::SetCullFace(GLenum face) {
+    if (filter(mCullFace == face)) {
+        return;
+    }
+    glCullFace(face);
+    mCullFace = face;
+}
+
+void
+GLState::SetBlendFunc(GLenum src, GLenum dst) {
+    if (filter(mBlendSrc == src && mBlendDst == dst)) {
+        return;
+    }
+    glBlendFunc(src, dst);
+    mBlendSrc = src;
+    mBlendDst = dst;
+}
+
+void
+GLState::SetViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (filter(mViewport[0] == x && mViewport[1] == y && mViewport[2] == width && mViewport[3] == height)) {
+        return;
+    }
+    glViewport(x, y, width, height);
+    mViewport[0] = x;
+    mViewport[1] = y;
+    mViewport[2] = width;
+    mViewport[3] = height;
+}
+
+void
+GLState::DeleteProgram(GLuint program) {
+    // NOTE: A current program is only flagged for deletion, but the name may come back
+    if (mProgram == program) {
+        mProgram = UNKNOWN;
+    }
+    glDeleteProgram(program);
+}
+
+void
+GLState::DeleteVertexArray(GLuint vao) {
+    // NOTE: GL reverts to VAO 0 when the bound one is deleted
+    if (mVAO == vao) {
+        mVAO = 0;
+        mBuffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+    }
+    glDeleteVertexArrays(1, &vao);
+}
+
+void
+GLState::DeleteBuffer(GLuint buffer) {
+    for (unsigned TargetIdx = 0; TargetIdx < BUFFER_TARGET_COUNT; ++TargetIdx) {
+        if (mBuffers[TargetIdx] == buffer) {
+            mBuffers[TargetIdx] = 0;
+        }
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void
+GLState::DeleteTexture(GLuint texture) {
+    // NOTE: GL unbinds deleted textures, and the name may come back from glGenTextures
+    for (unsigned Unit = 0; Unit < GL_STATE_TEXTURE_UNITS; ++Unit) {
+        for (unsigned TargetIdx = 0; TargetIdx < 2; ++TargetIdx) {
+            if (mTextures[Unit][TargetIdx] == texture) {
+                mTextures[Unit][TargetIdx] = 0;
+            }
+        }
+    }
+    glDeleteTextures(1, &texture);
+}
+
+GLuint
+GLState::GetProgram() const {
+    return mProgram == UNKNOWN ? 0 : mProgram;
+}
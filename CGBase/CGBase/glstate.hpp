@@ -0,0 +1,170 @@
+/**
+ * @file glstate.hpp
+ * @brief Shadow copy of the bound GL state. Binds and toggles that would not change
+ * anything are dropped before they reach the driver
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+
+// NOTE: Texture units tracked by GLState::BindTexture
+#define GL_STATE_TEXTURE_UNITS 8
+
+/**
+ * @brief Caches program, VAO, per-unit textures, buffer bindings, depth/cull/blend state and the
+ * viewport. All engine code binds through gGLState, issued and skipped calls are counted in gFrameStats.
+ * Code that touches GL directly has to call Invalidate afterwards
+ *
+ */
+class GLState {
+public:
+    GLState();
+
+    /**
+     * @brief Forgets everything, the next call of each kind always reaches GL
+     *
+     */
+    void Invalidate();
+
+    /**
+     * @brief Makes a program current
+     *
+     * @param program ProgramID, 0 unbinds
+     */
+    void UseProgram(GLuint program);
+
+    /**
+     * @brief Binds a vertex array. The element buffer binding is VAO state and follows it
+     *
+     * @param vao VAO, 0 unbinds
+     */
+    void BindVertexArray(GLuint vao);
+
+    /**
+     * @brief Binds a buffer to a target. GL_ELEMENT_ARRAY_BUFFER binds into the current VAO
+     *
+     * @param target Buffer target
+     * @param buffer Buffer, 0 unbinds
+     */
+    void BindBuffer(GLenum target, GLuint buffer);
+
+    /**
+     * @brief Binds a texture to a unit
+     *
+     * @param unit Texture unit, below GL_STATE_TEXTURE_UNITS
+     * @param target GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+     * @param texture TextureID, 0 unbinds
+     */
+    void BindTexture(unsigned unit, GLenum target, GLuint texture);
+
+    /**
+     * @brief Enables or disables GL_DEPTH_TEST, GL_CULL_FACE or GL_BLEND
+     *
+     * @param capability Capability
+     * @param enabled New state
+     */
+    void SetCapability(GLenum capability, bool enabled);
+
+    /**
+     * @brief Sets the depth comparison and whether depth is written
+     *
+     * @param func Depth function
+     * @param write Depth write mask
+     */
+    void SetDepth(GLenum func, bool write);
+
+    /**
+     * @brief Sets the culled face
+     *
+     * @param face GL_BACK, GL_FRONT or GL_FRONT_AND_BACK
+     */
+    void SetCullFace(GLenum face);
+
+    /**
+     * @brief Sets the blend factors
+     *
+     * @param src Source factor
+     * @param dst Destination factor
+     */
+    void SetBlendFunc(GLenum src, GLenum dst);
+
+    /**
+     * @brief Sets the viewport
+     *
+     */
+    void SetViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    /**
+     * @brief Deletes a program and forgets it if current
+     *
+     * @param program ProgramID
+     */
+    void DeleteProgram(GLuint program);
+
+    /**
+     * @brief Deletes a vertex array and forgets it if bound
+     *
+     * @param vao VAO
+     */
+    void DeleteVertexArray(GLuint vao);
+
+    /**
+     * @brief Deletes a buffer and forgets its bindings
+     *
+     * @param buffer Buffer
+     */
+    void DeleteBuffer(GLuint buffer);
+
+    /**
+     * @brief Deletes a texture and forgets its bindings
+     *
+     * @param texture TextureID
+     */
+    void DeleteTexture(GLuint texture);
+
+    /**
+     * @brief Returns the current program as last set through UseProgram, 0 if not known
+     *
+     */
+    GLuint GetProgram() const;
+
+private:
+    enum BufferTarget {
+        BUFFER_ARRAY = 0,
+        BUFFER_ELEMENT_ARRAY,
+        BUFFER_UNIFORM,
+        BUFFER_PIXEL_UNPACK,
+        BUFFER_DRAW_INDIRECT,
+        BUFFER_TARGET_COUNT
+    };
+
+    enum Capability {
+        CAPABILITY_DEPTH_TEST = 0,
+        CAPABILITY_CULL_FACE,
+        CAPABILITY_BLEND,
+        CAPABILITY_COUNT
+    };
+
+    // NOTE: Unknown state never matches, so the first call after Invalidate goes through
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    GLuint mProgram;
+    GLuint mVAO;
+    GLuint mBuffers[BUFFER_TARGET_COUNT];
+    unsigned mActiveUnit;
+    GLuint mTextures[GL_STATE_TEXTURE_UNITS][2];
+    int mCapabilities[CAPABILITY_COUNT];
+    GLenum mDepthFunc;
+    int mDepthWrite;
+    GLenum mCullFace;
+    GLenum mBlendSrc;
+    GLenum mBlendDst;
+    GLint mViewport[4];
+
+    bool filter(bool redundant);
+    static int bufferSlot(GLenum target);
+    static int capabilitySlot(GLenum capability);
+};
+
+extern GLState gGLState;
@@ -0,0 +1,32 @@
+/**
+ * @file hash.hpp
+ * @brief Small non-cryptographic hashing helpers used for cache validation
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+/**
+ * @brief Hashes a block of bytes using 64-bit FNV-1a
+ *
+ * @param data Pointer to the bytes
+ * @param size Number of bytes
+ * @param seed Previous hash value, used to chain several blocks together
+ *
+ * @returns 64-bit hash
+ */
+inline uint64_t
+HashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+    const unsigned char* Bytes = (const unsigned char*)data;
+    uint64_t Hash = seed;
+    for (size_t ByteIdx = 0; ByteIdx < size; ++ByteIdx) {
+        Hash ^= Bytes[ByteIdx];
+        Hash *= FNV_PRIME;
+    }
+    return Hash;
+}
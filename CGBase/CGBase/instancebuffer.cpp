@@ -0,0 +1,129 @@
+#include "instancebuffer.hpp"
+#include <iostream>
+#include "framestats.hpp"
+#include "glstate.hpp"
+#include "texturearray.hpp"
+
+InstanceBuffer::InstanceBuffer() {
+    mBuffer = 0;
+    mCapacity = 0;
+}
+
+bool
+InstanceBuffer::Create() {
+    glGenBuffers(1, &mBuffer);
+    if (!mBuffer) {
+        std::cerr << "[Err] Failed to create instance buffer" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void
+InstanceBuffer::Destroy() {
+    gGLState.DeleteBuffer(mBuffer);
+    mBuffer = 0;
+    mCapacity = 0;
+}
+
+void
+InstanceBuffer::pointAttributes(unsigned firstInstance) {
+    gGLState.BindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    size_t Base = firstInstance * sizeof(InstanceData);
+    GLsizei Stride = sizeof(InstanceData);
+    for (unsigned ColumnIdx = 0; ColumnIdx < 4; ++ColumnIdx) {
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_MODEL + ColumnIdx, 4, GL_FLOAT, GL_FALSE, Stride,
+                              (void*)(Base + offsetof(InstanceData, Transform.Model) + ColumnIdx * sizeof(glm::vec4)));
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_MVP + ColumnIdx, 4, GL_FLOAT, GL_FALSE, Stride,
+                              (void*)(Base + offsetof(InstanceData, Transform.MVP) + ColumnIdx * sizeof(glm::vec4)));
+    }
+    // NOTE: Normal matrix columns are the xyz of the first three ObjectTransform::Normal columns
+    for (unsigned ColumnIdx = 0; ColumnIdx < 3; ++ColumnIdx) {
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_NORMAL_MATRIX + ColumnIdx, 3, GL_FLOAT, GL_FALSE, Stride,
+                              (void*)(Base + offsetof(InstanceData, Transform.Normal) + ColumnIdx * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(TEXTURE_ARRAY_LAYER_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, Stride, (void*)(Base + offsetof(InstanceData, Layers)));
+}
+
+void
+InstanceBuffer::BindAttributes() {
+    pointAttributes(0);
+    const unsigned Locations[] = {
+        INSTANCE_ATTRIBUTE_MODEL, INSTANCE_ATTRIBUTE_MODEL + 1, INSTANCE_ATTRIBUTE_MODEL + 2, INSTANCE_ATTRIBUTE_MODEL + 3,
+        INSTANCE_ATTRIBUTE_MVP, INSTANCE_ATTRIBUTE_MVP + 1, INSTANCE_ATTRIBUTE_MVP + 2, INSTANCE_ATTRIBUTE_MVP + 3,
+        INSTANCE_ATTRIBUTE_NORMAL_MATRIX, INSTANCE_ATTRIBUTE_NORMAL_MATRIX + 1, INSTANCE_ATTRIBUTE_NORMAL_MATRIX + 2,
+        TEXTURE_ARRAY_LAYER_ATTRIBUTE
+    };
+    for (unsigned LocationIdx = 0; LocationIdx < sizeof(Locations) / sizeof(Locations[0]); ++LocationIdx) {
+        glEnableVertexAttribArray(Locations[LocationIdx]);
+        glVertexAttribDivisor(Locations[LocationIdx], 1);
+    }
+}
+
+void
+InstanceBuffer::Clear() {
+    mInstances.clear();
+}
+
+unsigned
+InstanceBuffer::Add(const ObjectTransform& transform, unsigned diffuseLayer, unsigned specularLayer) {
+    InstanceData Instance;
+    Instance.Transform = transform;
+    Instance.Layers = glm::vec2(diffuseLayer == INSTANCE_NO_LAYER ? -1.0f : (float)diffuseLayer,
+                                specularLayer == INSTANCE_NO_LAYER ? -1.0f : (float)specularLayer);
+    Instance.Pad0[0] = Instance.Pad0[1] = 0.0f;
+    mInstances.push_back(Instance);
+    return mInstances.size() - 1;
+}
+
+void
+InstanceBuffer::Upload() {
+    if (mInstances.empty() || !mBuffer) {
+        return;
+    }
+
+    size_t Bytes = mInstances.size() * sizeof(InstanceData);
+    gGLState.BindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    // NOTE: Grows by doubling, a new glBufferData of the same size orphans the old storage
+    if (Bytes > mCapacity) {
+        mCapacity = glm::max(Bytes, mCapacity * 2);
+    }
+    glBufferData(GL_ARRAY_BUFFER, mCapacity, 0, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, Bytes, mInstances.data());
+    gFrameStats.InstanceBytes += Bytes;
+}
+
+void
+InstanceBuffer::DrawArrays(unsigned vertexCount, unsigned firstInstance, unsigned instanceCount) {
+    if (!instanceCount) {
+        return;
+    }
+    if (GLEW_ARB_base_instance) {
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, vertexCount, instanceCount, firstInstance);
+    } else {
+        pointAttributes(firstInstance);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
+    }
+    gFrameStats.DrawCalls++;
+    gFrameStats.InstancesDrawn += instanceCount;
+}
+
+void
+InstanceBuffer::DrawElements(unsigned indexCount, GLenum indexType, size_t indexOffset, unsigned firstInstance, unsigned instanceCount) {
+    if (!instanceCount) {
+        return;
+    }
+    if (GLEW_ARB_base_instance) {
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, indexCount, indexType, (void*)indexOffset, instanceCount, firstInstance);
+    } else {
+        pointAttributes(firstInstance);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, (void*)indexOffset, instanceCount);
+    }
+    gFrameStats.DrawCalls++;
+    gFrameStats.InstancesDrawn += instanceCount;
+}
+
+unsigned
+InstanceBuffer::GetCount() const {
+    return mInstances.size();
+}
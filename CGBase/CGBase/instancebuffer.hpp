@@ -0,0 +1,120 @@
+/**
+ * @file instancebuffer.hpp
+ * @brief Per-instance vertex data for instanced draws. Instances carry the transforms a
+ * non-instanced draw would set as uniforms, so one draw covers any number of copies
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "transformbatch.hpp"
+
+// NOTE: First attribute location of the instance data, the INSTANCED permutation of basic.vert
+// reads aModel at 4-7, aMVP at 8-11 and aNormalMatrix at 12-14. The texture layers go to
+// TEXTURE_ARRAY_LAYER_ATTRIBUTE, which is constant for non-instanced draws
+#define INSTANCE_ATTRIBUTE_MODEL 4
+#define INSTANCE_ATTRIBUTE_MVP 8
+#define INSTANCE_ATTRIBUTE_NORMAL_MATRIX 12
+// NOTE: Layer of an instance that samples the plain 2D textures instead of the arrays
+#define INSTANCE_NO_LAYER 0xFFFFFFFF
+
+/**
+ * @brief One instance as laid out in the instance buffer
+ *
+ */
+struct InstanceData {
+    ObjectTransform Transform;
+    // NOTE: Diffuse and specular texture array layers
+    glm::vec2 Layers;
+    float Pad0[2];
+};
+
+static_assert(sizeof(InstanceData) == 208, "InstanceData must stay tightly packed");
+
+/**
+ * @brief Streams instance data to one buffer per frame and issues the instanced draws.
+ * Instances are appended, uploaded once, then drawn in contiguous ranges
+ *
+ */
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+
+    /**
+     * @brief Creates the buffer
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Create();
+
+    /**
+     * @brief Deletes the buffer
+     *
+     */
+    void Destroy();
+
+    /**
+     * @brief Points the instance attributes of the bound VAO at the buffer. Call once per VAO
+     * that draws instanced, with the VAO bound
+     *
+     */
+    void BindAttributes();
+
+    /**
+     * @brief Removes all instances, keeps the storage
+     *
+     */
+    void Clear();
+
+    /**
+     * @brief Appends an instance
+     *
+     * @param transform Transform of the instance
+     * @param diffuseLayer Diffuse texture array layer, or INSTANCE_NO_LAYER
+     * @param specularLayer Specular texture array layer, or INSTANCE_NO_LAYER
+     * @returns Index of the instance
+     */
+    unsigned Add(const ObjectTransform& transform, unsigned diffuseLayer, unsigned specularLayer);
+
+    /**
+     * @brief Uploads all instances, orphaning last frame's storage so the driver doesn't wait on it
+     *
+     */
+    void Upload();
+
+    /**
+     * @brief Draws a range of uploaded instances of non-indexed geometry from the bound VAO
+     *
+     * @param vertexCount Vertices per instance
+     * @param firstInstance First instance of the range
+     * @param instanceCount Number of instances
+     */
+    void DrawArrays(unsigned vertexCount, unsigned firstInstance, unsigned instanceCount);
+
+    /**
+     * @brief Draws a range of uploaded instances of indexed geometry from the bound VAO
+     *
+     * @param indexCount Indices per instance
+     * @param indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+     * @param indexOffset Byte offset into the element buffer
+     * @param firstInstance First instance of the range
+     * @param instanceCount Number of instances
+     */
+    void DrawElements(unsigned indexCount, GLenum indexType, size_t indexOffset, unsigned firstInstance, unsigned instanceCount);
+
+    /**
+     * @brief Returns the number of instances
+     *
+     */
+    unsigned GetCount() const;
+
+private:
+    GLuint mBuffer;
+    size_t mCapacity;
+    std::vector<InstanceData> mInstances;
+
+    void pointAttributes(unsigned firstInstance);
+};
@@ -10,6 +10,19 @@
 #include "camera.hpp"
 #include "model.hpp"
 #include "texture.hpp"
+#include "textureregistry.hpp"
+#include "texturearray.hpp"
+#include "benchmark.hpp"
+#include "framestats.hpp"
+#include "glstate.hpp"
+#include "transformbatch.hpp"
+#include "geometrypool.hpp"
+#include "instancebuffer.hpp"
+#include "renderqueue.hpp"
+#include "frustumculler.hpp"
+#include "assetpack.hpp"
+#include "uniformblocks.hpp"
+#include "programcache.hpp"
 using namespace std;
 
 
@@ -24,6 +37,9 @@ const float TargetFPS = 60.0f;
 const std::string WindowTitle = "CaribbeanGL";
 const float SEA_LEVEL_CHANGE = 0.05f;
 const float FIRE_INTENSITY_CHANGE = 0.01f;
+const std::string CatModelPath = "ki61/12221_Cat_v1_l3.obj";
+// NOTE: Unit cube, CubeVertices span -0.5 to 0.5 on every axis
+const Bounds CubeBounds = Bounds::FromBox(glm::vec3(-0.5f), glm::vec3(0.5f));
 
 struct Input {
     bool MoveLeft;
@@ -36,11 +52,25 @@ struct Input {
     bool LookDown;
 };
 
+// NOTE: Phong shader permutation bits, index i turns on ShadingFeatureDefines[i]
+enum ShadingFeature {
+    SHADING_TEXTURED = 1 << 0,
+    SHADING_POINT_LIGHTS = 1 << 1,
+    SHADING_SPOTLIGHTS = 1 << 2,
+    SHADING_SPOTLIGHT_ONLY = 1 << 3,
+    // NOTE: Transforms and texture layers come from per-instance attributes
+    SHADING_INSTANCED = 1 << 4
+};
+const std::vector<std::string> ShadingFeatureDefines = { "TEXTURED", "POINT_LIGHT_COUNT 3", "SPOTLIGHT_COUNT 2", "SPOTLIGHT_ONLY", "INSTANCED" };
+
 struct EngineState {
     Input* mInput;
     Camera* mCamera;
+    // NOTE: Base ShadingFeature mask, spotlight bits are added per frame from the scene toggles
     unsigned mShadingMode;
     bool mDrawDebugLines;
+    // NOTE: Static meshes draw from the shared geometry pool with multi-draw indirect
+    bool mPooledGeometry;
     float mDT;
 };
 
@@ -80,12 +110,24 @@ KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
         }
     } break;
 
+    case GLFW_KEY_M: {
+        if (IsDown) {
+            State->mShadingMode ^= SHADING_TEXTURED; break;
+        }
+    } break;
+
     case GLFW_KEY_L: {
         if (IsDown) {
             State->mDrawDebugLines ^= true; break;
         }
     } break;
 
+    case GLFW_KEY_G: {
+        if (IsDown) {
+            State->mPooledGeometry ^= true; break;
+        }
+    } break;
+
     case GLFW_KEY_ESCAPE: glfwSetWindowShouldClose(window, GLFW_TRUE); break;
     }
 }
@@ -94,10 +136,107 @@ static void
 FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
     WindowWidth = width;
     WindowHeight = height;
-    glViewport(0, 0, width, height);
+    gGLState.SetViewport(0, 0, width, height);
 }
 
 
+/**
+ * @brief Cube draw waiting for the frame's transforms to be computed
+ *
+ */
+struct CubeDraw {
+    unsigned Transform;
+    unsigned Object;
+    TextureArrayLayer Diffuse;
+    TextureArrayLayer Specular;
+};
+
+/**
+ * @brief Adds a cube to the frame, it is drawn once every transform is known
+ *
+ */
+static void
+QueueCube(TransformBatch& transforms, FrustumCuller& culler, std::vector<CubeDraw>& draws, const glm::mat4& model,
+          const TextureArrayLayer& diffuse, const TextureArrayLayer& specular) {
+    CubeDraw Draw = { transforms.Add(model), culler.Add(CubeBounds, model), diffuse, specular };
+    draws.push_back(Draw);
+}
+
+/**
+ * @brief Sort storage of SubmitCubes, kept across frames
+ *
+ */
+struct CubeSortScratch {
+    std::vector<uint64_t> Keys;
+    std::vector<unsigned> Order;
+    std::vector<uint64_t> ScratchKeys;
+    std::vector<unsigned> ScratchOrder;
+};
+
+static bool
+SameTextureArrays(const CubeDraw& a, const CubeDraw& b) {
+    return a.Diffuse.Texture == b.Diffuse.Texture && a.Specular.Texture == b.Specular.Texture;
+}
+
+/**
+ * @brief Fills the instances of the queued cubes that survived culling and submits one instanced
+ * packet per pair of scene texture arrays. Layers within the arrays are per instance, instances
+ * of a packet are ordered front to back. Layers the streamer moved to a standalone texture get
+ * packets of their own. The queue uploads the instances when it flushes
+ *
+ */
+static void
+SubmitCubes(std::vector<CubeDraw>& draws, const TransformBatch& transforms, const FrustumCuller& culler, InstanceBuffer& instances,
+            RenderQueue& queue, Shader& shader, unsigned vao, unsigned vertexCount, const TextureArrayBuilder& textures,
+            CubeSortScratch& scratch) {
+    // NOTE: Clip w of the cube center is its view depth
+    std::vector<uint64_t>& Keys = scratch.Keys;
+    std::vector<unsigned>& Order = scratch.Order;
+    Keys.clear();
+    Order.clear();
+    for (unsigned DrawIdx = 0; DrawIdx < draws.size(); ++DrawIdx) {
+        CubeDraw& Draw = draws[DrawIdx];
+        if (!culler.IsVisible(Draw.Object)) {
+            continue;
+        }
+        Draw.Diffuse = textures.Resolve(Draw.Diffuse);
+        Draw.Specular = textures.Resolve(Draw.Specular);
+        Keys.push_back(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, RenderQueue::MakeMaterial(Draw.Diffuse.Texture, Draw.Specular.Texture),
+                                            transforms.Get(Draw.Transform).MVP[3][3]));
+        Order.push_back(DrawIdx);
+    }
+    RenderQueue::RadixSort(Keys, Order, scratch.ScratchKeys, scratch.ScratchOrder);
+
+    instances.Clear();
+    for (unsigned OrderIdx = 0; OrderIdx < Order.size(); ++OrderIdx) {
+        const CubeDraw& Draw = draws[Order[OrderIdx]];
+        instances.Add(transforms.Get(Draw.Transform), Draw.Diffuse.Layer, Draw.Specular.Layer);
+    }
+
+    unsigned First = 0;
+    for (unsigned OrderIdx = 1; OrderIdx <= Order.size(); ++OrderIdx) {
+        const CubeDraw& FirstDraw = draws[Order[First]];
+        if (OrderIdx < Order.size() && SameTextureArrays(draws[Order[OrderIdx]], FirstDraw)) {
+            continue;
+        }
+        DrawPacket Packet;
+        Packet.Program = &shader;
+        Packet.VAO = vao;
+        Packet.TextureTargets[0] = FirstDraw.Diffuse.Layer == INSTANCE_NO_LAYER ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+        Packet.TextureTargets[1] = FirstDraw.Specular.Layer == INSTANCE_NO_LAYER ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+        Packet.Textures[0] = FirstDraw.Diffuse.Texture;
+        Packet.Textures[1] = FirstDraw.Specular.Texture;
+        Packet.Count = vertexCount;
+        Packet.Instances = &instances;
+        Packet.FirstInstance = First;
+        Packet.InstanceCount = OrderIdx - First;
+        Packet.Key = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, shader.GetId(), RenderQueue::MakeMaterial(FirstDraw.Diffuse.Texture, FirstDraw.Specular.Texture),
+                                          transforms.Get(FirstDraw.Transform).MVP[3][3]);
+        queue.Submit(Packet);
+        First = OrderIdx;
+    }
+}
+
 static void
 HandleInput(EngineState* state) {
     Input* UserInput = state->mInput;
@@ -113,7 +252,38 @@ HandleInput(EngineState* state) {
     if (UserInput->LookUp) FPSCamera->Rotate(0.0f, 1.0f, state->mDT);
 }
 
-int main() {
+static int
+PackAssets(const std::string& packPath) {
+    // NOTE: Models are cooked first so their mesh caches land in the pack next to the sources
+    Model Cat(CatModelPath, VERTEX_FORMAT_COMPACT);
+    if (!Cat.Cook()) {
+        return -1;
+    }
+
+    std::vector<std::string> Directories = { "shaders", "ki61" };
+    return AssetPack::Build(packPath, Directories) ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && std::string(argv[1]) == "--bench") {
+        return Benchmark::Run(argv[2]) ? 0 : -1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--pack") {
+        return PackAssets(argc > 2 ? argv[2] : ASSET_PACK_PATH);
+    }
+
+    // NOTE: --loose reads edited files from disk before the pack, no repack needed while iterating.
+    // --serial-shaders waits on every shader as it is created, to compare against the parallel path
+    bool LooseFiles = false;
+    bool SerialShaders = false;
+    for (int ArgIdx = 1; ArgIdx < argc; ++ArgIdx) {
+        LooseFiles |= std::string(argv[ArgIdx]) == "--loose";
+        SerialShaders |= std::string(argv[ArgIdx]) == "--serial-shaders";
+    }
+    gAssetPack.SetLooseOverride(LooseFiles);
+    gAssetPack.Open(ASSET_PACK_PATH);
+    Shader::SetSerialCompile(SerialShaders);
+
     GLFWwindow* Window = 0;
     if (!glfwInit()) {
         std::cerr << "Failed to init glfw" << std::endl;
@@ -144,25 +314,47 @@ int main() {
     Input UserInput = { 0 };
     State.mCamera = &FPSCamera;
     State.mInput = &UserInput;
+    State.mShadingMode = SHADING_TEXTURED | SHADING_POINT_LIGHTS;
     glfwSetWindowUserPointer(Window, &State);
 
     glfwSetErrorCallback(ErrorCallback);
     glfwSetFramebufferSizeCallback(Window, FramebufferSizeCallback);
     glfwSetKeyCallback(Window, KeyCallback);
 
-    glViewport(0.0f, 0.0f, WindowWidth, WindowHeight);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    // NOTE: Textures are block compressed once and read back from .ktx caches afterwards
+    Texture::SetCompression(GLEW_EXT_texture_compression_s3tc);
 
-    unsigned WaterDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/background-sea-water.jpg");
-    unsigned WaterSpecularTexture = Texture::LoadImageToTexture("ki61/textures/water-specular.jpg");
-    unsigned SandDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/sand.jpg");
-    unsigned LeafDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/leaf.jpg");
-    unsigned TreeDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/tree.jpg");
-    unsigned CloudDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/cloud.png");
-    unsigned CloudSpecularTexture = Texture::LoadImageToTexture("ki61/textures/cloud-specular.png");
-    unsigned FireDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/fire.jpg");
-    unsigned LighthouseDiffuseTexture = Texture::LoadImageToTexture("ki61/textures/lighthouse.png");
+    gGLState.SetViewport(0, 0, WindowWidth, WindowHeight);
+    gGLState.SetCapability(GL_DEPTH_TEST, true);
+    gGLState.SetCapability(GL_CULL_FACE, true);
+
+    // NOTE: Scene textures decode in the background and show a placeholder until uploaded
+    TextureStreamer Streamer;
+    if (!Streamer.Init()) {
+        glfwTerminate();
+        return -1;
+    }
+    // NOTE: Scene textures share texture arrays, each draw selects its layers
+    TextureArrayBuilder SceneTextures;
+    unsigned WaterDiffuseSlot = SceneTextures.Add("ki61/textures/background-sea-water.jpg");
+    unsigned WaterSpecularSlot = SceneTextures.Add("ki61/textures/water-specular.jpg", false);
+    unsigned SandDiffuseSlot = SceneTextures.Add("ki61/textures/sand.jpg");
+    unsigned LeafDiffuseSlot = SceneTextures.Add("ki61/textures/leaf.jpg");
+    unsigned TreeDiffuseSlot = SceneTextures.Add("ki61/textures/tree.jpg");
+    unsigned CloudDiffuseSlot = SceneTextures.Add("ki61/textures/cloud.png");
+    unsigned CloudSpecularSlot = SceneTextures.Add("ki61/textures/cloud-specular.png", false);
+    unsigned FireDiffuseSlot = SceneTextures.Add("ki61/textures/fire.jpg");
+    unsigned LighthouseDiffuseSlot = SceneTextures.Add("ki61/textures/lighthouse.png");
+    SceneTextures.Build(Streamer);
+    TextureArrayLayer WaterDiffuseTexture = SceneTextures.GetLayer(WaterDiffuseSlot);
+    TextureArrayLayer WaterSpecularTexture = SceneTextures.GetLayer(WaterSpecularSlot);
+    TextureArrayLayer SandDiffuseTexture = SceneTextures.GetLayer(SandDiffuseSlot);
+    TextureArrayLayer LeafDiffuseTexture = SceneTextures.GetLayer(LeafDiffuseSlot);
+    TextureArrayLayer TreeDiffuseTexture = SceneTextures.GetLayer(TreeDiffuseSlot);
+    TextureArrayLayer CloudDiffuseTexture = SceneTextures.GetLayer(CloudDiffuseSlot);
+    TextureArrayLayer CloudSpecularTexture = SceneTextures.GetLayer(CloudSpecularSlot);
+    TextureArrayLayer FireDiffuseTexture = SceneTextures.GetLayer(FireDiffuseSlot);
+    TextureArrayLayer LighthouseDiffuseTexture = SceneTextures.GetLayer(LighthouseDiffuseSlot);
 
 
     std::vector<float> CubeVertices = {
@@ -212,10 +404,10 @@ int main() {
 
     unsigned CubeVAO;
     glGenVertexArrays(1, &CubeVAO);
-    glBindVertexArray(CubeVAO);
+    gGLState.BindVertexArray(CubeVAO);
     unsigned CubeVBO;
     glGenBuffers(1, &CubeVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, CubeVBO);
+    gGLState.BindBuffer(GL_ARRAY_BUFFER, CubeVBO);
     glBufferData(GL_ARRAY_BUFFER, CubeVertices.size() * sizeof(float), CubeVertices.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -223,70 +415,106 @@ int main() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // NOTE: All cubes are drawn instanced, transforms and texture layers come per instance
+    InstanceBuffer CubeInstances;
+    if (!CubeInstances.Create()) {
+        glfwTerminate();
+        return -1;
+    }
+    CubeInstances.BindAttributes();
+    unsigned CubeVertexCount = CubeVertices.size() / 8;
 
 
+    // NOTE: Every permutation the toggles can reach is submitted now and keeps compiling
+    // while the model loads, so switching modes never stalls on the compiler
+    std::chrono::steady_clock::time_point ShaderStartTime = std::chrono::steady_clock::now();
     Shader ColorShader("shaders/color.vert", "shaders/color.frag");
 
-    Shader PhongShaderMaterialTexture("shaders/basic.vert", "shaders/phong_material_texture.frag");
-    glUseProgram(PhongShaderMaterialTexture.GetId());
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Direction", glm::vec3(1.0f, -15.0f, -15.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Ka", glm::vec3(0.66, 0.63, 0.45)); //žućkasta ambijentalna
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Kd", glm::vec3(0.5, 0.47, 0.32)); //žućkasta difuzna
-    PhongShaderMaterialTexture.SetUniform3f("uDirLight.Ks", glm::vec3(0.9f, 0.9f, 0.9f)); //bela spekularna 
-
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Position", glm::vec3(-70.0f, -12.5f, -70.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Ka", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Kd", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight.Ks", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight.Kc", 0.05f);
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight.Kl", 0.092f);
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight.Kq", 0.032f);
-
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight2.Position", glm::vec3(7.0f, -12.0f, -27.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight2.Ka", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight2.Kd", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight2.Ks", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight2.Kc", 0.05f);
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight2.Kl", 0.092f);
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight2.Kq", 0.032f);
-
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight3.Position", glm::vec3(60.0f, -12.5f, -50.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight3.Ka", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight3.Kd", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uPointLight3.Ks", glm::vec3(1.0f, 0.58f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight3.Kc", 0.05f);
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight3.Kl", 0.092f);
-    PhongShaderMaterialTexture.SetUniform1f("uPointLight3.Kq", 0.032f);
-
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Position", glm::vec3(39.5, -7, -70));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Direction", glm::vec3(-200, -10.5, 100));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Ka", glm::vec3(0.0f, 1.0f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Kd", glm::vec3(0.0f, 1.0f, 0.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight.Ks", glm::vec3(1.0f, 1.0f, 1.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Kc", 0.05f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Kl", 0.02f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Kq", 0.005f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.Allowed", 1);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.InnerCutOff", glm::cos(glm::radians(0.0f)));
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight.OuterCutOff", glm::cos(glm::radians(120.0f)));
-
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight2.Position", glm::vec3(44.5, -7, -72));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight2.Direction", glm::vec3(200, -10.5, 100));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight2.Ka", glm::vec3(0.0f, 0.0f, 1.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight2.Kd", glm::vec3(0.0f, 0.0f, 1.0f));
-    PhongShaderMaterialTexture.SetUniform3f("uSpotlight2.Ks", glm::vec3(0.0f, 0.0f, 1.0f));
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight2.Kc", 0.05f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight2.Kl", 0.02f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight2.Kq", 0.005f);
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight2.InnerCutOff", glm::cos(glm::radians(0.0f)));
-    PhongShaderMaterialTexture.SetUniform1f("uSpotlight2.OuterCutOff", glm::cos(glm::radians(120.0f)));
-
-    PhongShaderMaterialTexture.SetUniform1i("uMaterial.Kd", 0);
-    PhongShaderMaterialTexture.SetUniform1i("uMaterial.Ks", 1);
-    PhongShaderMaterialTexture.SetUniform1f("uMaterial.Shininess", 128.0f);
-    glUseProgram(0);
+    Shader PhongShaderMaterialTexture("shaders/basic.vert", "shaders/phong_material_texture.frag", ShadingFeatureDefines, State.mShadingMode);
+    std::vector<unsigned> ShadingPermutations;
+    const unsigned ShadingModes[] = { SHADING_TEXTURED | SHADING_POINT_LIGHTS, SHADING_POINT_LIGHTS };
+    const unsigned SpotlightModes[] = { 0, SHADING_SPOTLIGHTS, SHADING_SPOTLIGHTS | SHADING_SPOTLIGHT_ONLY };
+    for (unsigned ShadingIdx = 0; ShadingIdx < 2; ++ShadingIdx) {
+        for (unsigned SpotlightIdx = 0; SpotlightIdx < 3; ++SpotlightIdx) {
+            ShadingPermutations.push_back(ShadingModes[ShadingIdx] | SpotlightModes[SpotlightIdx]);
+            ShadingPermutations.push_back(ShadingModes[ShadingIdx] | SpotlightModes[SpotlightIdx] | SHADING_INSTANCED);
+        }
+    }
+    PhongShaderMaterialTexture.WarmUp(ShadingPermutations);
+    double ShaderSubmitMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ShaderStartTime).count();
+
+    // NOTE: Light, camera and material parameters live in uniform blocks shared by all programs
+    UniformBlocks SharedBlocks;
+    if (!SharedBlocks.Create()) {
+        glfwTerminate();
+        return -1;
+    }
+    LightsBlock& Lights = SharedBlocks.EditLights();
+    Lights.DirLight.Direction = glm::normalize(glm::vec3(1.0f, -15.0f, -15.0f));
+    Lights.DirLight.Ka = glm::vec3(0.66, 0.63, 0.45); //žućkasta ambijentalna
+    Lights.DirLight.Kd = glm::vec3(0.5, 0.47, 0.32); //žućkasta difuzna
+    Lights.DirLight.Ks = glm::vec3(0.9f, 0.9f, 0.9f); //bela spekularna 
+
+    Lights.PointLights[0].Position = glm::vec3(-70.0f, -12.5f, -70.0f);
+    Lights.PointLights[0].Ka = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[0].Kd = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[0].Ks = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[0].Kc = 0.05f;
+    Lights.PointLights[0].Kl = 0.092f;
+    Lights.PointLights[0].Kq = 0.032f;
+
+    Lights.PointLights[1].Position = glm::vec3(7.0f, -12.0f, -27.0f);
+    Lights.PointLights[1].Ka = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[1].Kd = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[1].Ks = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[1].Kc = 0.05f;
+    Lights.PointLights[1].Kl = 0.092f;
+    Lights.PointLights[1].Kq = 0.032f;
+
+    Lights.PointLights[2].Position = glm::vec3(60.0f, -12.5f, -50.0f);
+    Lights.PointLights[2].Ka = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[2].Kd = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[2].Ks = glm::vec3(1.0f, 0.58f, 0.0f);
+    Lights.PointLights[2].Kc = 0.05f;
+    Lights.PointLights[2].Kl = 0.092f;
+    Lights.PointLights[2].Kq = 0.032f;
+
+    Lights.Spotlights[0].Position = glm::vec3(39.5, -7, -70);
+    Lights.Spotlights[0].Direction = glm::normalize(glm::vec3(-200, -10.5, 100));
+    Lights.Spotlights[0].Ka = glm::vec3(0.0f, 1.0f, 0.0f);
+    Lights.Spotlights[0].Kd = glm::vec3(0.0f, 1.0f, 0.0f);
+    Lights.Spotlights[0].Ks = glm::vec3(1.0f, 1.0f, 1.0f);
+    Lights.Spotlights[0].Kc = 0.05f;
+    Lights.Spotlights[0].Kl = 0.02f;
+    Lights.Spotlights[0].Kq = 0.005f;
+    Lights.Spotlights[0].InnerCutOff = glm::cos(glm::radians(0.0f));
+    Lights.Spotlights[0].OuterCutOff = glm::cos(glm::radians(120.0f));
+    Lights.Spotlights[0].Intensity = 1.0f;
+
+    Lights.Spotlights[1].Position = glm::vec3(44.5, -7, -72);
+    Lights.Spotlights[1].Direction = glm::normalize(glm::vec3(200, -10.5, 100));
+    Lights.Spotlights[1].Ka = glm::vec3(0.0f, 0.0f, 1.0f);
+    Lights.Spotlights[1].Kd = glm::vec3(0.0f, 0.0f, 1.0f);
+    Lights.Spotlights[1].Ks = glm::vec3(0.0f, 0.0f, 1.0f);
+    Lights.Spotlights[1].Kc = 0.05f;
+    Lights.Spotlights[1].Kl = 0.02f;
+    Lights.Spotlights[1].Kq = 0.005f;
+    Lights.Spotlights[1].InnerCutOff = glm::cos(glm::radians(0.0f));
+    Lights.Spotlights[1].OuterCutOff = glm::cos(glm::radians(120.0f));
+    Lights.Spotlights[1].Intensity = 2.5f;
+    for (unsigned SpotlightIdx = 0; SpotlightIdx < LIGHTS_MAX_SPOTLIGHTS; ++SpotlightIdx) {
+        DirectionalLightBlock& Spotlight = Lights.Spotlights[SpotlightIdx];
+        Spotlight.Range = UniformBlocks::AttenuationRange(Spotlight.Kc, Spotlight.Kl, Spotlight.Kq, Spotlight.Intensity);
+    }
+
+    PhongShaderMaterialTexture.SetSampler("uMaterial.Kd", 0);
+    PhongShaderMaterialTexture.SetSampler("uMaterial.Ks", 1);
+    PhongShaderMaterialTexture.SetSampler("uMaterial.KdLayers", 2);
+    PhongShaderMaterialTexture.SetSampler("uMaterial.KsLayers", 3);
+    MaterialBlock& Material = SharedBlocks.EditMaterial();
+    Material.Kd = glm::vec3(0.8f, 0.8f, 0.8f);
+    Material.Ks = glm::vec3(0.5f, 0.5f, 0.5f);
+    Material.Shininess = 128.0f;
 
     glm::mat4 Projection = glm::perspective(45.0f, WindowWidth / (float)WindowHeight, 0.1f, 100.0f);
     glm::mat4 View = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
@@ -302,50 +530,109 @@ int main() {
     float seaLevelChange = SEA_LEVEL_CHANGE;
     float fireLightIntensity = 0.05;
     float fireIntensityChange = FIRE_INTENSITY_CHANGE;
-    Model Cat("ki61/12221_Cat_v1_l3.obj");
+    Model Cat(CatModelPath, VERTEX_FORMAT_COMPACT);
     if (!Cat.Load())
     {
         std::cout << "Failed to load model!\n";
         glfwTerminate();
         return -1;
     }
+    gTextureRegistry.PrintStats();
+
+    // NOTE: Without GL 4.3 every mesh keeps drawing from its own buffers
+    GeometryPool ScenePool;
+    bool PoolReady = false;
+    if (GeometryPool::IsSupported()) {
+        Cat.AddToPool(ScenePool);
+        PoolReady = ScenePool.Create();
+    } else {
+        std::cout << "[Info] Multi-draw indirect not supported, meshes draw one at a time" << std::endl;
+    }
+    State.mPooledGeometry = PoolReady;
+
+    // NOTE: Loading phase, the window stays responsive until the last permutation is built
+    std::chrono::steady_clock::time_point ShaderWaitTime = std::chrono::steady_clock::now();
+    while (PhongShaderMaterialTexture.GetPendingCount() && !glfwWindowShouldClose(Window)) {
+        glfwPollEvents();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glfwSwapBuffers(Window);
+    }
+    unsigned ProgramCount = PhongShaderMaterialTexture.FinishAll() + ColorShader.FinishAll();
+    std::cout << "[Info] " << ProgramCount << " shader programs (" << (SerialShaders ? "serial" : "parallel") << " compile): " << ShaderSubmitMS
+              << "ms submitting, " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ShaderWaitTime).count()
+              << "ms waiting after the model loaded" << std::endl;
+    ProgramCache::PrintStats();
     float gComponent = 0.58;
     float bComponent = 0;
 
     float Angle = 0.0f;
     float Distance = 5.0f;
+    RenderView CurrentView;
+    // NOTE: Draws without their own specular map reuse the last one, as they did with plain texture units
+    TextureArrayLayer SpecularTexture = WaterSpecularTexture;
+    TransformBatch FrameTransforms;
+    std::vector<CubeDraw> CubeDraws;
+    CubeSortScratch CubeSort;
+    RenderQueue FrameQueue;
+    FrustumCuller FrameCuller;
+    float StatsTime = glfwGetTime();
+    bool FirstFrame = true;
     while (!glfwWindowShouldClose(Window)) {
         glfwPollEvents();
         HandleInput(&State);
+        gFrameStats.Reset();
+        Streamer.Update();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         View = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
+        CurrentView.View = View;
+        CurrentView.Projection = Projection;
+        CurrentView.ViewProjection = Projection * View;
+        CurrentView.Position = FPSCamera.GetPosition();
+        CurrentView.ViewportHeight = WindowHeight;
         StartTime = glfwGetTime();
-        glUseProgram(CurrentShader->GetId());
-        CurrentShader->SetProjection(Projection);
-        CurrentShader->SetView(View);
-        CurrentShader->SetUniform3f("uViewPos", FPSCamera.GetPosition());
-
-        if (spotlightOnly && !cloudsEnabled) {
-            CurrentShader->SetUniform1f("uSpotlight2.Allowed", 1);
+        unsigned ShadingFeatures = State.mShadingMode;
+        if (!cloudsEnabled) {
+            ShadingFeatures |= SHADING_SPOTLIGHTS | (spotlightOnly ? SHADING_SPOTLIGHT_ONLY : 0);
         }
-        else {
-            CurrentShader->SetUniform1f("uSpotlight2.Allowed", 0);
+        CurrentShader = &PhongShaderMaterialTexture.GetVariant(ShadingFeatures);
+        Shader& CubeShader = PhongShaderMaterialTexture.GetVariant(ShadingFeatures | SHADING_INSTANCED);
+        FrameTransforms.Clear();
+        FrameCuller.Clear();
+        CubeDraws.clear();
+
+        // NOTE: Everything the blocks hold is settled before the first draw and sent in one update.
+        // Edited on copies, so a block that came out the same isn't uploaded again
+        CameraBlock FrameCamera = SharedBlocks.GetCamera();
+        FrameCamera.View = View;
+        FrameCamera.Projection = Projection;
+        FrameCamera.Position = FPSCamera.GetPosition();
+        SharedBlocks.SetCamera(FrameCamera);
+
+        fireLightIntensity += fireIntensityChange;
+        if (fireLightIntensity > 1.0) fireIntensityChange = -FIRE_INTENSITY_CHANGE;
+        if (fireLightIntensity < 0.0) fireIntensityChange = FIRE_INTENSITY_CHANGE;
+        glm::vec3 SpotLightPosition(Distance * cos(Angle), 2.0f, -2.0f + Distance * sin(Angle));
+        Angle += State.mDT;
+        glm::vec3 SpotLightPosition2(-Distance * cos(Angle), 2.0f, 2.0f - Distance * sin(Angle));
+
+        LightsBlock FrameLights = SharedBlocks.GetLights();
+        FrameLights.Spotlights[0].Direction = glm::normalize(SpotLightPosition);
+        FrameLights.Spotlights[1].Direction = glm::normalize(SpotLightPosition2);
+        // NOTE: The fire flicker changes Kc, so the point light ranges follow it
+        for (unsigned PointLightIdx = 0; PointLightIdx < 3; ++PointLightIdx) {
+            PositionalLightBlock& PointLight = FrameLights.PointLights[PointLightIdx];
+            PointLight.Kc = fireLightIntensity;
+            PointLight.Range = UniformBlocks::AttenuationRange(PointLight.Kc, PointLight.Kl, PointLight.Kq);
         }
+        SharedBlocks.SetLights(FrameLights);
+        SharedBlocks.Upload();
+
         #pragma region Lighthouse
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(40, -10, -70));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(3, 20, -1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, LighthouseDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glm::vec3 SpotLightPosition(Distance * cos(Angle), 2.0f, -2.0f + Distance * sin(Angle));
-        Angle += State.mDT;
-        glm::vec3 SpotLightPosition2(-Distance * cos(Angle), 2.0f, 2.0f - Distance * sin(Angle));
-        CurrentShader->SetUniform3f("uSpotlight.Direction", SpotLightPosition);
-        CurrentShader->SetUniform3f("uSpotlight2.Direction", SpotLightPosition2);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, LighthouseDiffuseTexture, SpecularTexture);
 
         
         #pragma endregion
@@ -354,96 +641,52 @@ int main() {
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0, -23, -13));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(700, seaLevel, 400));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, WaterDiffuseTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, WaterSpecularTexture);
-        glBindVertexArray(CubeVAO);
+        SpecularTexture = WaterSpecularTexture;
         seaLevel += seaLevelChange;
         if (seaLevel > 15) seaLevelChange = -SEA_LEVEL_CHANGE;
         if (seaLevel < 12) seaLevelChange = SEA_LEVEL_CHANGE;
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, WaterDiffuseTexture, SpecularTexture);
         #pragma endregion
 
         #pragma region Islands
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.6, -17.5, -30));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(40, 6, 30));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, SandDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, SandDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(60, -17.5, -50));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(10, 6, 10));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, SandDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, SandDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-70, -17.5, -70));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(30, 6, 10));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, SandDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, SandDiffuseTexture, SpecularTexture);
         #pragma endregion
 
         #pragma region Clouds
         if (cloudsEnabled) {
-            CurrentShader->SetUniform1f("uSpotlight.Allowed", 0);
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, glm::vec3(30, 17, -70));
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(30, 10, 10));
-            CurrentShader->SetModel(ModelMatrix);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, CloudDiffuseTexture);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, CloudSpecularTexture);
-            glBindVertexArray(CubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+            SpecularTexture = CloudSpecularTexture;
+            QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, CloudDiffuseTexture, SpecularTexture);
 
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-30, 17, -70));
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(20, 8, 10));
-            CurrentShader->SetModel(ModelMatrix);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, CloudDiffuseTexture);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, CloudSpecularTexture);
-            glBindVertexArray(CubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+            QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, CloudDiffuseTexture, SpecularTexture);
 
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, glm::vec3(80, 14, -75));
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(15, 5, 6));
-            CurrentShader->SetModel(ModelMatrix);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, CloudDiffuseTexture);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, CloudSpecularTexture);
-            glBindVertexArray(CubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+            QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, CloudDiffuseTexture, SpecularTexture);
 
             ModelMatrix = glm::mat4(1.0f);
             ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-80, 34, -75));
             ModelMatrix = glm::scale(ModelMatrix, glm::vec3(15, 5, 6));
-            CurrentShader->SetModel(ModelMatrix);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, CloudDiffuseTexture);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, CloudSpecularTexture);
-            glBindVertexArray(CubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
-        }
-        else {
-            CurrentShader->SetUniform1f("uSpotlight.Allowed", 1);
+            QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, CloudDiffuseTexture, SpecularTexture);
         }
         #pragma endregion
 
@@ -452,19 +695,15 @@ int main() {
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.05, 0.05, 0.05));
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.6, -253.5, -500));
         ModelMatrix = glm::rotate(ModelMatrix, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
-        CurrentShader->SetModel(ModelMatrix);
-        Cat.Render(); 
+        unsigned CatTransform = FrameTransforms.Add(ModelMatrix);
+        unsigned CatObjects = Cat.AddBounds(FrameCuller, ModelMatrix);
         #pragma endregion
 
         #pragma region Palm tree
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(1.5, -6.5, -27.5));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1, 14, 1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, TreeDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, TreeDiffuseTexture, SpecularTexture);
         #pragma endregion
 
         #pragma region Palm leaves
@@ -472,93 +711,75 @@ int main() {
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-0.5, 1, -25.5));
         ModelMatrix = glm::rotate(ModelMatrix, glm::radians(30.0f), glm::vec3(1.0, 1.0, 0.0));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5, 1, 1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, LeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, LeafDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.5, 2, -27.5));
         ModelMatrix = glm::rotate(ModelMatrix, glm::radians(120.0f), glm::vec3(-0.8, 0.5, 0.0));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5, 1, 1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, LeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, LeafDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(2.5, 2, -27.5));
         ModelMatrix = glm::rotate(ModelMatrix, glm::radians(75.0f), glm::vec3(0.5, 0.5, 0.0));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5, 1, 1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, LeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, LeafDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(3.5, 1, -25.5));
         ModelMatrix = glm::rotate(ModelMatrix, glm::radians(330.0f), glm::vec3(1.0, 1.0, 0.0));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5, 1, 1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, LeafDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, LeafDiffuseTexture, SpecularTexture);
         #pragma endregion
 
         #pragma region Sun
         ModelMatrix = glm::mat4(1.0f); 
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0, 17, -50));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1, 1, -1));
-        CurrentShader->SetModel(ModelMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, FireDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, FireDiffuseTexture, SpecularTexture);
         #pragma endregion
 
         #pragma region Fire
-        fireLightIntensity += fireIntensityChange;
-        if (fireLightIntensity > 1.0) fireIntensityChange = -FIRE_INTENSITY_CHANGE;
-        if (fireLightIntensity < 0.0) fireIntensityChange = FIRE_INTENSITY_CHANGE;
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-70, -12.5, -70));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(3, 3, -4));
-        CurrentShader->SetModel(ModelMatrix);
-        CurrentShader->SetUniform1f("uPointLight.Kc", fireLightIntensity);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, FireDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, FireDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(7, -12, -27));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(3, 3, -4));
-        CurrentShader->SetModel(ModelMatrix);
-        CurrentShader->SetUniform1f("uPointLight2.Kc", fireLightIntensity);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, FireDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, FireDiffuseTexture, SpecularTexture);
 
         ModelMatrix = glm::mat4(1.0f);
         ModelMatrix = glm::translate(ModelMatrix, glm::vec3(60, -12.5, -50));
         ModelMatrix = glm::scale(ModelMatrix, glm::vec3(3, 3, -4));
-        CurrentShader->SetModel(ModelMatrix);
-        CurrentShader->SetUniform1f("uPointLight3.Kc", fireLightIntensity);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, FireDiffuseTexture);
-        glBindVertexArray(CubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, CubeVertices.size() / 8);
+        QueueCube(FrameTransforms, FrameCuller, CubeDraws, ModelMatrix, FireDiffuseTexture, SpecularTexture);
         #pragma endregion
 
-        
-        glBindVertexArray(0);
-        glUseProgram(0);
+        // NOTE: Every object of the frame is known, their MVP and normal matrices are computed in one batch
+        FrameTransforms.Compute(CurrentView.ViewProjection);
+        // NOTE: Cubes and model meshes outside the view never reach the queue. Culls with the
+        // same view-projection the transforms were computed with
+        FrameCuller.Cull(Frustum::FromMatrix(CurrentView.ViewProjection));
+        FrameQueue.Clear();
+        SubmitCubes(CubeDraws, FrameTransforms, FrameCuller, CubeInstances, FrameQueue, CubeShader, CubeVAO, CubeVertexCount, SceneTextures, CubeSort);
+        // NOTE: Pooled meshes read their transforms per draw like the cubes do per instance
+        bool Pooled = PoolReady && State.mPooledGeometry;
+        Cat.Submit(FrameQueue, Pooled ? CubeShader : *CurrentShader, FrameTransforms.Get(CatTransform), CurrentView, FrameCuller, CatObjects, Pooled);
+        // NOTE: The queue sorts by program, textures and depth and is the only GL user while drawing
+        FrameQueue.Flush();
+
+        // NOTE: Program and VAO stay bound into the next frame, which usually starts with the same ones
         glfwSwapBuffers(Window);
+        if (FirstFrame) {
+            std::cout << "[Info] First frame after " << glfwGetTime() * 1000.0 << "ms, " << Streamer.GetPendingCount() << " textures still streaming" << std::endl;
+            FirstFrame = false;
+        }
+
+        if (glfwGetTime() - StatsTime >= 1.0f) {
+            gFrameStats.Print();
+            StatsTime = glfwGetTime();
+        }
 
         EndTime = glfwGetTime();
         float WorkTime = EndTime - StartTime;
@@ -570,6 +791,13 @@ int main() {
         State.mDT = EndTime - StartTime;
     }
 
+    Streamer.Shutdown();
+    SharedBlocks.Destroy();
+    CubeInstances.Destroy();
+    ScenePool.Destroy();
+    Cat.Destroy();
+    SceneTextures.Release();
+    gAssetPack.Close();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
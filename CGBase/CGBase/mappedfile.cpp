@@ -0,0 +1,120 @@
+#include "mappedfile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+    mData = 0;
+    mSize = 0;
+    mFileHandle = 0;
+    mMappingHandle = 0;
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+bool
+MappedFile::Open(const std::string& filePath) {
+    Close();
+    HANDLE File = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0) {
+        CloseHandle(File);
+        return false;
+    }
+
+    HANDLE Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!Mapping) {
+        CloseHandle(File);
+        return false;
+    }
+
+    void* View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!View) {
+        CloseHandle(Mapping);
+        CloseHandle(File);
+        return false;
+    }
+
+    mFileHandle = File;
+    mMappingHandle = Mapping;
+    mData = (const unsigned char*)View;
+    mSize = (size_t)FileSize.QuadPart;
+    return true;
+}
+
+void
+MappedFile::Close() {
+    if (mData) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMappingHandle) {
+        CloseHandle((HANDLE)mMappingHandle);
+    }
+    if (mFileHandle) {
+        CloseHandle((HANDLE)mFileHandle);
+    }
+    mData = 0;
+    mSize = 0;
+    mFileHandle = 0;
+    mMappingHandle = 0;
+}
+#else
+bool
+MappedFile::Open(const std::string& filePath) {
+    Close();
+    int File = open(filePath.c_str(), O_RDONLY);
+    if (File < 0) {
+        return false;
+    }
+
+    struct stat FileStat;
+    if (fstat(File, &FileStat) != 0 || FileStat.st_size == 0) {
+        close(File);
+        return false;
+    }
+
+    void* View = mmap(0, FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+    close(File);
+    if (View == MAP_FAILED) {
+        return false;
+    }
+
+    mData = (const unsigned char*)View;
+    mSize = (size_t)FileStat.st_size;
+    return true;
+}
+
+void
+MappedFile::Close() {
+    if (mData) {
+        munmap((void*)mData, mSize);
+    }
+    mData = 0;
+    mSize = 0;
+}
+#endif
+
+const unsigned char*
+MappedFile::Data() const {
+    return mData;
+}
+
+size_t
+MappedFile::Size() const {
+    return mSize;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file mappedfile.hpp
+ * @brief Read-only memory-mapped file
+ *
+ */
+
+#pragma once
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * @brief Maps the whole file into memory for reading
+     *
+     * @param filePath File path
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Open(const std::string& filePath);
+
+    /**
+     * @brief Unmaps the file. Safe to call on a closed file
+     *
+     */
+    void Close();
+
+    /**
+     * @brief Returns pointer to the start of the mapping
+     *
+     * @returns Mapped bytes, NULL if nothing is mapped
+     */
+    const unsigned char* Data() const;
+
+    /**
+     * @brief Returns size of the mapping
+     *
+     * @returns Size in bytes
+     */
+    size_t Size() const;
+
+private:
+    const unsigned char* mData;
+    size_t mSize;
+    void* mFileHandle;
+    void* mMappingHandle;
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
@@ -1,93 +1,498 @@
 #include "mesh.hpp"
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include "simd.hpp"
+#include "framestats.hpp"
+#include "geometrypool.hpp"
+#include "glstate.hpp"
+#include "textureregistry.hpp"
 
-Mesh::Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string &resPath) {
-    processMesh(mesh, material, resPath);
+static const float LOD_TRIANGLE_RATIOS[MESH_MAX_LODS] = { 1.0f, 0.5f, 0.25f, 0.1f };
+// NOTE: Relative to the mesh AABB diagonal. Coarse levels may look rough up close,
+// selection only picks them once their error projects to under LOD_PIXEL_ERROR
+static const float LOD_MAX_RELATIVE_ERROR = 0.05f;
+// NOTE: A level is dropped unless it removes at least this fraction of the previous level's triangles
+static const float LOD_MIN_REDUCTION = 0.1f;
+static const float LOD_PIXEL_ERROR = 1.0f;
+
+Mesh::Mesh(MeshData& data) {
+    mVertices = data.Vertices;
+    mIndices = data.Indices;
+    mVertexCount = mVertices.size() / MESH_VERTEX_FLOATS;
+    mIndexCount = mIndices.size();
+    if (data.GPUVertices.empty()) {
+        EncodeBuffers(data, VERTEX_FORMAT_FLOAT);
+    }
+    mFormat = data.Format;
+    mIndexType = data.GPUIndices.size() == mIndexCount * sizeof(unsigned short) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mUVTransform = data.UVTransform;
+    mLODs = data.LODs;
+    if (mLODs.empty()) {
+        MeshLOD FullDetail = { 0, mIndexCount, 0.0f, 0, 0 };
+        mLODs.push_back(FullDetail);
+    }
+    mMeshlets.swap(data.Meshlets);
+    mBounds = Bounds::FromBox(data.BoundsMin, data.BoundsMax);
+    mBounds.Radius = data.BoundsRadius;
+    mDequantize = glm::mat4(1.0f);
+    if (mFormat == VERTEX_FORMAT_COMPACT) {
+        mDequantize = glm::scale(glm::translate(glm::mat4(1.0f), data.BoundsMin), quantizationExtent(data.BoundsMin, data.BoundsMax));
+    }
+
+    mPool = 0;
+    mPoolAllocation = 0;
+
+    mDiffuseTexture = gTextureRegistry.Acquire(data.DiffuseImage);
+    mSpecularTexture = gTextureRegistry.Acquire(data.SpecularImage);
+
+    glGenVertexArrays(1, &mVAO);
+    gGLState.BindVertexArray(mVAO);
+    glGenBuffers(1, &mVBO);
+    gGLState.BindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, data.GPUVertices.size(), data.GPUVertices.data(), GL_STATIC_DRAW);
+    if (mFormat == VERTEX_FORMAT_COMPACT) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, UV));
+        glEnableVertexAttribArray(2);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+    }
+    
+    // NOTE: The element buffer binding is recorded in the VAO, it must stay bound while the VAO is
+    mEBO = 0;
+    if (mIndexCount) {
+        glGenBuffers(1, &mEBO);
+        gGLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.GPUIndices.size(), data.GPUIndices.data(), GL_STATIC_DRAW);
+    }
+
+    std::vector<unsigned char>().swap(data.GPUVertices);
+    std::vector<unsigned char>().swap(data.GPUIndices);
 }
 
 void
-Mesh::Render() const {
-    glBindVertexArray(mVAO);
+Mesh::Destroy() {
+    gTextureRegistry.Release(mDiffuseTexture);
+    gTextureRegistry.Release(mSpecularTexture);
+    gGLState.DeleteVertexArray(mVAO);
+    gGLState.DeleteBuffer(mVBO);
+    gGLState.DeleteBuffer(mEBO);
+    mDiffuseTexture = mSpecularTexture = 0;
+    mVAO = mVBO = mEBO = 0;
+}
 
-    if (mDiffuseTexture) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mDiffuseTexture);
+void
+Mesh::AddToPool(GeometryPool& pool) {
+    if (!mIndexCount) {
+        return;
     }
+    mPool = &pool;
+    mPoolAllocation = pool.Add(mVertices, mIndices);
+}
 
-    if (mSpecularTexture) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mSpecularTexture);
+void
+Mesh::Submit(RenderQueue& queue, Shader& shader, const ObjectTransform& transform, const RenderView& view, bool pooled) const {
+    const glm::mat4& model = transform.Model;
+    pooled = pooled && mPool;
+    DrawParams Params;
+    Params.Transform = transform;
+    Params.UVTransform = mUVTransform;
+    Params.CompactVertices = mFormat == VERTEX_FORMAT_COMPACT && !pooled;
+    if (Params.CompactVertices) {
+        // NOTE: Dequantization is a translation and scale in mesh space, folded into the model
+        // and MVP matrices. The object's normal matrix applies to the decoded normals unchanged
+        Params.Transform.Model = model * mDequantize;
+        Params.Transform.MVP = transform.MVP * mDequantize;
     }
 
-    if (mIndexCount) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, (void*)0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    DrawPacket Packet;
+    Packet.Program = &shader;
+    Packet.VAO = pooled ? mPool->GetVAO() : mVAO;
+    Packet.TextureTargets[0] = Packet.TextureTargets[1] = GL_TEXTURE_2D;
+    Packet.Textures[0] = mDiffuseTexture;
+    Packet.Textures[1] = mSpecularTexture;
+    float Depth = (transform.MVP * glm::vec4(mBounds.Center, 1.0f)).w;
+    Packet.Key = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, shader.GetId(), RenderQueue::MakeMaterial(mDiffuseTexture, mSpecularTexture), Depth);
+
+    if (!mIndexCount) {
+        Packet.Params = queue.AddParams(Params);
+        Packet.Count = mVertexCount;
+        queue.Submit(Packet);
+        return;
+    }
+
+    const MeshLOD& LOD = mLODs[selectLOD(model, view)];
+    gFrameStats.TrianglesLODSkipped += (mLODs[0].IndexCount - LOD.IndexCount) / 3;
+    size_t IndexSize = mIndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned);
+    // NOTE: Offsets below are in indices from the start of the mesh, the pool stores it further in
+    size_t IndexBase = 0;
+    Packet.IndexType = mIndexType;
+    if (pooled) {
+        const GeometryAllocation& Allocation = mPool->GetAllocation(mPoolAllocation);
+        Packet.Pool = mPool;
+        Packet.BaseVertex = Allocation.BaseVertex;
+        Packet.IndexType = GL_UNSIGNED_INT;
+        IndexSize = sizeof(unsigned);
+        IndexBase = Allocation.FirstIndex;
+    }
+    if (!LOD.MeshletCount) {
+        Packet.Params = queue.AddParams(Params);
+        Packet.First = (IndexBase + LOD.IndexOffset) * IndexSize;
+        Packet.Count = LOD.IndexCount;
+        queue.Submit(Packet);
         return;
     }
 
-    glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
-    glBindVertexArray(0);
+    // NOTE: Meshlet bounds are in mesh (model) space, so bring the frustum and the
+    // viewer there instead of transforming every sphere
+    Frustum ModelFrustum = Frustum::FromMatrix(transform.MVP);
+    glm::vec3 ModelViewPosition = glm::vec3(glm::inverse(model) * glm::vec4(view.Position, 1.0f));
+    // NOTE: Mirroring transforms flip winding, cones would reject the wrong side
+    bool ConeCulling = glm::determinant(model) > 0.0f;
+
+    unsigned RangeStart = 0;
+    unsigned RangeEnd = 0;
+    for (unsigned MeshletIdx = LOD.MeshletOffset; MeshletIdx < LOD.MeshletOffset + LOD.MeshletCount; ++MeshletIdx) {
+        const Meshlet& Current = mMeshlets[MeshletIdx];
+        gFrameStats.MeshletsTested++;
+        gFrameStats.TrianglesTested += Current.TriangleCount;
+
+        bool BackfaceCulled = false;
+        bool Culled = ConeCulling
+            ? MeshletBuilder::IsCulled(Current, ModelFrustum, ModelViewPosition, BackfaceCulled)
+            : !ModelFrustum.IntersectsSphere(Current.Center, Current.Radius);
+        if (Culled) {
+            gFrameStats.MeshletsBackfaceCulled += BackfaceCulled;
+            gFrameStats.MeshletsFrustumCulled += !BackfaceCulled;
+            gFrameStats.TrianglesCulled += Current.TriangleCount;
+            continue;
+        }
+
+        // NOTE: Meshlets are contiguous, merge neighbouring survivors into one range
+        if (RangeEnd == Current.IndexOffset && RangeEnd != RangeStart) {
+            RangeEnd += Current.TriangleCount * 3;
+            continue;
+        }
+        if (RangeEnd != RangeStart) {
+            unsigned Range = queue.AddRange(RangeEnd - RangeStart, (IndexBase + RangeStart) * IndexSize);
+            Packet.RangeFirst = Packet.RangeCount ? Packet.RangeFirst : Range;
+            Packet.RangeCount++;
+        }
+        RangeStart = Current.IndexOffset;
+        RangeEnd = RangeStart + Current.TriangleCount * 3;
+    }
+    if (RangeEnd != RangeStart) {
+        unsigned Range = queue.AddRange(RangeEnd - RangeStart, (IndexBase + RangeStart) * IndexSize);
+        Packet.RangeFirst = Packet.RangeCount ? Packet.RangeFirst : Range;
+        Packet.RangeCount++;
+    }
+
+    if (Packet.RangeCount) {
+        Packet.Params = queue.AddParams(Params);
+        queue.Submit(Packet);
+    }
+}
+
+const Bounds&
+Mesh::GetBounds() const {
+    return mBounds;
 }
 
 unsigned
-Mesh::loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type) {
+Mesh::selectLOD(const glm::mat4& model, const RenderView& view) const {
+    // NOTE: Largest axis scale bounds how much the model matrix can stretch an error
+    float Scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 Center = glm::vec3(model * glm::vec4(mBounds.Center, 1.0f));
+    float Distance = glm::length(Center - view.Position) - mBounds.Radius * Scale;
+    if (Distance <= 0.0f) {
+        return 0;
+    }
+
+    // NOTE: Projection[1][1] is cot(fovy / 2), so this is the size of one world unit in pixels at Distance
+    float PixelsPerUnit = view.Projection[1][1] * view.ViewportHeight * 0.5f / Distance;
+    unsigned Selected = 0;
+    for (unsigned LODIdx = 1; LODIdx < mLODs.size(); ++LODIdx) {
+        if (mLODs[LODIdx].Error * Scale * PixelsPerUnit > LOD_PIXEL_ERROR) {
+            break;
+        }
+        Selected = LODIdx;
+    }
+    return Selected;
+}
+
+void
+Mesh::GenerateLODs(MeshData& data) {
+    size_t VertexCount = data.Vertices.size() / MESH_VERTEX_FLOATS;
+    size_t FullIndexCount = data.Indices.size();
+    float TargetError = glm::length(data.BoundsMax - data.BoundsMin) * LOD_MAX_RELATIVE_ERROR;
+    MeshLOD FullDetail = { 0, (unsigned)FullIndexCount, 0.0f, 0, 0 };
+    data.LODs.assign(1, FullDetail);
+
+    std::vector<unsigned> Simplified(FullIndexCount);
+    for (unsigned LODIdx = 1; LODIdx < MESH_MAX_LODS; ++LODIdx) {
+        size_t TargetIndexCount = (size_t)(FullIndexCount / 3 * LOD_TRIANGLE_RATIOS[LODIdx]) * 3;
+        float Error = 0.0f;
+        size_t IndexCount = MeshSimplifier::Simplify(Simplified.data(), data.Indices.data(), FullIndexCount, data.Vertices.data(), VertexCount, MESH_VERTEX_FLOATS, TargetIndexCount, TargetError, Error);
+        // NOTE: The error bound or locked seams stopped the simplifier early, coarser targets won't do better
+        if (IndexCount > data.LODs.back().IndexCount * (1.0f - LOD_MIN_REDUCTION)) {
+            break;
+        }
+
+        MeshOptimizer::OptimizeVertexCache(Simplified.data(), IndexCount, VertexCount);
+        MeshLOD LOD = { (unsigned)data.Indices.size(), (unsigned)IndexCount, Error, 0, 0 };
+        data.LODs.push_back(LOD);
+        data.Indices.insert(data.Indices.end(), Simplified.begin(), Simplified.begin() + IndexCount);
+    }
+}
+
+void
+Mesh::BuildMeshlets(MeshData& data) {
+    data.Meshlets.clear();
+    std::vector<Meshlet> LODMeshlets;
+    for (unsigned LODIdx = 0; LODIdx < data.LODs.size(); ++LODIdx) {
+        MeshLOD& LOD = data.LODs[LODIdx];
+        MeshletBuilder::Build(data.Vertices.data(), MESH_VERTEX_FLOATS, data.Indices.data() + LOD.IndexOffset, LOD.IndexCount, LODMeshlets);
+        LOD.MeshletOffset = data.Meshlets.size();
+        LOD.MeshletCount = LODMeshlets.size();
+        for (unsigned MeshletIdx = 0; MeshletIdx < LODMeshlets.size(); ++MeshletIdx) {
+            LODMeshlets[MeshletIdx].IndexOffset += LOD.IndexOffset;
+            data.Meshlets.push_back(LODMeshlets[MeshletIdx]);
+        }
+    }
+}
+
+void
+Mesh::DecodeTexture(const std::string& filePath, bool srgb, TextureImage& image) {
+    // NOTE: Already resident textures are shared by path, the GL phase won't need pixels
+    if (!gTextureRegistry.Contains(filePath, srgb)) {
+        Texture::DecodeImage(filePath, image, srgb);
+    }
+    // NOTE: A failed decode comes back as the missing texture, the meshes sharing this file look it up by path
+    image.Path = filePath;
+    image.SRGB = srgb;
+}
+
+glm::vec3
+Mesh::quantizationExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 Extent = boundsMax - boundsMin;
+    // NOTE: Flat axes quantize to 0 anyway, 1 keeps the dequantization matrix invertible
+    for (unsigned Axis = 0; Axis < 3; ++Axis) {
+        if (Extent[Axis] <= 0.0f) {
+            Extent[Axis] = 1.0f;
+        }
+    }
+    return Extent;
+}
+
+static unsigned short
+quantizeUnorm16(float v) {
+    v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+    return (unsigned short)(v * 65535.0f + 0.5f);
+}
+
+static short
+quantizeSnorm16(float v) {
+    v = v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+    return (short)(v * 32767.0f + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+/**
+ * @brief Octahedral normal encoding: project onto the |x|+|y|+|z|=1 octahedron and
+ * fold the lower hemisphere over the diagonals. Decoded by OctDecode in basic.vert
+ *
+ */
+static void
+encodeOctahedral(float x, float y, float z, short* out) {
+    float L1 = fabsf(x) + fabsf(y) + fabsf(z);
+    if (L1 <= 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    x /= L1;
+    y /= L1;
+    z /= L1;
+    if (z < 0.0f) {
+        float FoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float FoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = FoldedX;
+        y = FoldedY;
+    }
+    out[0] = quantizeSnorm16(x);
+    out[1] = quantizeSnorm16(y);
+}
+
+void
+Mesh::EncodeBuffers(MeshData& data, VertexFormat format) {
+    size_t VertexCount = data.Vertices.size() / MESH_VERTEX_FLOATS;
+    const float* Vertices = data.Vertices.data();
+    data.Format = format;
+    data.UVTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+    if (format == VERTEX_FORMAT_COMPACT) {
+        glm::vec2 UVMin(FLT_MAX, FLT_MAX);
+        glm::vec2 UVMax(-FLT_MAX, -FLT_MAX);
+        for (size_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx) {
+            const float* UV = Vertices + VertexIdx * MESH_VERTEX_FLOATS + 6;
+            UVMin = glm::vec2(glm::min(UVMin.x, UV[0]), glm::min(UVMin.y, UV[1]));
+            UVMax = glm::vec2(glm::max(UVMax.x, UV[0]), glm::max(UVMax.y, UV[1]));
+        }
+        glm::vec2 UVExtent(UVMax.x > UVMin.x ? UVMax.x - UVMin.x : 1.0f, UVMax.y > UVMin.y ? UVMax.y - UVMin.y : 1.0f);
+        if (!VertexCount) {
+            UVMin = glm::vec2(0.0f, 0.0f);
+        }
+        data.UVTransform = glm::vec4(UVExtent.x, UVExtent.y, UVMin.x, UVMin.y);
+
+        glm::vec3 Extent = quantizationExtent(data.BoundsMin, data.BoundsMax);
+        data.GPUVertices.resize(VertexCount * sizeof(CompactVertex));
+        CompactVertex* Out = (CompactVertex*)data.GPUVertices.data();
+        for (size_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx) {
+            const float* In = Vertices + VertexIdx * MESH_VERTEX_FLOATS;
+            for (unsigned Axis = 0; Axis < 3; ++Axis) {
+                Out->Position[Axis] = quantizeUnorm16((In[Axis] - data.BoundsMin[Axis]) / Extent[Axis]);
+            }
+            Out->Position[3] = 0;
+            encodeOctahedral(In[3], In[4], In[5], Out->Normal);
+            Out->UV[0] = quantizeUnorm16((In[6] - UVMin.x) / UVExtent.x);
+            Out->UV[1] = quantizeUnorm16((In[7] - UVMin.y) / UVExtent.y);
+            ++Out;
+        }
+    } else {
+        data.GPUVertices.resize(data.Vertices.size() * sizeof(float));
+        memcpy(data.GPUVertices.data(), Vertices, data.GPUVertices.size());
+    }
+
+    if (VertexCount < 65536) {
+        data.GPUIndices.resize(data.Indices.size() * sizeof(unsigned short));
+        unsigned short* Out = (unsigned short*)data.GPUIndices.data();
+        for (size_t IndexIdx = 0; IndexIdx < data.Indices.size(); ++IndexIdx) {
+            Out[IndexIdx] = (unsigned short)data.Indices[IndexIdx];
+        }
+    } else {
+        data.GPUIndices.resize(data.Indices.size() * sizeof(unsigned));
+        memcpy(data.GPUIndices.data(), data.Indices.data(), data.GPUIndices.size());
+    }
+}
+
+std::string
+Mesh::getMaterialTexturePath(const aiMaterial* material, aiTextureType type) {
     if (material && material->GetTextureCount(type) > 0) {
         aiString Path;
         if (material->GetTexture(type, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
-            std::string FullPath = resPath + "/" + Path.data;
-            unsigned TextureID = Texture::LoadImageToTexture(FullPath);
-            return TextureID;
+            return Path.data;
         }
     }
 
-    return 0;
+    return "";
 }
 
 void
-Mesh::processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath) {
-    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+Mesh::ProcessMesh(const aiMesh* mesh, const aiMaterial* material, MeshData& data) {
+    data.Vertices.resize((size_t)mesh->mNumVertices * MESH_VERTEX_FLOATS);
+    PackVertices(mesh, data.Vertices.data(), data.BoundsMin, data.BoundsMax);
 
-    for (unsigned VertexIndex = 0; VertexIndex < mesh->mNumVertices; ++VertexIndex) {
-        std::vector<float> Position = { mesh->mVertices[VertexIndex].x, mesh->mVertices[VertexIndex].y, mesh->mVertices[VertexIndex].z };
-        mVertices.insert(mVertices.end(), Position.begin(), Position.end());
-        std::vector<float> Normals = { mesh->mNormals[VertexIndex].x, mesh->mNormals[VertexIndex].y, mesh->mNormals[VertexIndex].z };
-        mVertices.insert(mVertices.end(), Normals.begin(), Normals.end());
-        const aiVector3D* TexCoords = mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][VertexIndex]) : &Zero3D;
-        std::vector<float> UV = { TexCoords->x, TexCoords->y };
-        mVertices.insert(mVertices.end(), UV.begin(), UV.end());
+    glm::vec3 Center = (data.BoundsMin + data.BoundsMax) * 0.5f;
+    float RadiusSquared = 0.0f;
+    for (size_t VertexIdx = 0; VertexIdx < mesh->mNumVertices; ++VertexIdx) {
+        const float* P = &data.Vertices[VertexIdx * MESH_VERTEX_FLOATS];
+        glm::vec3 Offset = glm::vec3(P[0], P[1], P[2]) - Center;
+        RadiusSquared = glm::max(RadiusSquared, glm::dot(Offset, Offset));
     }
+    data.BoundsRadius = sqrtf(RadiusSquared);
 
+    data.Indices.resize((size_t)mesh->mNumFaces * 3);
+    unsigned* Indices = data.Indices.data();
     for (unsigned FaceIndex = 0; FaceIndex < mesh->mNumFaces; ++FaceIndex) {
-        const aiFace& Face = mesh->mFaces[FaceIndex];
-        mIndices.push_back(Face.mIndices[0]);
-        mIndices.push_back(Face.mIndices[1]);
-        mIndices.push_back(Face.mIndices[2]);
+        const unsigned* FaceIndices = mesh->mFaces[FaceIndex].mIndices;
+        Indices[0] = FaceIndices[0];
+        Indices[1] = FaceIndices[1];
+        Indices[2] = FaceIndices[2];
+        Indices += 3;
     }
 
-    mVertexCount = mVertices.size() / 6;
-    mIndexCount = mIndices.size();
+    size_t VertexCount = mesh->mNumVertices;
+    size_t FullIndexCount = data.Indices.size();
+    data.CacheStatsBefore = MeshOptimizer::AnalyzeVertexCache(data.Indices.data(), FullIndexCount, VertexCount);
+    MeshOptimizer::OptimizeVertexCache(data.Indices.data(), FullIndexCount, VertexCount);
+    MeshOptimizer::OptimizeOverdraw(data.Indices.data(), FullIndexCount, data.Vertices.data(), VertexCount, MESH_VERTEX_FLOATS);
+    GenerateLODs(data);
+    // NOTE: Full detail comes first in the index buffer, so its vertices end up first in memory
+    MeshOptimizer::OptimizeVertexFetch(data.Vertices.data(), data.Indices.data(), data.Indices.size(), VertexCount, MESH_VERTEX_FLOATS);
+    data.CacheStatsAfter = MeshOptimizer::AnalyzeVertexCache(data.Indices.data(), FullIndexCount, VertexCount);
 
-    mDiffuseTexture = loadMeshTexture(material, resPath, aiTextureType_DIFFUSE);
-    mSpecularTexture = loadMeshTexture(material, resPath, aiTextureType_SPECULAR);
+    data.DiffusePath = getMaterialTexturePath(material, aiTextureType_DIFFUSE);
+    data.SpecularPath = getMaterialTexturePath(material, aiTextureType_SPECULAR);
+}
 
-    glGenVertexArrays(1, &mVAO);
-    glBindVertexArray(mVAO);
-    glGenBuffers(1, &mVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(float), mVertices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    
-    if (mIndexCount) {
-        glGenBuffers(1, &mEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndexCount * sizeof(float), mIndices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void
+Mesh::PackVertices(const aiMesh* mesh, float* vertices, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+    const unsigned VertexCount = mesh->mNumVertices;
+    if (!VertexCount) {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        return;
     }
-    glBindVertexArray(0);
-}
\ No newline at end of file
+
+    const float* Positions = &mesh->mVertices[0].x;
+    const float* Normals = mesh->mNormals ? &mesh->mNormals[0].x : 0;
+    const float* UVs = mesh->HasTextureCoords(0) ? &mesh->mTextureCoords[0][0].x : 0;
+    float* Out = vertices;
+    unsigned VertexIndex = 0;
+    glm::vec3 Min(FLT_MAX);
+    glm::vec3 Max(-FLT_MAX);
+
+#ifdef CG_SSE2
+    if (Normals && UVs) {
+        __m128 MinV = _mm_set1_ps(FLT_MAX);
+        __m128 MaxV = _mm_set1_ps(-FLT_MAX);
+        // NOTE: Each 4-wide load reads one float past the current vertex,
+        // so the last vertex is left to the scalar loop below
+        for (; VertexIndex + 1 < VertexCount; ++VertexIndex) {
+            __m128 P = _mm_loadu_ps(Positions + 3 * VertexIndex);
+            __m128 N = _mm_loadu_ps(Normals + 3 * VertexIndex);
+            __m128 T = _mm_loadu_ps(UVs + 3 * VertexIndex);
+            // NOTE: P2 P2 N0 N0, then P0 P1 P2 N0 and N1 N2 U V
+            __m128 PN = _mm_shuffle_ps(P, N, _MM_SHUFFLE(0, 0, 2, 2));
+            _mm_storeu_ps(Out, _mm_shuffle_ps(P, PN, _MM_SHUFFLE(2, 0, 1, 0)));
+            _mm_storeu_ps(Out + 4, _mm_shuffle_ps(N, T, _MM_SHUFFLE(1, 0, 2, 1)));
+            MinV = _mm_min_ps(MinV, P);
+            MaxV = _mm_max_ps(MaxV, P);
+            Out += MESH_VERTEX_FLOATS;
+        }
+
+        float MinLanes[4];
+        float MaxLanes[4];
+        _mm_storeu_ps(MinLanes, MinV);
+        _mm_storeu_ps(MaxLanes, MaxV);
+        Min = glm::vec3(MinLanes[0], MinLanes[1], MinLanes[2]);
+        Max = glm::vec3(MaxLanes[0], MaxLanes[1], MaxLanes[2]);
+    }
+#endif
+
+    for (; VertexIndex < VertexCount; ++VertexIndex) {
+        const float* P = Positions + 3 * VertexIndex;
+        Out[0] = P[0];
+        Out[1] = P[1];
+        Out[2] = P[2];
+        Out[3] = Normals ? Normals[3 * VertexIndex + 0] : 0.0f;
+        Out[4] = Normals ? Normals[3 * VertexIndex + 1] : 0.0f;
+        Out[5] = Normals ? Normals[3 * VertexIndex + 2] : 0.0f;
+        Out[6] = UVs ? UVs[3 * VertexIndex + 0] : 0.0f;
+        Out[7] = UVs ? UVs[3 * VertexIndex + 1] : 0.0f;
+        Min = glm::min(Min, glm::vec3(P[0], P[1], P[2]));
+        Max = glm::max(Max, glm::vec3(P[0], P[1], P[2]));
+        Out += MESH_VERTEX_FLOATS;
+    }
+
+    boundsMin = Min;
+    boundsMax = Max;
+}
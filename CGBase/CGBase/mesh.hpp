@@ -14,8 +14,88 @@
 #include <assimp/scene.h>
 #include<vector>
 #include <GL/glew.h>
+#include <glm/glm.hpp>
 #include <iostream>
 #include "texture.hpp"
+#include "shader.hpp"
+#include "meshoptimizer.hpp"
+#include "meshsimplifier.hpp"
+#include "meshlet.hpp"
+#include "frustum.hpp"
+#include "renderqueue.hpp"
+
+// NOTE: Position (3), normal (3) and UV (2)
+#define MESH_VERTEX_FLOATS 8
+// NOTE: Full detail plus 50%, 25% and 10% of its triangles
+#define MESH_MAX_LODS 4
+
+class GeometryPool;
+
+/**
+ * @brief GPU vertex layout a mesh is uploaded with. CPU side data is always float
+ *
+ */
+enum VertexFormat {
+    // NOTE: 32 bytes, float3 position, float3 normal, float2 UV
+    VERTEX_FORMAT_FLOAT = 0,
+    // NOTE: 16 bytes, unorm16x3 position against the mesh AABB, octahedral snorm16x2 normal,
+    // unorm16x2 UV against the mesh UV range
+    VERTEX_FORMAT_COMPACT = 1,
+};
+
+struct CompactVertex {
+    unsigned short Position[4];
+    short Normal[2];
+    unsigned short UV[2];
+};
+
+/**
+ * @brief One detail level, a range of the mesh index buffer. All levels share the vertex buffer
+ *
+ */
+struct MeshLOD {
+    unsigned IndexOffset;
+    unsigned IndexCount;
+    // NOTE: Largest surface deviation from full detail, in model units
+    float Error;
+    // NOTE: Filled in by Mesh::BuildMeshlets
+    unsigned MeshletOffset;
+    unsigned MeshletCount;
+};
+
+/**
+ * @brief CPU side mesh data, produced either by Assimp import or by the mesh cache
+ *
+ */
+struct MeshData {
+    std::vector<float> Vertices;
+    // NOTE: Index ranges of all LODs, finest first
+    std::vector<unsigned> Indices;
+    std::vector<MeshLOD> LODs;
+    // NOTE: Relative to the model directory, empty if the material has no such texture
+    std::string DiffusePath;
+    std::string SpecularPath;
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
+    // NOTE: Bounding sphere around the AABB center, through the farthest vertex
+    float BoundsRadius;
+    // NOTE: Vertex cache efficiency before and after import-time reordering, only set on import
+    VertexCacheStats CacheStatsBefore;
+    VertexCacheStats CacheStatsAfter;
+    // NOTE: Filled in by Mesh::DecodeTexture, consumed by the Mesh ctor through gTextureRegistry.
+    // Meshes sharing a texture file may hold only its path, the first of them holds the pixels
+    TextureImage DiffuseImage;
+    TextureImage SpecularImage;
+    // NOTE: Filled in by Mesh::EncodeBuffers, consumed by the Mesh ctor
+    VertexFormat Format;
+    std::vector<unsigned char> GPUVertices;
+    std::vector<unsigned char> GPUIndices;
+    glm::vec4 UVTransform;
+    // NOTE: Filled in by Mesh::BuildMeshlets, cover each LOD's index range in order
+    std::vector<Meshlet> Meshlets;
+
+    MeshData() : BoundsRadius(0.0f), Format(VERTEX_FORMAT_FLOAT) {}
+};
 
 class Mesh {
 public:
@@ -23,20 +103,100 @@ public:
     std::vector<float> mVertices;
 
     /**
-     * @brief Ctor - buffers mesh data
+     * @brief Ctor - buffers mesh data and uploads its decoded textures. Must run on the GL thread
      *
-     * @param mesh - Assimp mesh
-     * @param MeshMaterial - Assimp material
-     * @param resPath - Resource relative path. For loading textures, etc...
+     * @param data - Imported or cached mesh data, with textures already decoded
      * 
      */
-    Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
+    Mesh(MeshData& data);
+
+    /**
+     * @brief Releases the textures and deletes the buffers. Meshes are copied around by value,
+     * so this isn't a dtor. Must run on the GL thread
+     *
+     */
+    void Destroy();
+
+    /**
+     * @brief Packs Assimp mesh and material data into MeshData, generates the LOD chain
+     * and reorders it for vertex cache, overdraw and vertex fetch efficiency. Does not touch GL
+     *
+     * @param mesh - Assimp mesh
+     * @param material - Assimp material
+     * @param data - Output mesh data
+     */
+    static void ProcessMesh(const aiMesh* mesh, const aiMaterial* material, MeshData& data);
+
+    /**
+     * @brief Interleaves position, normal and UV into a pre-sized buffer in a single pass
+     *
+     * @param mesh - Assimp mesh
+     * @param vertices - Output, mNumVertices * MESH_VERTEX_FLOATS floats
+     * @param boundsMin - Output, minimum corner of the mesh AABB
+     * @param boundsMax - Output, maximum corner of the mesh AABB
+     */
+    static void PackVertices(const aiMesh* mesh, float* vertices, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+    /**
+     * @brief Decodes a material texture unless it is already resident. Does not touch GL
+     *
+     * @param filePath - Texture path
+     * @param srgb - true for diffuse colour, false for specular data, see Texture::DecodeImage
+     * @param image - Output image. Its Path stays filePath even if the missing texture was decoded
+     */
+    static void DecodeTexture(const std::string& filePath, bool srgb, TextureImage& image);
+
+    /**
+     * @brief Encodes vertices into the requested GPU format and narrows indices
+     * to 16 bits when the mesh has fewer than 65536 vertices. Does not touch GL
+     *
+     * @param data - Mesh data to encode
+     * @param format - Target vertex format
+     */
+    static void EncodeBuffers(MeshData& data, VertexFormat format);
+
+    /**
+     * @brief Fills in the LOD chain of a mesh whose triangles are already cache optimized.
+     * Every coarser level is simplified from full detail with MeshSimplifier
+     *
+     * @param data - Mesh data, Indices must hold exactly the full detail triangles
+     */
+    static void GenerateLODs(MeshData& data);
+
+    /**
+     * @brief Splits each LOD of the (already reordered) index buffer into meshlets with
+     * bounding spheres and normal cones. Does not touch GL
+     *
+     * @param data - Mesh data to build meshlets for
+     */
+    static void BuildMeshlets(MeshData& data);
+
+    /**
+     * @brief Copies the float vertices and indices into a shared pool, so the mesh can be
+     * drawn by indirect commands. Meshes without indices are not pooled
+     *
+     * @param pool - Pool to add to, before GeometryPool::Create
+     */
+    void AddToPool(GeometryPool& pool);
+
+    /**
+     * @brief Picks the coarsest LOD whose projected error stays under a pixel and queues
+     * its meshlets that survive cone and frustum culling as one packet
+     *
+     * @param queue - Render queue of the current frame
+     * @param shader - Shader to draw with, receives the matrices and vertex decode parameters.
+     * The INSTANCED permutation when pooled
+     * @param transform - Object transform of the current frame
+     * @param view - Camera of the current frame
+     * @param pooled - Draw from the pool given to AddToPool, if any, instead of the mesh's own buffers
+     */
+    void Submit(RenderQueue& queue, Shader& shader, const ObjectTransform& transform, const RenderView& view, bool pooled = false) const;
 
     /**
-     * @brief Renders the current mesh
+     * @brief Returns the mesh space bounding box and sphere
      *
      */
-    void Render() const;
+    const Bounds& GetBounds() const;
 
 private:
     unsigned mVAO;
@@ -46,6 +206,18 @@ private:
     unsigned mIndexCount;
     unsigned mDiffuseTexture;
     unsigned mSpecularTexture;
-    unsigned loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type);
-    void processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
+    VertexFormat mFormat;
+    GLenum mIndexType;
+    // NOTE: Maps unorm16 positions back to the mesh AABB, folded into the model matrix
+    glm::mat4 mDequantize;
+    glm::vec4 mUVTransform;
+    std::vector<MeshLOD> mLODs;
+    std::vector<Meshlet> mMeshlets;
+    Bounds mBounds;
+    // NOTE: Set by AddToPool, the pool always holds float vertices and 32-bit indices
+    GeometryPool* mPool;
+    unsigned mPoolAllocation;
+    unsigned selectLOD(const glm::mat4& model, const RenderView& view) const;
+    static glm::vec3 quantizationExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    static std::string getMaterialTexturePath(const aiMaterial* material, aiTextureType type);
 };
@@ -0,0 +1,232 @@
+#include "meshcache.hpp"
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+#include "assetpack.hpp"
+#include "mappedfile.hpp"
+#include "hash.hpp"
+
+static uint64_t
+alignTo4(uint64_t size) {
+    return (size + 3) & ~(uint64_t)3;
+}
+
+bool
+MeshCache::getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& mtime) {
+    struct stat SourceStat;
+    if (stat(sourcePath.c_str(), &SourceStat) != 0) {
+        return false;
+    }
+
+    size = (uint64_t)SourceStat.st_size;
+    mtime = (int64_t)SourceStat.st_mtime;
+    return true;
+}
+
+bool
+MeshCache::hashSource(const std::string& sourcePath, uint64_t& hash) {
+    MappedFile Source;
+    if (!Source.Open(sourcePath)) {
+        return false;
+    }
+
+    hash = HashBytes(Source.Data(), Source.Size());
+    return true;
+}
+
+bool
+MeshCache::isUnchanged(const std::string& sourcePath, uint64_t size, int64_t mtime, uint64_t hash) {
+    uint64_t SourceSize;
+    int64_t SourceMTime;
+    if (!getSourceStamp(sourcePath, SourceSize, SourceMTime)) {
+        return true;
+    }
+
+    if (SourceSize != size) {
+        return false;
+    }
+    uint64_t SourceHash;
+    return SourceMTime == mtime || (hashSource(sourcePath, SourceHash) && SourceHash == hash);
+}
+
+bool
+MeshCache::Load(const std::string& cachePath, const std::string& sourcePath, std::vector<MeshData>& meshes) {
+    Asset Cache;
+    if (!Cache.Open(cachePath) || Cache.Size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader Header;
+    memcpy(&Header, Cache.Data(), sizeof(Header));
+    if (Header.Magic != MESH_CACHE_MAGIC || Header.Version != MESH_CACHE_VERSION) {
+        std::cout << "[Info] Mesh cache " << cachePath << " has an old format, rebuilding" << std::endl;
+        return false;
+    }
+
+    if (!isUnchanged(sourcePath, Header.SourceSize, Header.SourceMTime, Header.SourceHash)) {
+        std::cout << "[Info] " << sourcePath << " changed since it was cooked, rebuilding" << std::endl;
+        return false;
+    }
+
+    const unsigned char* Cursor = Cache.Data() + sizeof(Header);
+    const unsigned char* End = Cache.Data() + Cache.Size();
+    // NOTE: Every record takes at least its fixed part, larger counts can only come from a corrupt header
+    uint64_t RecordBytes = (uint64_t)Header.DependencyCount * sizeof(MeshCacheDependency) + (uint64_t)Header.MeshCount * sizeof(MeshCacheEntry);
+    if ((uint64_t)(End - Cursor) < RecordBytes) {
+        std::cerr << "[Err] Mesh cache " << cachePath << " has invalid counts" << std::endl;
+        return false;
+    }
+
+    for (unsigned DependencyIdx = 0; DependencyIdx < Header.DependencyCount; ++DependencyIdx) {
+        MeshCacheDependency Dependency;
+        if ((uint64_t)(End - Cursor) < sizeof(Dependency)) {
+            std::cerr << "[Err] Mesh cache " << cachePath << " is truncated" << std::endl;
+            return false;
+        }
+        memcpy(&Dependency, Cursor, sizeof(Dependency));
+        Cursor += sizeof(Dependency);
+        if ((uint64_t)(End - Cursor) < alignTo4(Dependency.PathLength)) {
+            std::cerr << "[Err] Mesh cache " << cachePath << " is truncated" << std::endl;
+            return false;
+        }
+        std::string DependencyPath((const char*)Cursor, Dependency.PathLength);
+        Cursor += alignTo4(Dependency.PathLength);
+        if (!isUnchanged(DependencyPath, Dependency.Size, Dependency.MTime, Dependency.Hash)) {
+            std::cout << "[Info] " << DependencyPath << " changed since " << sourcePath << " was cooked, rebuilding" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<MeshData> Meshes(Header.MeshCount);
+    for (unsigned MeshIdx = 0; MeshIdx < Header.MeshCount; ++MeshIdx) {
+        MeshCacheEntry Entry;
+        if ((uint64_t)(End - Cursor) < sizeof(Entry)) {
+            std::cerr << "[Err] Mesh cache " << cachePath << " is truncated" << std::endl;
+            return false;
+        }
+        memcpy(&Entry, Cursor, sizeof(Entry));
+        Cursor += sizeof(Entry);
+
+        // NOTE: 64-bit sums, 32-bit counts can't overflow them
+        uint64_t VertexBytes = (uint64_t)Entry.VertexCount * MESH_VERTEX_FLOATS * sizeof(float);
+        uint64_t IndexBytes = (uint64_t)Entry.IndexCount * sizeof(unsigned);
+        uint64_t LODBytes = (uint64_t)Entry.LODCount * sizeof(MeshCacheLOD);
+        uint64_t BlockBytes = VertexBytes + IndexBytes + LODBytes + alignTo4(Entry.DiffusePathLength) + alignTo4(Entry.SpecularPathLength);
+        if ((uint64_t)(End - Cursor) < BlockBytes) {
+            std::cerr << "[Err] Mesh cache " << cachePath << " is truncated" << std::endl;
+            return false;
+        }
+
+        MeshData& Data = Meshes[MeshIdx];
+        const float* Vertices = (const float*)Cursor;
+        Data.Vertices.assign(Vertices, Vertices + (size_t)Entry.VertexCount * MESH_VERTEX_FLOATS);
+        Cursor += VertexBytes;
+        const unsigned* Indices = (const unsigned*)Cursor;
+        Data.Indices.assign(Indices, Indices + Entry.IndexCount);
+        Cursor += IndexBytes;
+        for (unsigned LODIdx = 0; LODIdx < Entry.LODCount; ++LODIdx) {
+            MeshCacheLOD CachedLOD;
+            memcpy(&CachedLOD, Cursor, sizeof(CachedLOD));
+            Cursor += sizeof(CachedLOD);
+            if ((size_t)CachedLOD.IndexOffset + CachedLOD.IndexCount > Entry.IndexCount) {
+                std::cerr << "[Err] Mesh cache " << cachePath << " has an invalid LOD range" << std::endl;
+                return false;
+            }
+            MeshLOD LOD = { CachedLOD.IndexOffset, CachedLOD.IndexCount, CachedLOD.Error, 0, 0 };
+            Data.LODs.push_back(LOD);
+        }
+        Data.DiffusePath.assign((const char*)Cursor, Entry.DiffusePathLength);
+        Cursor += alignTo4(Entry.DiffusePathLength);
+        Data.SpecularPath.assign((const char*)Cursor, Entry.SpecularPathLength);
+        Cursor += alignTo4(Entry.SpecularPathLength);
+        Data.BoundsMin = glm::vec3(Entry.BoundsMin[0], Entry.BoundsMin[1], Entry.BoundsMin[2]);
+        Data.BoundsMax = glm::vec3(Entry.BoundsMax[0], Entry.BoundsMax[1], Entry.BoundsMax[2]);
+        Data.BoundsRadius = Entry.BoundsRadius;
+    }
+
+    if (Cursor != End) {
+        std::cerr << "[Err] Mesh cache " << cachePath << " has trailing data" << std::endl;
+        return false;
+    }
+
+    meshes.swap(Meshes);
+    return true;
+}
+
+bool
+MeshCache::Save(const std::string& cachePath, const std::string& sourcePath, const std::vector<std::string>& dependencies,
+                const std::vector<MeshData>& meshes) {
+    MeshCacheHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    Header.Magic = MESH_CACHE_MAGIC;
+    Header.Version = MESH_CACHE_VERSION;
+    Header.MeshCount = meshes.size();
+    if (!getSourceStamp(sourcePath, Header.SourceSize, Header.SourceMTime) || !hashSource(sourcePath, Header.SourceHash)) {
+        std::cerr << "[Err] Failed to stamp mesh cache, source " << sourcePath << " is unreadable" << std::endl;
+        return false;
+    }
+
+    // NOTE: A texture that failed to load is drawn with the missing texture, nothing to stamp
+    std::vector<MeshCacheDependency> Dependencies;
+    std::vector<const std::string*> DependencyPaths;
+    for (unsigned DependencyIdx = 0; DependencyIdx < dependencies.size(); ++DependencyIdx) {
+        MeshCacheDependency Dependency;
+        memset(&Dependency, 0, sizeof(Dependency));
+        const std::string& Path = dependencies[DependencyIdx];
+        if (!getSourceStamp(Path, Dependency.Size, Dependency.MTime) || !hashSource(Path, Dependency.Hash)) {
+            continue;
+        }
+        Dependency.PathLength = Path.size();
+        Dependencies.push_back(Dependency);
+        DependencyPaths.push_back(&Path);
+    }
+    Header.DependencyCount = Dependencies.size();
+
+    std::ofstream Out(cachePath, std::ios::binary | std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to open mesh cache for writing: " << cachePath << std::endl;
+        return false;
+    }
+
+    const char Padding[4] = { 0 };
+    Out.write((const char*)&Header, sizeof(Header));
+    for (unsigned DependencyIdx = 0; DependencyIdx < Dependencies.size(); ++DependencyIdx) {
+        const std::string& Path = *DependencyPaths[DependencyIdx];
+        Out.write((const char*)&Dependencies[DependencyIdx], sizeof(MeshCacheDependency));
+        Out.write(Path.data(), Path.size());
+        Out.write(Padding, alignTo4(Path.size()) - Path.size());
+    }
+    for (unsigned MeshIdx = 0; MeshIdx < meshes.size(); ++MeshIdx) {
+        const MeshData& Data = meshes[MeshIdx];
+        MeshCacheEntry Entry;
+        Entry.VertexCount = Data.Vertices.size() / MESH_VERTEX_FLOATS;
+        Entry.IndexCount = Data.Indices.size();
+        Entry.DiffusePathLength = Data.DiffusePath.size();
+        Entry.SpecularPathLength = Data.SpecularPath.size();
+        Entry.LODCount = Data.LODs.size();
+        Entry.BoundsRadius = Data.BoundsRadius;
+        for (unsigned Axis = 0; Axis < 3; ++Axis) {
+            Entry.BoundsMin[Axis] = Data.BoundsMin[Axis];
+            Entry.BoundsMax[Axis] = Data.BoundsMax[Axis];
+        }
+
+        Out.write((const char*)&Entry, sizeof(Entry));
+        Out.write((const char*)Data.Vertices.data(), Data.Vertices.size() * sizeof(float));
+        Out.write((const char*)Data.Indices.data(), Data.Indices.size() * sizeof(unsigned));
+        for (unsigned LODIdx = 0; LODIdx < Data.LODs.size(); ++LODIdx) {
+            MeshCacheLOD CachedLOD = { Data.LODs[LODIdx].IndexOffset, Data.LODs[LODIdx].IndexCount, Data.LODs[LODIdx].Error };
+            Out.write((const char*)&CachedLOD, sizeof(CachedLOD));
+        }
+        Out.write(Data.DiffusePath.data(), Data.DiffusePath.size());
+        Out.write(Padding, alignTo4(Data.DiffusePath.size()) - Data.DiffusePath.size());
+        Out.write(Data.SpecularPath.data(), Data.SpecularPath.size());
+        Out.write(Padding, alignTo4(Data.SpecularPath.size()) - Data.SpecularPath.size());
+    }
+
+    if (!Out) {
+        std::cerr << "[Err] Failed to write mesh cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
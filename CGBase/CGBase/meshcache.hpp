@@ -0,0 +1,91 @@
+/**
+ * @file meshcache.hpp
+ * @brief Cooked binary mesh format. Lets Model skip Assimp import on warm starts
+ *
+ * Layout: MeshCacheHeader, DependencyCount blocks of MeshCacheDependency | path,
+ * followed by MeshCount blocks of
+ * MeshCacheEntry | vertex block | index block | LOD block | diffuse path | specular path
+ * with every block padded to 4 bytes.
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mesh.hpp"
+
+#define MESH_CACHE_MAGIC 0x434D4743 // NOTE: "CGMC"
+#define MESH_CACHE_VERSION 5
+#define MESH_CACHE_EXTENSION ".cgmesh"
+
+struct MeshCacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t SourceSize;
+    int64_t SourceMTime;
+    uint64_t SourceHash;
+    uint32_t MeshCount;
+    uint32_t DependencyCount;
+};
+
+// NOTE: A file the cooked data was derived from besides the source, e.g. its .mtl
+struct MeshCacheDependency {
+    uint64_t Size;
+    int64_t MTime;
+    uint64_t Hash;
+    uint32_t PathLength;
+    uint32_t Reserved;
+};
+
+struct MeshCacheEntry {
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    uint32_t DiffusePathLength;
+    uint32_t SpecularPathLength;
+    float BoundsMin[3];
+    float BoundsMax[3];
+    float BoundsRadius;
+    uint32_t LODCount;
+};
+
+struct MeshCacheLOD {
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    float Error;
+};
+
+class MeshCache {
+public:
+    /**
+     * @brief Maps the cooked file and unpacks it if it is still valid for the source file
+     * and the dependencies recorded by Save. A file is considered unchanged if size and mtime
+     * match, or if its content hash matches. Files missing on disk (packed builds) are trusted
+     *
+     * @param cachePath Cooked file path
+     * @param sourcePath Original model path
+     * @param meshes Output mesh data
+     *
+     * @returns true - Cache hit, false - Missing, stale or corrupt cache
+     */
+    static bool Load(const std::string& cachePath, const std::string& sourcePath, std::vector<MeshData>& meshes);
+
+    /**
+     * @brief Writes cooked mesh data, stamped with the size, mtime and hash of the source file
+     * and of every dependency
+     *
+     * @param cachePath Cooked file path
+     * @param sourcePath Original model path
+     * @param dependencies Material libraries and textures the meshes reference. Unreadable ones are skipped
+     * @param meshes Mesh data to be written
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool Save(const std::string& cachePath, const std::string& sourcePath, const std::vector<std::string>& dependencies,
+                     const std::vector<MeshData>& meshes);
+
+private:
+    static bool getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& mtime);
+    static bool hashSource(const std::string& sourcePath, uint64_t& hash);
+    static bool isUnchanged(const std::string& sourcePath, uint64_t size, int64_t mtime, uint64_t hash);
+};
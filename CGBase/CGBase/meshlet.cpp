@@ -0,0 +1,126 @@
+#include "meshlet.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// NOTE: Cones wider than this can't reject anything useful, treat them as disabled
+static const float MIN_CONE_DOT = 0.1f;
+
+void
+MeshletBuilder::Build(const float* vertices, size_t vertexStride, const unsigned* indices, size_t indexCount, std::vector<Meshlet>& meshlets) {
+    meshlets.clear();
+    size_t TriangleCount = indexCount / 3;
+    if (!TriangleCount) {
+        return;
+    }
+
+    unsigned MeshletVertices[MAX_VERTICES];
+    unsigned VertexCount = 0;
+    Meshlet Current;
+    Current.IndexOffset = 0;
+    Current.TriangleCount = 0;
+    for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        const unsigned* Triangle = indices + TriangleIdx * 3;
+        unsigned NewVertices = 0;
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            bool Seen = std::find(MeshletVertices, MeshletVertices + VertexCount, Triangle[Corner]) != MeshletVertices + VertexCount;
+            bool Repeated = (Corner > 0 && Triangle[Corner] == Triangle[0]) || (Corner > 1 && Triangle[Corner] == Triangle[1]);
+            NewVertices += !Seen && !Repeated;
+        }
+
+        if (VertexCount + NewVertices > MAX_VERTICES || Current.TriangleCount == MAX_TRIANGLES) {
+            computeBounds(vertices, vertexStride, indices, Current);
+            meshlets.push_back(Current);
+            Current.IndexOffset = TriangleIdx * 3;
+            Current.TriangleCount = 0;
+            VertexCount = 0;
+        }
+
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            if (std::find(MeshletVertices, MeshletVertices + VertexCount, Triangle[Corner]) == MeshletVertices + VertexCount) {
+                MeshletVertices[VertexCount++] = Triangle[Corner];
+            }
+        }
+        ++Current.TriangleCount;
+    }
+
+    computeBounds(vertices, vertexStride, indices, Current);
+    meshlets.push_back(Current);
+}
+
+void
+MeshletBuilder::computeBounds(const float* vertices, size_t vertexStride, const unsigned* indices, Meshlet& meshlet) {
+    const unsigned* Triangles = indices + meshlet.IndexOffset;
+    glm::vec3 Min(FLT_MAX);
+    glm::vec3 Max(-FLT_MAX);
+    glm::vec3 NormalSum(0.0f);
+    std::vector<glm::vec3> Normals(meshlet.TriangleCount);
+    for (unsigned TriangleIdx = 0; TriangleIdx < meshlet.TriangleCount; ++TriangleIdx) {
+        glm::vec3 Corners[3];
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            const float* P = vertices + Triangles[TriangleIdx * 3 + Corner] * vertexStride;
+            Corners[Corner] = glm::vec3(P[0], P[1], P[2]);
+            Min = glm::min(Min, Corners[Corner]);
+            Max = glm::max(Max, Corners[Corner]);
+        }
+
+        glm::vec3 Normal = glm::cross(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+        float Length = glm::length(Normal);
+        Normals[TriangleIdx] = Length > 0.0f ? Normal / Length : glm::vec3(0.0f);
+        NormalSum += Normals[TriangleIdx];
+    }
+
+    meshlet.Center = (Min + Max) * 0.5f;
+    meshlet.Radius = 0.0f;
+    for (unsigned IndexIdx = 0; IndexIdx < meshlet.TriangleCount * 3; ++IndexIdx) {
+        const float* P = vertices + Triangles[IndexIdx] * vertexStride;
+        meshlet.Radius = std::max(meshlet.Radius, glm::length(glm::vec3(P[0], P[1], P[2]) - meshlet.Center));
+    }
+
+    meshlet.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.ConeApex = meshlet.Center;
+    meshlet.ConeCutoff = 2.0f;
+    float AxisLength = glm::length(NormalSum);
+    if (AxisLength <= 0.0f) {
+        return;
+    }
+
+    glm::vec3 Axis = NormalSum / AxisLength;
+    float MinDot = 1.0f;
+    for (unsigned TriangleIdx = 0; TriangleIdx < meshlet.TriangleCount; ++TriangleIdx) {
+        MinDot = std::min(MinDot, glm::dot(Normals[TriangleIdx], Axis));
+    }
+    if (MinDot <= MIN_CONE_DOT) {
+        return;
+    }
+
+    // NOTE: Slide the apex back along the axis until every triangle plane lies in front of it
+    float MaxT = 0.0f;
+    for (unsigned TriangleIdx = 0; TriangleIdx < meshlet.TriangleCount; ++TriangleIdx) {
+        const float* P = vertices + Triangles[TriangleIdx * 3] * vertexStride;
+        glm::vec3 Corner(P[0], P[1], P[2]);
+        float NormalDot = glm::dot(Axis, Normals[TriangleIdx]);
+        if (NormalDot > 0.0f) {
+            MaxT = std::max(MaxT, glm::dot(meshlet.Center - Corner, Normals[TriangleIdx]) / NormalDot);
+        }
+    }
+
+    meshlet.ConeAxis = Axis;
+    meshlet.ConeApex = meshlet.Center - Axis * MaxT;
+    meshlet.ConeCutoff = sqrtf(1.0f - MinDot * MinDot);
+}
+
+bool
+MeshletBuilder::IsCulled(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& viewPosition, bool& backfaceCulled) {
+    backfaceCulled = false;
+    if (meshlet.ConeCutoff <= 1.0f) {
+        glm::vec3 ApexDirection = meshlet.ConeApex - viewPosition;
+        float ApexDistance = glm::length(ApexDirection);
+        if (ApexDistance > 0.0f && glm::dot(ApexDirection / ApexDistance, meshlet.ConeAxis) >= meshlet.ConeCutoff) {
+            backfaceCulled = true;
+            return true;
+        }
+    }
+
+    return !frustum.IntersectsSphere(meshlet.Center, meshlet.Radius);
+}
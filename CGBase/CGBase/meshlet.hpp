@@ -0,0 +1,58 @@
+/**
+ * @file meshlet.hpp
+ * @brief Meshlets - small contiguous clusters of a mesh's index buffer with the
+ * bounds needed to reject them on the CPU before submission
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.hpp"
+
+struct Meshlet {
+    // NOTE: Range in the mesh index buffer
+    unsigned IndexOffset;
+    unsigned TriangleCount;
+    glm::vec3 Center;
+    float Radius;
+    // NOTE: Cluster is backfacing for every viewer with
+    // dot(normalize(ConeApex - viewer), ConeAxis) >= ConeCutoff. ConeCutoff > 1 disables the test
+    glm::vec3 ConeApex;
+    glm::vec3 ConeAxis;
+    float ConeCutoff;
+};
+
+class MeshletBuilder {
+public:
+    static const unsigned MAX_VERTICES = 64;
+    static const unsigned MAX_TRIANGLES = 124;
+
+    /**
+     * @brief Greedily splits the triangle list, in its current order, into meshlets.
+     * Run after vertex cache optimization so neighbouring triangles are already adjacent
+     *
+     * @param vertices Interleaved vertices, position and normal must be the first six floats
+     * @param vertexStride Vertex stride in floats
+     * @param indices Triangle list
+     * @param indexCount Number of indices
+     * @param meshlets Output meshlets, covering the whole index buffer
+     */
+    static void Build(const float* vertices, size_t vertexStride, const unsigned* indices, size_t indexCount, std::vector<Meshlet>& meshlets);
+
+    /**
+     * @brief Tests whether a meshlet can be skipped
+     *
+     * @param meshlet Meshlet
+     * @param frustum Frustum in the meshlet's (model) space
+     * @param viewPosition Viewer position in the meshlet's (model) space
+     * @param backfaceCulled Set to true when rejected by the cone test
+     *
+     * @returns true - Meshlet is invisible
+     */
+    static bool IsCulled(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& viewPosition, bool& backfaceCulled);
+
+private:
+    static void computeBounds(const float* vertices, size_t vertexStride, const unsigned* indices, Meshlet& meshlet);
+};
@@ -0,0 +1,341 @@
+#include "meshoptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <glm/glm.hpp>
+
+// NOTE: Forsyth scoring parameters, tuned for an LRU cache of 32 entries
+static const unsigned FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static const unsigned INVALID_INDEX = 0xFFFFFFFF;
+
+static float
+forsythVertexScore(int cachePosition, unsigned remainingTriangles) {
+    if (!remainingTriangles) {
+        return -1.0f;
+    }
+
+    float Score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // NOTE: Vertices of the last triangle get a fixed score so the next triangle doesn't
+            // simply reuse its edge and strip along
+            Score = FORSYTH_LAST_TRIANGLE_SCORE;
+        } else {
+            float Scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            Score = powf(1.0f - (cachePosition - 3) * Scaler, FORSYTH_DECAY_POWER);
+        }
+    }
+
+    // NOTE: Boost vertices with few remaining triangles so lone triangles don't get left behind
+    Score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+    return Score;
+}
+
+void
+MeshOptimizer::OptimizeVertexCache(unsigned* indices, size_t indexCount, size_t vertexCount) {
+    size_t TriangleCount = indexCount / 3;
+    if (!TriangleCount) {
+        return;
+    }
+
+    std::vector<unsigned> RemainingTriangles(vertexCount, 0);
+    for (size_t IndexIdx = 0; IndexIdx < TriangleCount * 3; ++IndexIdx) {
+        ++RemainingTriangles[indices[IndexIdx]];
+    }
+
+    std::vector<unsigned> AdjacencyOffsets(vertexCount + 1, 0);
+    for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        AdjacencyOffsets[VertexIdx + 1] = AdjacencyOffsets[VertexIdx] + RemainingTriangles[VertexIdx];
+    }
+
+    std::vector<unsigned> Adjacency(TriangleCount * 3);
+    std::vector<unsigned> AdjacencyFill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+    for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            Adjacency[AdjacencyFill[indices[TriangleIdx * 3 + Corner]]++] = TriangleIdx;
+        }
+    }
+
+    std::vector<int> CachePositions(vertexCount, -1);
+    std::vector<float> VertexScores(vertexCount);
+    for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        VertexScores[VertexIdx] = forsythVertexScore(-1, RemainingTriangles[VertexIdx]);
+    }
+
+    std::vector<float> TriangleScores(TriangleCount);
+    std::vector<char> Emitted(TriangleCount, 0);
+    long long BestTriangle = -1;
+    float BestScore = -1.0f;
+    for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        const unsigned* Triangle = indices + TriangleIdx * 3;
+        TriangleScores[TriangleIdx] = VertexScores[Triangle[0]] + VertexScores[Triangle[1]] + VertexScores[Triangle[2]];
+        if (TriangleScores[TriangleIdx] > BestScore) {
+            BestScore = TriangleScores[TriangleIdx];
+            BestTriangle = TriangleIdx;
+        }
+    }
+
+    std::vector<unsigned> Output;
+    Output.reserve(TriangleCount * 3);
+    unsigned Cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned CacheCount = 0;
+    size_t ScanCursor = 0;
+
+    while (BestTriangle >= 0) {
+        const unsigned* Triangle = indices + BestTriangle * 3;
+        Output.insert(Output.end(), Triangle, Triangle + 3);
+        Emitted[BestTriangle] = 1;
+
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Vertex = Triangle[Corner];
+            unsigned* Triangles = &Adjacency[AdjacencyOffsets[Vertex]];
+            unsigned Count = RemainingTriangles[Vertex];
+            for (unsigned AdjacentIdx = 0; AdjacentIdx < Count; ++AdjacentIdx) {
+                if (Triangles[AdjacentIdx] == BestTriangle) {
+                    std::swap(Triangles[AdjacentIdx], Triangles[Count - 1]);
+                    break;
+                }
+            }
+            --RemainingTriangles[Vertex];
+        }
+
+        // NOTE: LRU update, the emitted triangle's vertices move to the front
+        unsigned NewCache[FORSYTH_CACHE_SIZE + 3];
+        unsigned NewCacheCount = 0;
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            if (std::find(NewCache, NewCache + NewCacheCount, Triangle[Corner]) == NewCache + NewCacheCount) {
+                NewCache[NewCacheCount++] = Triangle[Corner];
+            }
+        }
+        for (unsigned CacheIdx = 0; CacheIdx < CacheCount; ++CacheIdx) {
+            unsigned Vertex = Cache[CacheIdx];
+            if (Vertex != Triangle[0] && Vertex != Triangle[1] && Vertex != Triangle[2]) {
+                NewCache[NewCacheCount++] = Vertex;
+            }
+        }
+
+        // NOTE: Rescore everything that moved, including vertices that just fell out of the cache
+        for (unsigned CacheIdx = 0; CacheIdx < NewCacheCount; ++CacheIdx) {
+            unsigned Vertex = NewCache[CacheIdx];
+            CachePositions[Vertex] = CacheIdx < FORSYTH_CACHE_SIZE ? (int)CacheIdx : -1;
+            float Score = forsythVertexScore(CachePositions[Vertex], RemainingTriangles[Vertex]);
+            float Delta = Score - VertexScores[Vertex];
+            VertexScores[Vertex] = Score;
+            const unsigned* Triangles = &Adjacency[AdjacencyOffsets[Vertex]];
+            for (unsigned AdjacentIdx = 0; AdjacentIdx < RemainingTriangles[Vertex]; ++AdjacentIdx) {
+                TriangleScores[Triangles[AdjacentIdx]] += Delta;
+            }
+        }
+
+        CacheCount = std::min(NewCacheCount, FORSYTH_CACHE_SIZE);
+        memcpy(Cache, NewCache, CacheCount * sizeof(unsigned));
+
+        BestTriangle = -1;
+        BestScore = -1.0f;
+        for (unsigned CacheIdx = 0; CacheIdx < CacheCount; ++CacheIdx) {
+            unsigned Vertex = Cache[CacheIdx];
+            const unsigned* Triangles = &Adjacency[AdjacencyOffsets[Vertex]];
+            for (unsigned AdjacentIdx = 0; AdjacentIdx < RemainingTriangles[Vertex]; ++AdjacentIdx) {
+                if (TriangleScores[Triangles[AdjacentIdx]] > BestScore) {
+                    BestScore = TriangleScores[Triangles[AdjacentIdx]];
+                    BestTriangle = Triangles[AdjacentIdx];
+                }
+            }
+        }
+
+        if (BestTriangle < 0) {
+            // NOTE: Nothing left around the cache, continue with the next unvisited triangle
+            while (ScanCursor < TriangleCount && Emitted[ScanCursor]) {
+                ++ScanCursor;
+            }
+            BestTriangle = ScanCursor < TriangleCount ? (long long)ScanCursor : -1;
+        }
+    }
+
+    memcpy(indices, Output.data(), Output.size() * sizeof(unsigned));
+}
+
+/**
+ * @brief FIFO post-transform cache simulation. Bumping the clock by more than the cache
+ * size flushes it without touching the timestamps
+ *
+ */
+struct FIFOCache {
+    std::vector<unsigned> Timestamps;
+    unsigned Time;
+    unsigned Size;
+
+    FIFOCache(size_t vertexCount, unsigned size) : Timestamps(vertexCount, 0), Time(size + 1), Size(size) {}
+
+    unsigned Access(unsigned vertex) {
+        if (Time - Timestamps[vertex] > Size) {
+            Timestamps[vertex] = Time++;
+            return 1;
+        }
+        return 0;
+    }
+
+    unsigned AccessTriangle(const unsigned* triangle) {
+        return Access(triangle[0]) + Access(triangle[1]) + Access(triangle[2]);
+    }
+
+    void Flush() {
+        Time += Size + 1;
+    }
+};
+
+void
+MeshOptimizer::OptimizeOverdraw(unsigned* indices, size_t indexCount, const float* vertices, size_t vertexCount, size_t vertexStride, float threshold) {
+    size_t TriangleCount = indexCount / 3;
+    if (!TriangleCount) {
+        return;
+    }
+
+    // NOTE: Hard boundaries, where the cache-optimized order misses on all three vertices anyway
+    FIFOCache Cache(vertexCount, DEFAULT_CACHE_SIZE);
+    std::vector<size_t> HardClusters;
+    for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx) {
+        if (Cache.AccessTriangle(indices + TriangleIdx * 3) == 3) {
+            HardClusters.push_back(TriangleIdx);
+        }
+    }
+    HardClusters.push_back(TriangleCount);
+
+    // NOTE: Soft boundaries, split a cluster wherever its running ACMR is already within
+    // threshold of the whole cluster's ACMR. Smaller clusters sort better, but cost cache misses
+    std::vector<size_t> Clusters;
+    for (size_t HardIdx = 0; HardIdx + 1 < HardClusters.size(); ++HardIdx) {
+        size_t Start = HardClusters[HardIdx];
+        size_t End = HardClusters[HardIdx + 1];
+
+        Cache.Flush();
+        unsigned ClusterMisses = 0;
+        for (size_t TriangleIdx = Start; TriangleIdx < End; ++TriangleIdx) {
+            ClusterMisses += Cache.AccessTriangle(indices + TriangleIdx * 3);
+        }
+        float ClusterThreshold = threshold * ClusterMisses / (float)(End - Start);
+
+        Cache.Flush();
+        Clusters.push_back(Start);
+        size_t SoftStart = Start;
+        unsigned RunningMisses = 0;
+        for (size_t TriangleIdx = Start; TriangleIdx < End; ++TriangleIdx) {
+            RunningMisses += Cache.AccessTriangle(indices + TriangleIdx * 3);
+            if (TriangleIdx + 1 < End && RunningMisses <= (TriangleIdx + 1 - SoftStart) * ClusterThreshold) {
+                Clusters.push_back(TriangleIdx + 1);
+                SoftStart = TriangleIdx + 1;
+                RunningMisses = 0;
+                Cache.Flush();
+            }
+        }
+    }
+    Clusters.push_back(TriangleCount);
+
+    size_t ClusterCount = Clusters.size() - 1;
+    std::vector<glm::vec3> Centroids(ClusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> Normals(ClusterCount, glm::vec3(0.0f));
+    glm::vec3 MeshCentroid(0.0f);
+    float MeshArea = 0.0f;
+    for (size_t ClusterIdx = 0; ClusterIdx < ClusterCount; ++ClusterIdx) {
+        float ClusterArea = 0.0f;
+        for (size_t TriangleIdx = Clusters[ClusterIdx]; TriangleIdx < Clusters[ClusterIdx + 1]; ++TriangleIdx) {
+            const unsigned* Triangle = indices + TriangleIdx * 3;
+            const float* P0 = vertices + Triangle[0] * vertexStride;
+            const float* P1 = vertices + Triangle[1] * vertexStride;
+            const float* P2 = vertices + Triangle[2] * vertexStride;
+            glm::vec3 A(P0[0], P0[1], P0[2]);
+            glm::vec3 B(P1[0], P1[1], P1[2]);
+            glm::vec3 C(P2[0], P2[1], P2[2]);
+            glm::vec3 Normal = glm::cross(B - A, C - A);
+            float Area = glm::length(Normal);
+            Normals[ClusterIdx] += Normal;
+            Centroids[ClusterIdx] += (A + B + C) * (Area / 3.0f);
+            ClusterArea += Area;
+        }
+
+        MeshCentroid += Centroids[ClusterIdx];
+        MeshArea += ClusterArea;
+        if (ClusterArea > 0.0f) {
+            Centroids[ClusterIdx] = Centroids[ClusterIdx] / ClusterArea;
+        }
+    }
+    if (MeshArea > 0.0f) {
+        MeshCentroid = MeshCentroid / MeshArea;
+    }
+
+    // NOTE: Clusters that face away from the mesh center are likely to be visible, draw them first
+    std::vector<float> SortKeys(ClusterCount);
+    std::vector<unsigned> Order(ClusterCount);
+    for (size_t ClusterIdx = 0; ClusterIdx < ClusterCount; ++ClusterIdx) {
+        float NormalLength = glm::length(Normals[ClusterIdx]);
+        SortKeys[ClusterIdx] = NormalLength > 0.0f ? glm::dot(Centroids[ClusterIdx] - MeshCentroid, Normals[ClusterIdx] / NormalLength) : 0.0f;
+        Order[ClusterIdx] = ClusterIdx;
+    }
+    std::stable_sort(Order.begin(), Order.end(), [&SortKeys](unsigned a, unsigned b) { return SortKeys[a] > SortKeys[b]; });
+
+    std::vector<unsigned> Output;
+    Output.reserve(TriangleCount * 3);
+    for (size_t OrderIdx = 0; OrderIdx < ClusterCount; ++OrderIdx) {
+        unsigned ClusterIdx = Order[OrderIdx];
+        Output.insert(Output.end(), indices + Clusters[ClusterIdx] * 3, indices + Clusters[ClusterIdx + 1] * 3);
+    }
+    memcpy(indices, Output.data(), Output.size() * sizeof(unsigned));
+}
+
+size_t
+MeshOptimizer::OptimizeVertexFetch(float* vertices, unsigned* indices, size_t indexCount, size_t vertexCount, size_t vertexStride) {
+    std::vector<unsigned> Remap(vertexCount, INVALID_INDEX);
+    unsigned NextVertex = 0;
+    for (size_t IndexIdx = 0; IndexIdx < indexCount; ++IndexIdx) {
+        unsigned& Target = Remap[indices[IndexIdx]];
+        if (Target == INVALID_INDEX) {
+            Target = NextVertex++;
+        }
+        indices[IndexIdx] = Target;
+    }
+
+    size_t ReferencedCount = NextVertex;
+    for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        if (Remap[VertexIdx] == INVALID_INDEX) {
+            Remap[VertexIdx] = NextVertex++;
+        }
+    }
+
+    std::vector<float> Reordered(vertexCount * vertexStride);
+    for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        memcpy(&Reordered[Remap[VertexIdx] * vertexStride], vertices + VertexIdx * vertexStride, vertexStride * sizeof(float));
+    }
+    memcpy(vertices, Reordered.data(), Reordered.size() * sizeof(float));
+    return ReferencedCount;
+}
+
+VertexCacheStats
+MeshOptimizer::AnalyzeVertexCache(const unsigned* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize) {
+    VertexCacheStats Stats;
+    size_t TriangleCount = indexCount / 3;
+    if (!TriangleCount) {
+        return Stats;
+    }
+
+    FIFOCache Cache(vertexCount, cacheSize);
+    std::vector<char> Referenced(vertexCount, 0);
+    size_t ReferencedCount = 0;
+    size_t Misses = 0;
+    for (size_t IndexIdx = 0; IndexIdx < TriangleCount * 3; ++IndexIdx) {
+        Misses += Cache.Access(indices[IndexIdx]);
+        if (!Referenced[indices[IndexIdx]]) {
+            Referenced[indices[IndexIdx]] = 1;
+            ++ReferencedCount;
+        }
+    }
+
+    Stats.ACMR = Misses / (float)TriangleCount;
+    Stats.ATVR = Misses / (float)ReferencedCount;
+    return Stats;
+}
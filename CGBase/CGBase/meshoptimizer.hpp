@@ -0,0 +1,76 @@
+/**
+ * @file meshoptimizer.hpp
+ * @brief Import/cook time index and vertex reordering for GPU vertex reuse.
+ * Works on raw interleaved float arrays so offline tools can use it without Mesh or GL
+ *
+ */
+
+#pragma once
+#include <cstddef>
+
+/**
+ * @brief Post-transform cache efficiency of an index buffer, simulated on a FIFO cache
+ * ACMR - Average cache miss ratio, transformed vertices per triangle. 0.5 is the ideal for large grids, 3 the worst
+ * ATVR - Average transform to vertex ratio, transformed vertices per referenced vertex. 1 is ideal
+ *
+ */
+struct VertexCacheStats {
+    float ACMR;
+    float ATVR;
+
+    VertexCacheStats() : ACMR(0.0f), ATVR(0.0f) {}
+};
+
+class MeshOptimizer {
+public:
+    static const unsigned DEFAULT_CACHE_SIZE = 16;
+
+    /**
+     * @brief Reorders triangles for post-transform cache locality (Tom Forsyth's linear-speed algorithm)
+     *
+     * @param indices Triangle list, reordered in place
+     * @param indexCount Number of indices
+     * @param vertexCount Number of vertices the indices reference
+     */
+    static void OptimizeVertexCache(unsigned* indices, size_t indexCount, size_t vertexCount);
+
+    /**
+     * @brief Splits a cache-optimized triangle list into clusters at cache flush points
+     * (Tipsify-style hard and soft boundaries), then sorts the clusters so the outward
+     * facing ones are drawn first and occlude the rest
+     *
+     * @param indices Cache-optimized triangle list, reordered in place
+     * @param indexCount Number of indices
+     * @param vertices Interleaved vertices, position must be the first three floats
+     * @param vertexCount Number of vertices
+     * @param vertexStride Vertex stride in floats
+     * @param threshold How much the ACMR of a cluster may exceed the input's ACMR, 1.05 is a good default
+     */
+    static void OptimizeOverdraw(unsigned* indices, size_t indexCount, const float* vertices, size_t vertexCount, size_t vertexStride, float threshold = 1.05f);
+
+    /**
+     * @brief Reorders vertices in order of first use by the index buffer and remaps the indices.
+     * Unreferenced vertices are moved to the end
+     *
+     * @param vertices Interleaved vertices, reordered in place
+     * @param indices Triangle list, remapped in place
+     * @param indexCount Number of indices
+     * @param vertexCount Number of vertices
+     * @param vertexStride Vertex stride in floats
+     *
+     * @returns Number of referenced vertices
+     */
+    static size_t OptimizeVertexFetch(float* vertices, unsigned* indices, size_t indexCount, size_t vertexCount, size_t vertexStride);
+
+    /**
+     * @brief Simulates a FIFO post-transform cache over the triangle list
+     *
+     * @param indices Triangle list
+     * @param indexCount Number of indices
+     * @param vertexCount Number of vertices
+     * @param cacheSize Simulated cache size in vertices
+     *
+     * @returns ACMR and ATVR of the index buffer
+     */
+    static VertexCacheStats AnalyzeVertexCache(const unsigned* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = DEFAULT_CACHE_SIZE);
+};
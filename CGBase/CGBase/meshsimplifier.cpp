@@ -0,0 +1,277 @@
+#include "meshsimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+// NOTE: Reject collapses that turn a neighbouring triangle by more than ~75 degrees
+static const float MIN_FLIP_COSINE = 0.25f;
+
+/**
+ * @brief Symmetric 4x4 error quadric, sum of squared distances to a set of planes
+ *
+ */
+struct Quadric {
+    double A00, A11, A22, A01, A02, A12;
+    double B0, B1, B2;
+    double C;
+
+    Quadric() : A00(0), A11(0), A22(0), A01(0), A02(0), A12(0), B0(0), B1(0), B2(0), C(0) {}
+
+    void
+    AddPlane(double a, double b, double c, double d) {
+        A00 += a * a; A11 += b * b; A22 += c * c;
+        A01 += a * b; A02 += a * c; A12 += b * c;
+        B0 += a * d; B1 += b * d; B2 += c * d;
+        C += d * d;
+    }
+
+    void
+    Add(const Quadric& other) {
+        A00 += other.A00; A11 += other.A11; A22 += other.A22;
+        A01 += other.A01; A02 += other.A02; A12 += other.A12;
+        B0 += other.B0; B1 += other.B1; B2 += other.B2;
+        C += other.C;
+    }
+
+    double
+    Evaluate(const float* p) const {
+        double X = p[0], Y = p[1], Z = p[2];
+        double Error = A00 * X * X + A11 * Y * Y + A22 * Z * Z
+                     + 2.0 * (A01 * X * Y + A02 * X * Z + A12 * Y * Z)
+                     + 2.0 * (B0 * X + B1 * Y + B2 * Z) + C;
+        return Error > 0.0 ? Error : 0.0;
+    }
+};
+
+struct Collapse {
+    unsigned From;
+    unsigned To;
+    float Error;
+
+    bool operator<(const Collapse& other) const { return Error < other.Error; }
+};
+
+static void
+triangleNormal(const float* a, const float* b, const float* c, float* normal) {
+    float E0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float E1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    normal[0] = E0[1] * E1[2] - E0[2] * E1[1];
+    normal[1] = E0[2] * E1[0] - E0[0] * E1[2];
+    normal[2] = E0[0] * E1[1] - E0[1] * E1[0];
+}
+
+/**
+ * @brief Maps every vertex to the first vertex with a bitwise identical position
+ *
+ */
+static void
+buildPositionRemap(const float* vertices, size_t vertexCount, size_t vertexStride, std::vector<unsigned>& remap) {
+    std::vector<unsigned> Order(vertexCount);
+    for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        Order[VertexIdx] = VertexIdx;
+    }
+    std::sort(Order.begin(), Order.end(), [vertices, vertexStride](unsigned a, unsigned b) {
+        int Compare = memcmp(vertices + a * vertexStride, vertices + b * vertexStride, 3 * sizeof(float));
+        return Compare < 0 || (Compare == 0 && a < b);
+    });
+
+    remap.resize(vertexCount);
+    for (size_t OrderIdx = 0; OrderIdx < vertexCount; ++OrderIdx) {
+        unsigned Vertex = Order[OrderIdx];
+        bool SameAsPrevious = OrderIdx > 0 && !memcmp(vertices + Vertex * vertexStride, vertices + Order[OrderIdx - 1] * vertexStride, 3 * sizeof(float));
+        remap[Vertex] = SameAsPrevious ? remap[Order[OrderIdx - 1]] : Vertex;
+    }
+}
+
+static uint64_t
+edgeKey(unsigned a, unsigned b) {
+    return ((uint64_t)a << 32) | b;
+}
+
+size_t
+MeshSimplifier::Simplify(unsigned* destination, const unsigned* indices, size_t indexCount, const float* vertices, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError, float& resultError) {
+    resultError = 0.0f;
+    memcpy(destination, indices, indexCount * sizeof(unsigned));
+    if (indexCount <= targetIndexCount) {
+        return indexCount;
+    }
+
+    std::vector<unsigned> PositionRemap;
+    buildPositionRemap(vertices, vertexCount, vertexStride, PositionRemap);
+
+    // NOTE: Seam vertices share their position with another vertex, border vertices
+    // have an edge without an opposite half-edge. Both stay where they are
+    std::vector<unsigned char> Locked(vertexCount, 0);
+    for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        if (PositionRemap[VertexIdx] != VertexIdx) {
+            Locked[VertexIdx] = 1;
+            Locked[PositionRemap[VertexIdx]] = 1;
+        }
+    }
+    std::unordered_set<uint64_t> HalfEdges(indexCount * 2);
+    for (size_t IndexIdx = 0; IndexIdx < indexCount; IndexIdx += 3) {
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            HalfEdges.insert(edgeKey(PositionRemap[indices[IndexIdx + Corner]], PositionRemap[indices[IndexIdx + (Corner + 1) % 3]]));
+        }
+    }
+    for (size_t IndexIdx = 0; IndexIdx < indexCount; IndexIdx += 3) {
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned A = indices[IndexIdx + Corner];
+            unsigned B = indices[IndexIdx + (Corner + 1) % 3];
+            if (!HalfEdges.count(edgeKey(PositionRemap[B], PositionRemap[A]))) {
+                Locked[A] = Locked[B] = 1;
+            }
+        }
+    }
+
+    // NOTE: Quadrics live on positions, so seam copies accumulate into one
+    std::vector<Quadric> Quadrics(vertexCount);
+    for (size_t IndexIdx = 0; IndexIdx < indexCount; IndexIdx += 3) {
+        const float* P0 = vertices + indices[IndexIdx] * vertexStride;
+        const float* P1 = vertices + indices[IndexIdx + 1] * vertexStride;
+        const float* P2 = vertices + indices[IndexIdx + 2] * vertexStride;
+        float Normal[3];
+        triangleNormal(P0, P1, P2, Normal);
+        double Length = sqrt((double)Normal[0] * Normal[0] + (double)Normal[1] * Normal[1] + (double)Normal[2] * Normal[2]);
+        if (Length <= 0.0) {
+            continue;
+        }
+
+        double A = Normal[0] / Length, B = Normal[1] / Length, C = Normal[2] / Length;
+        double D = -(A * P0[0] + B * P0[1] + C * P0[2]);
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            Quadrics[PositionRemap[indices[IndexIdx + Corner]]].AddPlane(A, B, C, D);
+        }
+    }
+
+    double MaxError = (double)targetError * targetError;
+    double ResultError = 0.0;
+    size_t ResultCount = indexCount;
+    std::vector<unsigned> Collapsed(vertexCount);
+    std::vector<unsigned char> Touched(vertexCount);
+    std::vector<unsigned> TriangleOffsets(vertexCount + 1);
+    std::vector<unsigned> VertexTriangles;
+    std::vector<Collapse> Collapses;
+    while (ResultCount > targetIndexCount) {
+        // NOTE: Vertex to triangle adjacency of the current result
+        std::fill(TriangleOffsets.begin(), TriangleOffsets.end(), 0);
+        for (size_t IndexIdx = 0; IndexIdx < ResultCount; ++IndexIdx) {
+            TriangleOffsets[destination[IndexIdx] + 1]++;
+        }
+        for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+            TriangleOffsets[VertexIdx + 1] += TriangleOffsets[VertexIdx];
+        }
+        VertexTriangles.resize(ResultCount);
+        std::vector<unsigned> Fill(TriangleOffsets.begin(), TriangleOffsets.end() - 1);
+        for (size_t IndexIdx = 0; IndexIdx < ResultCount; ++IndexIdx) {
+            VertexTriangles[Fill[destination[IndexIdx]]++] = IndexIdx / 3;
+        }
+
+        Collapses.clear();
+        for (size_t IndexIdx = 0; IndexIdx < ResultCount; IndexIdx += 3) {
+            for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                unsigned A = destination[IndexIdx + Corner];
+                unsigned B = destination[IndexIdx + (Corner + 1) % 3];
+                for (unsigned Direction = 0; Direction < 2; ++Direction) {
+                    unsigned From = Direction ? B : A;
+                    unsigned To = Direction ? A : B;
+                    if (Locked[From]) {
+                        continue;
+                    }
+
+                    Quadric Combined = Quadrics[From];
+                    Combined.Add(Quadrics[PositionRemap[To]]);
+                    double Error = Combined.Evaluate(vertices + To * vertexStride);
+                    if (Error <= MaxError) {
+                        Collapse Candidate = { From, To, (float)Error };
+                        Collapses.push_back(Candidate);
+                    }
+                }
+            }
+        }
+        if (Collapses.empty()) {
+            break;
+        }
+        std::sort(Collapses.begin(), Collapses.end());
+
+        // NOTE: Each collapse removes about two triangles. Vertices around a collapse are
+        // frozen for the rest of the pass so the adjacency above stays valid
+        size_t TrianglesToRemove = (ResultCount - targetIndexCount) / 3;
+        size_t TrianglesRemoved = 0;
+        for (size_t VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+            Collapsed[VertexIdx] = VertexIdx;
+        }
+        std::fill(Touched.begin(), Touched.end(), 0);
+        for (size_t CollapseIdx = 0; CollapseIdx < Collapses.size() && TrianglesRemoved < TrianglesToRemove; ++CollapseIdx) {
+            const Collapse& Current = Collapses[CollapseIdx];
+            if (Touched[Current.From] || Touched[Current.To]) {
+                continue;
+            }
+
+            const float* Target = vertices + Current.To * vertexStride;
+            bool Flips = false;
+            unsigned Removed = 0;
+            for (unsigned AdjIdx = TriangleOffsets[Current.From]; AdjIdx < TriangleOffsets[Current.From + 1] && !Flips; ++AdjIdx) {
+                const unsigned* Triangle = destination + VertexTriangles[AdjIdx] * 3;
+                if (Triangle[0] == Current.To || Triangle[1] == Current.To || Triangle[2] == Current.To) {
+                    ++Removed;
+                    continue;
+                }
+
+                const float* Before[3];
+                const float* After[3];
+                for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                    Before[Corner] = vertices + Triangle[Corner] * vertexStride;
+                    After[Corner] = Triangle[Corner] == Current.From ? Target : Before[Corner];
+                }
+                float NormalBefore[3];
+                float NormalAfter[3];
+                triangleNormal(Before[0], Before[1], Before[2], NormalBefore);
+                triangleNormal(After[0], After[1], After[2], NormalAfter);
+                float Dot = NormalBefore[0] * NormalAfter[0] + NormalBefore[1] * NormalAfter[1] + NormalBefore[2] * NormalAfter[2];
+                float LengthBefore = sqrtf(NormalBefore[0] * NormalBefore[0] + NormalBefore[1] * NormalBefore[1] + NormalBefore[2] * NormalBefore[2]);
+                float LengthAfter = sqrtf(NormalAfter[0] * NormalAfter[0] + NormalAfter[1] * NormalAfter[1] + NormalAfter[2] * NormalAfter[2]);
+                Flips = Dot <= MIN_FLIP_COSINE * LengthBefore * LengthAfter;
+            }
+            if (Flips) {
+                continue;
+            }
+
+            Collapsed[Current.From] = Current.To;
+            Quadrics[PositionRemap[Current.To]].Add(Quadrics[Current.From]);
+            ResultError = std::max(ResultError, (double)Current.Error);
+            TrianglesRemoved += Removed;
+            for (unsigned Endpoint = 0; Endpoint < 2; ++Endpoint) {
+                unsigned Vertex = Endpoint ? Current.To : Current.From;
+                for (unsigned AdjIdx = TriangleOffsets[Vertex]; AdjIdx < TriangleOffsets[Vertex + 1]; ++AdjIdx) {
+                    const unsigned* Triangle = destination + VertexTriangles[AdjIdx] * 3;
+                    Touched[Triangle[0]] = Touched[Triangle[1]] = Touched[Triangle[2]] = 1;
+                }
+            }
+        }
+        if (!TrianglesRemoved) {
+            break;
+        }
+
+        size_t WriteCount = 0;
+        for (size_t IndexIdx = 0; IndexIdx < ResultCount; IndexIdx += 3) {
+            unsigned A = Collapsed[destination[IndexIdx]];
+            unsigned B = Collapsed[destination[IndexIdx + 1]];
+            unsigned C = Collapsed[destination[IndexIdx + 2]];
+            unsigned PA = PositionRemap[A], PB = PositionRemap[B], PC = PositionRemap[C];
+            if (PA == PB || PB == PC || PA == PC) {
+                continue;
+            }
+            destination[WriteCount++] = A;
+            destination[WriteCount++] = B;
+            destination[WriteCount++] = C;
+        }
+        ResultCount = WriteCount;
+    }
+
+    resultError = (float)sqrt(ResultError);
+    return ResultCount;
+}
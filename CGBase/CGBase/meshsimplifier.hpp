@@ -0,0 +1,32 @@
+/**
+ * @file meshsimplifier.hpp
+ * @brief Quadric error metric (Garland-Heckbert) triangle list simplification for LOD generation.
+ * Works on raw interleaved float arrays, like MeshOptimizer
+ *
+ */
+
+#pragma once
+#include <cstddef>
+
+class MeshSimplifier {
+public:
+    /**
+     * @brief Reduces a triangle list by collapsing edges in order of increasing quadric error.
+     * Vertices are never moved or added, collapses go onto an existing neighbour, so the
+     * result indexes the same vertex buffer. Vertices on mesh borders and attribute seams
+     * (positions shared by several vertices) are locked so the result doesn't tear
+     *
+     * @param destination Output triangle list, must hold indexCount indices
+     * @param indices Source triangle list
+     * @param indexCount Number of source indices
+     * @param vertices Interleaved vertices, position must be the first three floats
+     * @param vertexCount Number of vertices
+     * @param vertexStride Vertex stride in floats
+     * @param targetIndexCount Stop once the result has at most this many indices
+     * @param targetError Stop before any collapse that would move the surface further than this, in model units
+     * @param resultError Output, largest surface deviation of the result, in model units
+     *
+     * @returns Number of indices written to destination
+     */
+    static size_t Simplify(unsigned* destination, const unsigned* indices, size_t indexCount, const float* vertices, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError, float& resultError);
+};
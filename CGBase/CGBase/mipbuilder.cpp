@@ -0,0 +1,284 @@
+#include "mipbuilder.hpp"
+#include <algorithm>
+#include <cmath>
+#include "simd.hpp"
+
+/**
+ * @brief sRGB <-> 16-bit linear lookup tables, built on first use
+ *
+ */
+struct GammaTables {
+    unsigned short ToLinear[256];
+    unsigned char ToSRGB[65536];
+
+    GammaTables() {
+        for (unsigned Value = 0; Value < 256; ++Value) {
+            double C = Value / 255.0;
+            double Linear = C <= 0.04045 ? C / 12.92 : pow((C + 0.055) / 1.055, 2.4);
+            ToLinear[Value] = (unsigned short)(Linear * 65535.0 + 0.5);
+        }
+        for (unsigned Value = 0; Value < 65536; ++Value) {
+            double Linear = Value / 65535.0;
+            double C = Linear <= 0.0031308 ? Linear * 12.92 : 1.055 * pow(Linear, 1.0 / 2.4) - 0.055;
+            ToSRGB[Value] = (unsigned char)(C * 255.0 + 0.5);
+        }
+    }
+};
+
+static const GammaTables&
+gammaTables() {
+    static const GammaTables Tables;
+    return Tables;
+}
+
+static unsigned short
+toLinear(const GammaTables& tables, unsigned char value, bool srgb) {
+    return srgb ? tables.ToLinear[value] : (unsigned short)(value * 257);
+}
+
+static unsigned char
+fromLinear(const GammaTables& tables, unsigned short value, bool srgb) {
+    return srgb ? tables.ToSRGB[value] : (unsigned char)((value * 255u + 32767u) / 65535u);
+}
+
+static unsigned short
+averageRounded(unsigned a, unsigned b) {
+    return (unsigned short)((a + b + 1) >> 1);
+}
+
+unsigned
+MipBuilder::GetLevelCount(int width, int height) {
+    unsigned Levels = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        ++Levels;
+    }
+    return Levels;
+}
+
+/**
+ * @brief Halves a 16-bit linear image. Lanes is 1 for grey, 4 for everything else (RGB is padded).
+ * avg(avg(top), avg(bottom)) is what _mm_avg_epu16 computes, so both paths agree bit for bit
+ *
+ */
+void
+MipBuilder::downsample(const unsigned short* source, int width, int height, int lanes, unsigned short* output, bool allowSIMD) {
+    int OutWidth = width > 1 ? width / 2 : 1;
+    int OutHeight = height > 1 ? height / 2 : 1;
+    for (int Y = 0; Y < OutHeight; ++Y) {
+        const unsigned short* Row0 = source + (size_t)(2 * Y < height ? 2 * Y : height - 1) * width * lanes;
+        const unsigned short* Row1 = source + (size_t)(2 * Y + 1 < height ? 2 * Y + 1 : height - 1) * width * lanes;
+        unsigned short* Out = output + (size_t)Y * OutWidth * lanes;
+        int X = 0;
+        if (width > 1 && allowSIMD) {
+#if defined(CG_AVX2)
+            if (lanes == 4) {
+                // NOTE: 4 output pixels per iteration. unpack works per 128-bit half, the permute restores order
+                for (; X + 4 <= OutWidth; X += 4) {
+                    __m256i A = _mm256_avg_epu16(_mm256_loadu_si256((const __m256i*)(Row0 + X * 8)), _mm256_loadu_si256((const __m256i*)(Row1 + X * 8)));
+                    __m256i B = _mm256_avg_epu16(_mm256_loadu_si256((const __m256i*)(Row0 + X * 8 + 16)), _mm256_loadu_si256((const __m256i*)(Row1 + X * 8 + 16)));
+                    __m256i Pairs = _mm256_avg_epu16(_mm256_unpacklo_epi64(A, B), _mm256_unpackhi_epi64(A, B));
+                    _mm256_storeu_si256((__m256i*)(Out + X * 4), _mm256_permute4x64_epi64(Pairs, _MM_SHUFFLE(3, 1, 2, 0)));
+                }
+            }
+#endif
+#if defined(CG_SSE2)
+            if (lanes == 4) {
+                for (; X + 2 <= OutWidth; X += 2) {
+                    __m128i A = _mm_avg_epu16(_mm_loadu_si128((const __m128i*)(Row0 + X * 8)), _mm_loadu_si128((const __m128i*)(Row1 + X * 8)));
+                    __m128i B = _mm_avg_epu16(_mm_loadu_si128((const __m128i*)(Row0 + X * 8 + 8)), _mm_loadu_si128((const __m128i*)(Row1 + X * 8 + 8)));
+                    _mm_storeu_si128((__m128i*)(Out + X * 4), _mm_avg_epu16(_mm_unpacklo_epi64(A, B), _mm_unpackhi_epi64(A, B)));
+                }
+            } else {
+                // NOTE: Splits even and odd pixels with 32-bit shifts. Values are biased into signed range
+                // for _mm_packs_epi32 (SSE2 has no unsigned 32 to 16 pack)
+                const __m128i Bias32 = _mm_set1_epi32(32768);
+                const __m128i Bias16 = _mm_set1_epi16((short)0x8000);
+                for (; X + 8 <= OutWidth; X += 8) {
+                    __m128i A = _mm_avg_epu16(_mm_loadu_si128((const __m128i*)(Row0 + X * 2)), _mm_loadu_si128((const __m128i*)(Row1 + X * 2)));
+                    __m128i B = _mm_avg_epu16(_mm_loadu_si128((const __m128i*)(Row0 + X * 2 + 8)), _mm_loadu_si128((const __m128i*)(Row1 + X * 2 + 8)));
+                    __m128i EvenA = _mm_sub_epi32(_mm_srli_epi32(_mm_slli_epi32(A, 16), 16), Bias32);
+                    __m128i EvenB = _mm_sub_epi32(_mm_srli_epi32(_mm_slli_epi32(B, 16), 16), Bias32);
+                    __m128i OddA = _mm_sub_epi32(_mm_srli_epi32(A, 16), Bias32);
+                    __m128i OddB = _mm_sub_epi32(_mm_srli_epi32(B, 16), Bias32);
+                    __m128i Even = _mm_add_epi16(_mm_packs_epi32(EvenA, EvenB), Bias16);
+                    __m128i Odd = _mm_add_epi16(_mm_packs_epi32(OddA, OddB), Bias16);
+                    _mm_storeu_si128((__m128i*)(Out + X), _mm_avg_epu16(Even, Odd));
+                }
+            }
+#endif
+        }
+
+        for (; X < OutWidth; ++X) {
+            int X0 = 2 * X < width ? 2 * X : width - 1;
+            int X1 = 2 * X + 1 < width ? 2 * X + 1 : width - 1;
+            for (int Lane = 0; Lane < lanes; ++Lane) {
+                unsigned short Left = averageRounded(Row0[X0 * lanes + Lane], Row1[X0 * lanes + Lane]);
+                unsigned short Right = averageRounded(Row0[X1 * lanes + Lane], Row1[X1 * lanes + Lane]);
+                Out[X * lanes + Lane] = averageRounded(Left, Right);
+            }
+        }
+    }
+}
+
+void
+MipBuilder::Build(const unsigned char* pixels, int width, int height, int channels, bool srgb, std::vector<unsigned char>& levels,
+                  std::vector<unsigned>& levelSizes, bool allowSIMD) {
+    const GammaTables& Tables = gammaTables();
+    unsigned LevelCount = GetLevelCount(width, height);
+    int Lanes = channels == 1 ? 1 : 4;
+    bool HasAlpha = channels == 2 || channels == 4;
+    int ColorChannels = HasAlpha ? channels - 1 : channels;
+
+    size_t TotalBytes = 0;
+    levelSizes.resize(LevelCount);
+    for (unsigned LevelIdx = 0, LevelWidth = width, LevelHeight = height; LevelIdx < LevelCount; ++LevelIdx) {
+        levelSizes[LevelIdx] = LevelWidth * LevelHeight * channels;
+        TotalBytes += levelSizes[LevelIdx];
+        LevelWidth = LevelWidth > 1 ? LevelWidth / 2 : 1;
+        LevelHeight = LevelHeight > 1 ? LevelHeight / 2 : 1;
+    }
+    levels.resize(TotalBytes);
+
+    // NOTE: One sweep flips level 0 into place and expands it to 16-bit linear
+    std::vector<unsigned short> Linear((size_t)width * height * Lanes);
+    std::vector<unsigned short> NextLinear;
+    size_t RowBytes = (size_t)width * channels;
+    for (int Y = 0; Y < height; ++Y) {
+        const unsigned char* In = pixels + (size_t)(height - 1 - Y) * RowBytes;
+        unsigned char* Out = levels.data() + (size_t)Y * RowBytes;
+        unsigned short* LinearOut = Linear.data() + (size_t)Y * width * Lanes;
+        for (int X = 0; X < width; ++X) {
+            for (int Channel = 0; Channel < channels; ++Channel) {
+                Out[Channel] = In[Channel];
+            }
+            if (channels == 1) {
+                LinearOut[0] = toLinear(Tables, In[0], srgb);
+            } else {
+                LinearOut[0] = toLinear(Tables, In[0], srgb);
+                LinearOut[1] = toLinear(Tables, In[ColorChannels > 1 ? 1 : 0], srgb);
+                LinearOut[2] = toLinear(Tables, In[ColorChannels > 1 ? 2 : 0], srgb);
+                LinearOut[3] = HasAlpha ? (unsigned short)(In[channels - 1] * 257) : 65535;
+            }
+            In += channels;
+            Out += channels;
+            LinearOut += Lanes;
+        }
+    }
+
+    unsigned char* LevelOut = levels.data() + levelSizes[0];
+    for (unsigned LevelIdx = 1; LevelIdx < LevelCount; ++LevelIdx) {
+        int NextWidth = width > 1 ? width / 2 : 1;
+        int NextHeight = height > 1 ? height / 2 : 1;
+        NextLinear.resize((size_t)NextWidth * NextHeight * Lanes);
+        downsample(Linear.data(), width, height, Lanes, NextLinear.data(), allowSIMD);
+
+        const unsigned short* In = NextLinear.data();
+        for (size_t PixelIdx = 0; PixelIdx < (size_t)NextWidth * NextHeight; ++PixelIdx) {
+            for (int Channel = 0; Channel < ColorChannels; ++Channel) {
+                LevelOut[Channel] = fromLinear(Tables, In[Channel], srgb);
+            }
+            if (HasAlpha) {
+                LevelOut[channels - 1] = (unsigned char)((In[Lanes - 1] * 255u + 32767u) / 65535u);
+            }
+            In += Lanes;
+            LevelOut += channels;
+        }
+
+        Linear.swap(NextLinear);
+        width = NextWidth;
+        height = NextHeight;
+    }
+}
+
+/**
+ * @brief Weights of a triangle filter for every target pixel, normalized to 1. Edge taps clamp
+ *
+ */
+void
+MipBuilder::filterTaps(int sourceSize, int targetSize, FilterTaps& taps) {
+    float Scale = (float)sourceSize / targetSize;
+    float Radius = Scale > 1.0f ? Scale : 1.0f;
+    taps.MaxTaps = (int)ceil(Radius * 2.0f) + 1;
+    taps.First.resize(targetSize);
+    taps.Count.resize(targetSize);
+    taps.Weights.assign((size_t)targetSize * taps.MaxTaps, 0.0f);
+    for (int Target = 0; Target < targetSize; ++Target) {
+        float Center = (Target + 0.5f) * Scale - 0.5f;
+        int First = (int)ceil(Center - Radius);
+        int Last = (int)floor(Center + Radius);
+        if (Last - First + 1 > taps.MaxTaps) {
+            Last = First + taps.MaxTaps - 1;
+        }
+        float* Weights = &taps.Weights[(size_t)Target * taps.MaxTaps];
+        float Sum = 0.0f;
+        for (int Tap = First; Tap <= Last; ++Tap) {
+            float Weight = 1.0f - fabs(Tap - Center) / Radius;
+            Weights[Tap - First] = Weight > 0.0f ? Weight : 0.0f;
+            Sum += Weights[Tap - First];
+        }
+        for (int Tap = First; Tap <= Last; ++Tap) {
+            Weights[Tap - First] /= Sum;
+        }
+        taps.First[Target] = First;
+        taps.Count[Target] = Last - First + 1;
+    }
+}
+
+void
+MipBuilder::Resample(const unsigned char* pixels, int width, int height, int channels, bool srgb, int outputWidth, int outputHeight,
+                     std::vector<unsigned char>& output) {
+    const GammaTables& Tables = gammaTables();
+    int AlphaChannel = channels == 2 || channels == 4 ? channels - 1 : -1;
+
+    // NOTE: Alpha and the channels of non-sRGB images are filtered as stored
+    std::vector<float> Linear((size_t)width * height * channels);
+    for (size_t ValueIdx = 0; ValueIdx < Linear.size(); ++ValueIdx) {
+        bool IsRaw = !srgb || (int)(ValueIdx % channels) == AlphaChannel;
+        Linear[ValueIdx] = IsRaw ? pixels[ValueIdx] / 255.0f : Tables.ToLinear[pixels[ValueIdx]] / 65535.0f;
+    }
+
+    FilterTaps Horizontal;
+    FilterTaps Vertical;
+    filterTaps(width, outputWidth, Horizontal);
+    filterTaps(height, outputHeight, Vertical);
+
+    std::vector<float> Rows((size_t)outputWidth * height * channels);
+    for (int Y = 0; Y < height; ++Y) {
+        const float* In = &Linear[(size_t)Y * width * channels];
+        float* Out = &Rows[(size_t)Y * outputWidth * channels];
+        for (int X = 0; X < outputWidth; ++X) {
+            const float* Weights = &Horizontal.Weights[(size_t)X * Horizontal.MaxTaps];
+            for (int Tap = 0; Tap < Horizontal.Count[X]; ++Tap) {
+                int Source = Horizontal.First[X] + Tap;
+                Source = Source < 0 ? 0 : Source >= width ? width - 1 : Source;
+                for (int Channel = 0; Channel < channels; ++Channel) {
+                    Out[X * channels + Channel] += Weights[Tap] * In[Source * channels + Channel];
+                }
+            }
+        }
+    }
+
+    output.resize((size_t)outputWidth * outputHeight * channels);
+    std::vector<float> Row((size_t)outputWidth * channels);
+    for (int Y = 0; Y < outputHeight; ++Y) {
+        std::fill(Row.begin(), Row.end(), 0.0f);
+        const float* Weights = &Vertical.Weights[(size_t)Y * Vertical.MaxTaps];
+        for (int Tap = 0; Tap < Vertical.Count[Y]; ++Tap) {
+            int Source = Vertical.First[Y] + Tap;
+            Source = Source < 0 ? 0 : Source >= height ? height - 1 : Source;
+            const float* In = &Rows[(size_t)Source * outputWidth * channels];
+            for (size_t ValueIdx = 0; ValueIdx < Row.size(); ++ValueIdx) {
+                Row[ValueIdx] += Weights[Tap] * In[ValueIdx];
+            }
+        }
+
+        unsigned char* Out = &output[(size_t)Y * outputWidth * channels];
+        for (size_t ValueIdx = 0; ValueIdx < Row.size(); ++ValueIdx) {
+            float Value = Row[ValueIdx] < 0.0f ? 0.0f : Row[ValueIdx] > 1.0f ? 1.0f : Row[ValueIdx];
+            bool IsRaw = !srgb || (int)(ValueIdx % channels) == AlphaChannel;
+            Out[ValueIdx] = IsRaw ? (unsigned char)(Value * 255.0f + 0.5f) : Tables.ToSRGB[(unsigned)(Value * 65535.0f + 0.5f)];
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file mipbuilder.hpp
+ * @brief CPU mip chain generation. Colour channels of sRGB images are averaged in linear space
+ * (gamma-correct), alpha and data textures (specular, masks) are averaged as is. Runs on decoding workers so nothing is left for glGenerateMipmap
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class MipBuilder {
+public:
+    /**
+     * @brief Returns number of levels down to 1x1
+     *
+     * @param width Base width
+     * @param height Base height
+     *
+     * @returns Level count
+     */
+    static unsigned GetLevelCount(int width, int height);
+
+    /**
+     * @brief Builds the full chain with a 2x2 box filter. Level 0 is a copy of the source,
+     * flipped bottom up in the same pass that converts it to linear space
+     *
+     * @param pixels Top down 8-bit pixels, as decoded by stb_image
+     * @param width Base width
+     * @param height Base height
+     * @param channels Channels per pixel, 1 to 4. With 2 and 4 the last channel is alpha
+     * @param srgb Whether the colour channels are sRGB encoded. false for data that is linear already
+     * @param levels Output, every level back to back
+     * @param levelSizes Output, byte size of each level
+     * @param allowSIMD false forces the scalar kernels, used by the benchmark
+     */
+    static void Build(const unsigned char* pixels, int width, int height, int channels, bool srgb, std::vector<unsigned char>& levels,
+                      std::vector<unsigned>& levelSizes, bool allowSIMD = true);
+
+    /**
+     * @brief Scales an image to arbitrary dimensions with a separable triangle filter in linear
+     * space. The filter widens when shrinking, so it doesn't alias. Rows keep their order
+     *
+     * @param pixels 8-bit pixels
+     * @param width Source width
+     * @param height Source height
+     * @param channels Channels per pixel, 1 to 4. With 2 and 4 the last channel is alpha
+     * @param srgb Whether the colour channels are sRGB encoded, see Build
+     * @param outputWidth Target width
+     * @param outputHeight Target height
+     * @param output Output pixels
+     */
+    static void Resample(const unsigned char* pixels, int width, int height, int channels, bool srgb, int outputWidth, int outputHeight,
+                         std::vector<unsigned char>& output);
+
+private:
+    struct FilterTaps {
+        std::vector<int> First;
+        std::vector<int> Count;
+        std::vector<float> Weights;
+        int MaxTaps;
+    };
+
+    static void filterTaps(int sourceSize, int targetSize, FilterTaps& taps);
+    static void downsample(const unsigned short* source, int width, int height, int lanes, unsigned short* output, bool allowSIMD);
+};
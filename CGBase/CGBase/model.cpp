@@ -1,34 +1,248 @@
 #include "model.hpp"
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <unordered_set>
+#include "assetpack.hpp"
+#include "meshcache.hpp"
+#include "threadpool.hpp"
 
-Model::Model(std::string filename) {
+Model::Model(std::string filename, VertexFormat vertexFormat) {
     mFilename = filename;
+    mVertexFormat = vertexFormat;
     mDirectory = filename.substr(0, filename.find_last_of('/'));
 }
 
+static double
+millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 bool
 Model::Load() {
+    std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+    std::string CachePath = mFilename + MESH_CACHE_EXTENSION;
+    std::vector<MeshData> Meshes;
+    bool CacheHit = MeshCache::Load(CachePath, mFilename, Meshes);
+
     Assimp::Importer Importer;
-    const aiScene *Scene = Importer.ReadFile(mFilename, POSTPROCESS_FLAGS);
+    const aiScene *Scene = 0;
+    if (!CacheHit) {
+        Importer.SetIOHandler(AssetPack::CreateIOSystem());
+        Scene = Importer.ReadFile(mFilename, POSTPROCESS_FLAGS);
+        if (!Scene || Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !Scene->mRootNode) {
+            std::cerr << "[Err] Failed to load model:" << std::endl << Importer.GetErrorString() << std::endl;
+            return false;
+        }
+        Meshes.resize(Scene->mNumMeshes);
+    }
+    double ReadMS = millisecondsSince(StartTime);
+
+    // NOTE: CPU phase. Meshes are independent, so packing and texture decoding fan out per mesh
+    std::chrono::steady_clock::time_point CPUStartTime = std::chrono::steady_clock::now();
+    unsigned ThreadCount = 0;
+    {
+        ThreadPool Workers;
+        ThreadCount = Workers.GetThreadCount();
+        for (unsigned MeshIdx = 0; MeshIdx < Meshes.size(); ++MeshIdx) {
+            Workers.Submit([this, Scene, &Meshes, MeshIdx]() {
+                if (Scene) {
+                    aiMesh* CurrAIMesh = Scene->mMeshes[MeshIdx];
+                    Mesh::ProcessMesh(CurrAIMesh, Scene->mMaterials[CurrAIMesh->mMaterialIndex], Meshes[MeshIdx]);
+                }
+                Mesh::BuildMeshlets(Meshes[MeshIdx]);
+                Mesh::EncodeBuffers(Meshes[MeshIdx], mVertexFormat);
+            });
+        }
+        // NOTE: Texture paths of imported meshes are only known once ProcessMesh ran
+        Workers.Wait();
+        decodeTextures(Meshes, Workers);
+    }
+    double CPUMS = millisecondsSince(CPUStartTime);
+
+    if (!CacheHit) {
+        reportCacheOptimization(Meshes);
+        MeshCache::Save(CachePath, mFilename, getDependencies(Meshes), Meshes);
+    }
+
+    // NOTE: GL phase. Only buffer and texture object creation is left for the context thread
+    std::chrono::steady_clock::time_point GLStartTime = std::chrono::steady_clock::now();
+    mMeshes.reserve(Meshes.size());
+    for (unsigned MeshIdx = 0; MeshIdx < Meshes.size(); ++MeshIdx) {
+        mMeshes.push_back(Mesh(Meshes[MeshIdx]));
+    }
+    double GLMS = millisecondsSince(GLStartTime);
+
+    std::cout << mFilename << " Loaded " << mMeshes.size() << " meshes in " << millisecondsSince(StartTime) << "ms" << std::endl
+              << "    " << (CacheHit ? "mesh cache read: " : "Assimp import: ") << ReadMS << "ms" << std::endl
+              << "    CPU phase (" << ThreadCount << " threads): " << CPUMS << "ms" << std::endl
+              << "    GL phase: " << GLMS << "ms" << std::endl;
+    return true;
+}
+
+void
+Model::decodeTextures(std::vector<MeshData>& meshes, ThreadPool& workers) const {
+    std::unordered_set<std::string> Requested;
+    for (unsigned MeshIdx = 0; MeshIdx < meshes.size(); ++MeshIdx) {
+        MeshData& Data = meshes[MeshIdx];
+        const std::string* TexturePaths[2] = { &Data.DiffusePath, &Data.SpecularPath };
+        TextureImage* Images[2] = { &Data.DiffuseImage, &Data.SpecularImage };
+        for (unsigned TextureIdx = 0; TextureIdx < 2; ++TextureIdx) {
+            if (TexturePaths[TextureIdx]->empty()) {
+                continue;
+            }
+
+            // NOTE: Diffuse maps are colour, specular maps are data
+            bool SRGB = TextureIdx == 0;
+            TextureImage* Image = Images[TextureIdx];
+            std::string FullPath = mDirectory + "/" + *TexturePaths[TextureIdx];
+            Image->Path = FullPath;
+            Image->SRGB = SRGB;
+            if (Requested.insert(FullPath + (SRGB ? "" : "|linear")).second) {
+                workers.Submit([Image, FullPath, SRGB]() {
+                    Mesh::DecodeTexture(FullPath, SRGB, *Image);
+                });
+            }
+        }
+    }
+    workers.Wait();
+}
+
+std::vector<std::string>
+Model::getDependencies(const std::vector<MeshData>& meshes) const {
+    std::vector<std::string> Dependencies;
+    std::unordered_set<std::string> Seen;
+    // NOTE: Assimp doesn't report which material libraries it read, the .obj names them on mtllib lines
+    std::string Extension = mFilename.substr(mFilename.find_last_of('.') + 1);
+    std::transform(Extension.begin(), Extension.end(), Extension.begin(), ::tolower);
+    Asset Source;
+    if (Extension == "obj" && Source.Open(mFilename)) {
+        const char* Cursor = (const char*)Source.Data();
+        const char* End = Cursor + Source.Size();
+        while (Cursor < End) {
+            const char* LineEnd = std::find(Cursor, End, '\n');
+            if (LineEnd - Cursor > 7 && !strncmp(Cursor, "mtllib", 6) && isspace((unsigned char)Cursor[6])) {
+                std::string Library(Cursor + 7, LineEnd);
+                Library.erase(0, Library.find_first_not_of(" \t"));
+                Library.erase(Library.find_last_not_of(" \t\r") + 1);
+                std::string FullPath = mDirectory + "/" + Library;
+                if (!Library.empty() && Seen.insert(FullPath).second) {
+                    Dependencies.push_back(FullPath);
+                }
+            }
+            Cursor = LineEnd == End ? End : LineEnd + 1;
+        }
+    }
+
+    for (unsigned MeshIdx = 0; MeshIdx < meshes.size(); ++MeshIdx) {
+        const std::string* TexturePaths[2] = { &meshes[MeshIdx].DiffusePath, &meshes[MeshIdx].SpecularPath };
+        for (unsigned TextureIdx = 0; TextureIdx < 2; ++TextureIdx) {
+            std::string FullPath = mDirectory + "/" + *TexturePaths[TextureIdx];
+            if (!TexturePaths[TextureIdx]->empty() && Seen.insert(FullPath).second) {
+                Dependencies.push_back(FullPath);
+            }
+        }
+    }
+    return Dependencies;
+}
 
+void
+Model::Destroy() {
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].Destroy();
+    }
+    mMeshes.clear();
+}
+
+bool
+Model::Cook() {
+    std::string CachePath = mFilename + MESH_CACHE_EXTENSION;
+    std::vector<MeshData> Meshes;
+    if (MeshCache::Load(CachePath, mFilename, Meshes)) {
+        return true;
+    }
+
+    Assimp::Importer Importer;
+    Importer.SetIOHandler(AssetPack::CreateIOSystem());
+    const aiScene *Scene = Importer.ReadFile(mFilename, POSTPROCESS_FLAGS);
     if (!Scene || Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !Scene->mRootNode) {
         std::cerr << "[Err] Failed to load model:" << std::endl << Importer.GetErrorString() << std::endl;
         return false;
     }
-    mMeshes.reserve(Scene->mNumMeshes);
-    for(unsigned MeshIdx = 0; MeshIdx < Scene->mNumMeshes; ++MeshIdx) {
-        aiMesh* CurrAIMesh = Scene->mMeshes[MeshIdx];
-        Mesh CurrMesh(CurrAIMesh, Scene->mMaterials[CurrAIMesh->mMaterialIndex], mDirectory);
-        mMeshes.push_back(CurrMesh);
 
+    Meshes.resize(Scene->mNumMeshes);
+    {
+        ThreadPool Workers;
+        for (unsigned MeshIdx = 0; MeshIdx < Meshes.size(); ++MeshIdx) {
+            Workers.Submit([Scene, &Meshes, MeshIdx]() {
+                aiMesh* CurrAIMesh = Scene->mMeshes[MeshIdx];
+                Mesh::ProcessMesh(CurrAIMesh, Scene->mMaterials[CurrAIMesh->mMaterialIndex], Meshes[MeshIdx]);
+            });
+        }
+        Workers.Wait();
     }
-    std::cout << mFilename << " Loaded " << mMeshes.size() << " meshes" << std::endl;
-    return true;
+    return MeshCache::Save(CachePath, mFilename, getDependencies(Meshes), Meshes);
 }
 
 void
-Model::Render() {
+Model::reportCacheOptimization(const std::vector<MeshData>& meshes) const {
+    double TriangleCount = 0.0;
+    double ACMRBefore = 0.0;
+    double ACMRAfter = 0.0;
+    double ATVRBefore = 0.0;
+    double ATVRAfter = 0.0;
+    unsigned LODTriangles[MESH_MAX_LODS] = { 0 };
+    float LODErrors[MESH_MAX_LODS] = { 0.0f };
+    for (unsigned MeshIdx = 0; MeshIdx < meshes.size(); ++MeshIdx) {
+        const MeshData& Data = meshes[MeshIdx];
+        double MeshTriangles = Data.LODs.empty() ? Data.Indices.size() / 3 : Data.LODs[0].IndexCount / 3;
+        TriangleCount += MeshTriangles;
+        ACMRBefore += Data.CacheStatsBefore.ACMR * MeshTriangles;
+        ACMRAfter += Data.CacheStatsAfter.ACMR * MeshTriangles;
+        ATVRBefore += Data.CacheStatsBefore.ATVR * MeshTriangles;
+        ATVRAfter += Data.CacheStatsAfter.ATVR * MeshTriangles;
+        // NOTE: Meshes that stopped simplifying early draw their coarsest level instead
+        for (unsigned LODIdx = 0; LODIdx < MESH_MAX_LODS && !Data.LODs.empty(); ++LODIdx) {
+            const MeshLOD& LOD = Data.LODs[std::min<size_t>(LODIdx, Data.LODs.size() - 1)];
+            LODTriangles[LODIdx] += LOD.IndexCount / 3;
+            LODErrors[LODIdx] = std::max(LODErrors[LODIdx], LOD.Error);
+        }
+    }
+
+    if (TriangleCount > 0.0) {
+        std::cout << mFilename << " vertex cache (FIFO " << MeshOptimizer::DEFAULT_CACHE_SIZE << "): ACMR "
+                  << ACMRBefore / TriangleCount << " -> " << ACMRAfter / TriangleCount << ", ATVR "
+                  << ATVRBefore / TriangleCount << " -> " << ATVRAfter / TriangleCount << std::endl;
+        std::cout << mFilename << " LODs:";
+        for (unsigned LODIdx = 0; LODIdx < MESH_MAX_LODS; ++LODIdx) {
+            std::cout << " " << LODTriangles[LODIdx] << " tris (error " << LODErrors[LODIdx] << ")";
+        }
+        std::cout << std::endl;
+    }
+}
+
+unsigned
+Model::AddBounds(FrustumCuller& culler, const glm::mat4& model) const {
+    unsigned FirstObject = culler.GetCount();
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        culler.Add(mMeshes[MeshIdx].GetBounds(), model);
+    }
+    return FirstObject;
+}
+
+void
+Model::Submit(RenderQueue& queue, Shader& shader, const ObjectTransform& transform, const RenderView& view,
+              const FrustumCuller& culler, unsigned firstObject, bool pooled) {
     for(unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
-        Mesh &Mesh = mMeshes[MeshIdx];
-        mMeshes[MeshIdx].Render();
+        if (culler.IsVisible(firstObject + MeshIdx)) {
+            mMeshes[MeshIdx].Submit(queue, shader, transform, view, pooled);
+        }
+    }
+}
+
+void
+Model::AddToPool(GeometryPool& pool) {
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].AddToPool(pool);
     }
 }
@@ -21,13 +21,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "shader.hpp"
 #include "mesh.hpp"
+#include "frustumculler.hpp"
+#include "threadpool.hpp"
 
 #define POSITION_LOCATION 0
 #define NORMAL_LOCATION 1
 
-#define POSTPROCESS_FLAGS (aiProcess_Triangulate)
+// NOTE: Welding identical vertices gives the simplifier and meshlet builder connected triangles
+#define POSTPROCESS_FLAGS (aiProcess_Triangulate | aiProcess_JoinIdenticalVertices)
 // TOOD(Jovan): IF model loads with bad textures, use this instead:
-// #define POSTPROCESS_FLAGS (aiProcess_Triangulate | aiProcess_FlipUVs)
+// #define POSTPROCESS_FLAGS (aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs)
 #define INVALID_MATERIAL 0xFFFFFFFF
 
 enum EBufferType {
@@ -41,6 +44,33 @@ enum EBufferType {
 class Model {
 private:
     std::vector<Mesh> mMeshes;
+    VertexFormat mVertexFormat;
+
+    /**
+     * @brief Prints triangle-weighted ACMR/ATVR before and after import-time reordering,
+     * and the triangle counts of the generated LODs
+     *
+     * @param meshes - Freshly imported mesh data
+     */
+    void reportCacheOptimization(const std::vector<MeshData>& meshes) const;
+
+    /**
+     * @brief Decodes every distinct texture file of the meshes once, on the worker pool.
+     * Only the first mesh using a file receives its pixels, the others share it by path
+     *
+     * @param meshes - Mesh data with texture paths filled in
+     * @param workers - Pool to decode on, waited for before returning
+     */
+    void decodeTextures(std::vector<MeshData>& meshes, ThreadPool& workers) const;
+
+    /**
+     * @brief Lists the files besides mFilename the imported meshes depend on: the material
+     * libraries of an .obj and every texture, for the mesh cache stamp
+     *
+     * @param meshes - Freshly imported mesh data
+     * @returns File paths, each once
+     */
+    std::vector<std::string> getDependencies(const std::vector<MeshData>& meshes) const;
 
 public:
     std::string mFilename;
@@ -50,22 +80,64 @@ public:
      * @brief Ctor - sets up data for model loading in Assimp
      *
      * @param filename - Model path
+     * @param vertexFormat - GPU vertex layout the meshes are uploaded with
      *
      */
-    Model(std::string filename);
+    Model(std::string filename, VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT);
 
     /**
-     * @brief Loads all the meshes and model data
+     * @brief Loads all the meshes and model data. Uses the cooked mesh cache
+     * next to the source file when it is up to date, otherwise imports with
+     * Assimp and writes a new cache. Vertex packing and texture decoding
+     * run on a thread pool, only buffer and texture creation run on the GL thread
      *
      * @returns true - Success, false - Failure
      */
     bool Load();
 
     /**
-     * @brief Renderable Render implementation
+     * @brief Releases the textures and buffers of every mesh. Must run on the GL thread
+     *
+     */
+    void Destroy();
+
+    /**
+     * @brief Imports the model and writes its mesh cache without touching GL,
+     * so the asset packer can bundle cooked meshes. Nothing to do if the cache is up to date
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Cook();
+
+    /**
+     * @brief Adds the bounds of every mesh to the frame's culler, in mesh order
+     *
+     * @param culler - Culler of the current frame
+     * @param model - Model matrix
+     * @returns Object index of the first mesh
+     */
+    unsigned AddBounds(FrustumCuller& culler, const glm::mat4& model) const;
+
+    /**
+     * @brief Queues the draws of every mesh that survived frustum culling
+     *
+     * @param queue - Render queue of the current frame
+     * @param shader - Shader to draw with
+     * @param transform - Object transform of the current frame
+     * @param view - Camera of the current frame, used for meshlet culling
+     * @param culler - Culler the meshes were added to, already culled
+     * @param firstObject - Index AddBounds returned
+     * @param pooled - Draw the meshes from the pool given to AddToPool
+     */
+    void Submit(RenderQueue& queue, Shader& shader, const ObjectTransform& transform, const RenderView& view,
+                const FrustumCuller& culler, unsigned firstObject, bool pooled = false);
+
+    /**
+     * @brief Adds every mesh to a shared geometry pool, see Mesh::AddToPool
      *
+     * @param pool - Pool to add to, before GeometryPool::Create
      */
-    void Render();
+    void AddToPool(GeometryPool& pool);
 
 };
 
@@ -0,0 +1,151 @@
+#include "programcache.hpp"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "mappedfile.hpp"
+#include "hash.hpp"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+unsigned ProgramCache::sHits = 0;
+unsigned ProgramCache::sMisses = 0;
+double ProgramCache::sSavedMS = 0.0;
+
+bool
+ProgramCache::IsSupported() {
+    static int Supported = -1;
+    if (Supported < 0) {
+        GLint FormatCount = 0;
+        if (GLEW_ARB_get_program_binary) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+        }
+        Supported = FormatCount > 0;
+    }
+    return Supported != 0;
+}
+
+static uint64_t
+hashString(const GLubyte* str, uint64_t seed) {
+    const char* Str = str ? (const char*)str : "";
+    return HashBytes(Str, strlen(Str), seed);
+}
+
+uint64_t
+ProgramCache::MakeKey(const void* vertexSource, size_t vertexLength, const void* fragmentSource, size_t fragmentLength,
+                      const std::string& defines) {
+    uint32_t Version = PROGRAM_CACHE_VERSION;
+    uint64_t Key = HashBytes(&Version, sizeof(Version));
+    // NOTE: Lengths keep the vertex/fragment boundary part of the key
+    Key = HashBytes(&vertexLength, sizeof(vertexLength), Key);
+    Key = HashBytes(vertexSource, vertexLength, Key);
+    Key = HashBytes(&fragmentLength, sizeof(fragmentLength), Key);
+    Key = HashBytes(fragmentSource, fragmentLength, Key);
+    Key = HashBytes(defines.data(), defines.size(), Key);
+    Key = hashString(glGetString(GL_VENDOR), Key);
+    Key = hashString(glGetString(GL_RENDERER), Key);
+    Key = hashString(glGetString(GL_VERSION), Key);
+    return Key;
+}
+
+std::string
+ProgramCache::GetPath(const std::string& vertexPath, const std::string& fragmentPath, unsigned featureMask) {
+    uint64_t Id = HashBytes(vertexPath.data(), vertexPath.size());
+    Id = HashBytes(fragmentPath.data(), fragmentPath.size(), Id);
+    Id = HashBytes(&featureMask, sizeof(featureMask), Id);
+    char Name[17];
+    snprintf(Name, sizeof(Name), "%016llx", (unsigned long long)Id);
+    return std::string(PROGRAM_CACHE_DIRECTORY) + "/" + Name + PROGRAM_CACHE_EXTENSION;
+}
+
+static void
+makeCacheDirectory() {
+#ifdef _WIN32
+    _mkdir(PROGRAM_CACHE_DIRECTORY);
+#else
+    mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+#endif
+}
+
+GLuint
+ProgramCache::Load(const std::string& cachePath, uint64_t key, float& compileMS) {
+    MappedFile Cache;
+    if (!Cache.Open(cachePath) || Cache.Size() < sizeof(ProgramCacheHeader)) {
+        return 0;
+    }
+
+    ProgramCacheHeader Header;
+    memcpy(&Header, Cache.Data(), sizeof(Header));
+    if (Header.Magic != PROGRAM_CACHE_MAGIC || Header.Version != PROGRAM_CACHE_VERSION || Header.Key != key
+        || Header.Length != Cache.Size() - sizeof(Header)) {
+        // NOTE: Built from older sources or another driver, Save would replace it anyway
+        Cache.Close();
+        remove(cachePath.c_str());
+        return 0;
+    }
+
+    GLuint Program = glCreateProgram();
+    glProgramBinary(Program, Header.Format, Cache.Data() + sizeof(Header), Header.Length);
+    compileMS = Header.CompileMS;
+    return Program;
+}
+
+bool
+ProgramCache::Save(const std::string& cachePath, uint64_t key, GLuint program, float compileMS) {
+    GLint Length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &Length);
+    if (Length <= 0) {
+        return false;
+    }
+
+    std::vector<unsigned char> Binary(Length);
+    GLenum Format = 0;
+    glGetProgramBinary(program, Length, &Length, &Format, Binary.data());
+
+    ProgramCacheHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    Header.Magic = PROGRAM_CACHE_MAGIC;
+    Header.Version = PROGRAM_CACHE_VERSION;
+    Header.Key = key;
+    Header.Format = Format;
+    Header.Length = Length;
+    Header.CompileMS = compileMS;
+
+    makeCacheDirectory();
+    std::ofstream Out(cachePath, std::ios::binary | std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to open program cache for writing: " << cachePath << std::endl;
+        return false;
+    }
+    Out.write((const char*)&Header, sizeof(Header));
+    Out.write((const char*)Binary.data(), Length);
+    return (bool)Out;
+}
+
+void
+ProgramCache::RecordHit(float savedMS) {
+    sHits++;
+    sSavedMS += savedMS > 0.0f ? savedMS : 0.0f;
+}
+
+void
+ProgramCache::RecordMiss() {
+    sMisses++;
+}
+
+void
+ProgramCache::PrintStats() {
+    if (!IsSupported()) {
+        std::cout << "[Info] Program binaries unsupported by the driver, shaders compile from source" << std::endl;
+        return;
+    }
+
+    unsigned Total = sHits + sMisses;
+    std::cout << "[Info] Program cache: " << sHits << "/" << Total << " hits (" << (Total ? 100.0 * sHits / Total : 0.0) << "%), saved "
+              << sSavedMS << "ms of shader compilation" << std::endl;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file programcache.hpp
+ * @brief On-disk cache of linked program binaries (glGetProgramBinary), keyed by
+ * the shader sources and the GL vendor, renderer and version strings
+ *
+ * Layout: ProgramCacheHeader, followed by Length bytes of driver binary
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <GL/glew.h>
+
+#define PROGRAM_CACHE_MAGIC 0x42504743 // NOTE: "CGPB"
+#define PROGRAM_CACHE_VERSION 1
+#define PROGRAM_CACHE_EXTENSION ".cgprog"
+// NOTE: Kept out of the shader directories, binaries are per machine and must not end up in the asset pack
+#define PROGRAM_CACHE_DIRECTORY "shadercache"
+
+struct ProgramCacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Key;
+    uint32_t Format;
+    uint32_t Length;
+    // NOTE: What compiling and linking from source took, reported as saved on later hits
+    float CompileMS;
+    uint32_t Reserved;
+};
+
+class ProgramCache {
+public:
+    /**
+     * @brief Returns whether the driver can hand out program binaries
+     *
+     */
+    static bool IsSupported();
+
+    /**
+     * @brief Builds the cache key of a program. The driver strings are part of it,
+     * so a driver update or another GPU never sees a stale binary
+     *
+     * @param vertexSource Vertex shader source
+     * @param vertexLength Vertex shader source length
+     * @param fragmentSource Fragment shader source
+     * @param fragmentLength Fragment shader source length
+     * @param defines Permutation #define lines injected into both stages
+     *
+     * @returns Cache key
+     */
+    static uint64_t MakeKey(const void* vertexSource, size_t vertexLength, const void* fragmentSource, size_t fragmentLength,
+                            const std::string& defines);
+
+    /**
+     * @brief Returns where the binary of a program is cached. The name depends only on the
+     * program's shaders and permutation, so a rebuilt binary replaces the stale one
+     *
+     * @param vertexPath Vertex shader path
+     * @param fragmentPath Fragment shader path
+     * @param featureMask Permutation feature bits
+     *
+     * @returns Cache file path in PROGRAM_CACHE_DIRECTORY
+     */
+    static std::string GetPath(const std::string& vertexPath, const std::string& fragmentPath, unsigned featureMask);
+
+    /**
+     * @brief Creates a program from a cached binary. Missing entries return 0 without an error,
+     * entries with another key are deleted. The driver may still reject the binary, the caller checks
+     * GL_LINK_STATUS when it needs the program and compiles from source if it failed
+     *
+     * @param cachePath Cache file path
+     * @param key Expected cache key
+     * @param compileMS Output, compile time recorded when the binary was saved
+     *
+     * @returns Program, 0 on a miss
+     */
+    static GLuint Load(const std::string& cachePath, uint64_t key, float& compileMS);
+
+    /**
+     * @brief Writes the binary of a linked program, creating PROGRAM_CACHE_DIRECTORY if needed
+     *
+     * @param cachePath Cache file path
+     * @param key Cache key
+     * @param program Linked program, created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+     * @param compileMS Time compiling and linking took
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool Save(const std::string& cachePath, uint64_t key, GLuint program, float compileMS);
+
+    /**
+     * @brief Counts a hit and the compile time it saved
+     *
+     * @param savedMS Recorded compile time minus the binary load time
+     */
+    static void RecordHit(float savedMS);
+
+    /**
+     * @brief Counts a program compiled from source
+     *
+     */
+    static void RecordMiss();
+
+    /**
+     * @brief Prints the hit rate and the time saved since startup
+     *
+     */
+    static void PrintStats();
+
+private:
+    static unsigned sHits;
+    static unsigned sMisses;
+    static double sSavedMS;
+};
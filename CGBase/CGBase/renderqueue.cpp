@@ -0,0 +1,258 @@
+#include "renderqueue.hpp"
+#include <algorithm>
+#include <cstring>
+#include "framestats.hpp"
+#include "geometrypool.hpp"
+#include "glstate.hpp"
+#include "instancebuffer.hpp"
+#include "shader.hpp"
+#include "texturearray.hpp"
+
+DrawPacket::DrawPacket() {
+    Key = 0;
+    Program = 0;
+    VAO = 0;
+    TextureTargets[0] = TextureTargets[1] = 0;
+    Textures[0] = Textures[1] = 0;
+    Params = RENDER_QUEUE_NO_PARAMS;
+    IndexType = 0;
+    First = 0;
+    Count = 0;
+    RangeFirst = 0;
+    RangeCount = 0;
+    Instances = 0;
+    FirstInstance = 0;
+    InstanceCount = 0;
+    Pool = 0;
+    BaseVertex = 0;
+}
+
+void
+RenderQueue::Clear() {
+    mPackets.clear();
+    mParams.clear();
+    mRangeCounts.clear();
+    mRangeOffsets.clear();
+}
+
+unsigned
+RenderQueue::AddParams(const DrawParams& params) {
+    mParams.push_back(params);
+    return mParams.size() - 1;
+}
+
+unsigned
+RenderQueue::AddRange(GLsizei count, size_t offset) {
+    mRangeCounts.push_back(count);
+    mRangeOffsets.push_back((const void*)offset);
+    return mRangeCounts.size() - 1;
+}
+
+void
+RenderQueue::Submit(const DrawPacket& packet) {
+    mPackets.push_back(packet);
+}
+
+uint64_t
+RenderQueue::MakeKey(RenderPass pass, unsigned program, unsigned material, float depth) {
+    // NOTE: Bits of a non-negative float grow with its value, the top 24 below the sign
+    // keep the exponent and 15 mantissa bits. Draws behind the viewer clamp to 0
+    uint32_t DepthBits = 0;
+    if (depth > 0.0f) {
+        memcpy(&DepthBits, &depth, sizeof(DepthBits));
+        DepthBits >>= 7;
+    }
+    if (pass == RENDER_PASS_TRANSPARENT) {
+        DepthBits = 0xFFFFFF - DepthBits;
+    }
+
+    return ((uint64_t)pass << RENDER_KEY_PASS_SHIFT)
+         | ((uint64_t)(program & 0x3FF) << RENDER_KEY_PROGRAM_SHIFT)
+         | ((uint64_t)(material & 0xFFFFF) << RENDER_KEY_MATERIAL_SHIFT)
+         | ((uint64_t)(DepthBits & 0xFFFFFF) << RENDER_KEY_DEPTH_SHIFT);
+}
+
+unsigned
+RenderQueue::MakeMaterial(GLuint diffuse, GLuint specular) {
+    return ((diffuse & 0x3FF) << 10) | (specular & 0x3FF);
+}
+
+void
+RenderQueue::RadixSort(std::vector<uint64_t>& keys, std::vector<unsigned>& values, std::vector<uint64_t>& scratchKeys, std::vector<unsigned>& scratchValues) {
+    size_t Count = keys.size();
+    if (Count < 2) {
+        return;
+    }
+    scratchKeys.resize(Count);
+    scratchValues.resize(Count);
+
+    // NOTE: Histograms of all 8 bytes in one read of the keys
+    unsigned Histograms[8][256];
+    memset(Histograms, 0, sizeof(Histograms));
+    for (size_t KeyIdx = 0; KeyIdx < Count; ++KeyIdx) {
+        uint64_t Key = keys[KeyIdx];
+        for (unsigned ByteIdx = 0; ByteIdx < 8; ++ByteIdx) {
+            Histograms[ByteIdx][(Key >> (ByteIdx * 8)) & 0xFF]++;
+        }
+    }
+
+    for (unsigned ByteIdx = 0; ByteIdx < 8; ++ByteIdx) {
+        unsigned Shift = ByteIdx * 8;
+        unsigned* Histogram = Histograms[ByteIdx];
+        if (Histogram[(keys[0] >> Shift) & 0xFF] == Count) {
+            continue;
+        }
+
+        unsigned Offset = 0;
+        for (unsigned Bucket = 0; Bucket < 256; ++Bucket) {
+            unsigned BucketCount = Histogram[Bucket];
+            Histogram[Bucket] = Offset;
+            Offset += BucketCount;
+        }
+        for (size_t KeyIdx = 0; KeyIdx < Count; ++KeyIdx) {
+            unsigned Destination = Histogram[(keys[KeyIdx] >> Shift) & 0xFF]++;
+            scratchKeys[Destination] = keys[KeyIdx];
+            scratchValues[Destination] = values[KeyIdx];
+        }
+        keys.swap(scratchKeys);
+        values.swap(scratchValues);
+    }
+}
+
+unsigned
+RenderQueue::commandCount(const DrawPacket& packet) {
+    return packet.RangeCount ? packet.RangeCount : 1;
+}
+
+bool
+RenderQueue::sameState(const DrawPacket& a, const DrawPacket& b) {
+    return a.Program == b.Program && a.VAO == b.VAO && a.TextureTargets[0] == b.TextureTargets[0]
+        && a.TextureTargets[1] == b.TextureTargets[1] && a.Textures[0] == b.Textures[0] && a.Textures[1] == b.Textures[1];
+}
+
+void
+RenderQueue::uploadFrameData() {
+    // NOTE: Commands are appended in draw order, so sorted neighbours cover one contiguous range
+    mPools.clear();
+    mInstanceBuffers.clear();
+    mFirstCommands.resize(mOrder.size());
+    for (unsigned OrderIdx = 0; OrderIdx < mOrder.size(); ++OrderIdx) {
+        const DrawPacket& Packet = mPackets[mOrder[OrderIdx]];
+        if (Packet.Instances && std::find(mInstanceBuffers.begin(), mInstanceBuffers.end(), Packet.Instances) == mInstanceBuffers.end()) {
+            mInstanceBuffers.push_back(Packet.Instances);
+        }
+        GeometryPool* Pool = Packet.Pool;
+        if (!Pool) {
+            continue;
+        }
+        if (std::find(mPools.begin(), mPools.end(), Pool) == mPools.end()) {
+            Pool->Clear();
+            mPools.push_back(Pool);
+        }
+
+        unsigned Instance = Pool->AddInstance(mParams[Packet.Params].Transform);
+        mFirstCommands[OrderIdx] = Pool->GetCommandCount();
+        if (!Packet.RangeCount) {
+            Pool->AddCommand(Instance, Packet.Count, Packet.First / sizeof(GLuint), Packet.BaseVertex);
+            continue;
+        }
+        for (unsigned RangeIdx = Packet.RangeFirst; RangeIdx < Packet.RangeFirst + Packet.RangeCount; ++RangeIdx) {
+            Pool->AddCommand(Instance, mRangeCounts[RangeIdx], (size_t)mRangeOffsets[RangeIdx] / sizeof(GLuint), Packet.BaseVertex);
+        }
+    }
+    for (unsigned PoolIdx = 0; PoolIdx < mPools.size(); ++PoolIdx) {
+        mPools[PoolIdx]->Upload();
+    }
+    for (unsigned BufferIdx = 0; BufferIdx < mInstanceBuffers.size(); ++BufferIdx) {
+        mInstanceBuffers[BufferIdx]->Upload();
+    }
+}
+
+void
+RenderQueue::Flush() {
+    unsigned Count = mPackets.size();
+    mKeys.resize(Count);
+    mOrder.resize(Count);
+    for (unsigned PacketIdx = 0; PacketIdx < Count; ++PacketIdx) {
+        mKeys[PacketIdx] = mPackets[PacketIdx].Key;
+        mOrder[PacketIdx] = PacketIdx;
+    }
+    RadixSort(mKeys, mOrder, mScratchKeys, mScratchOrder);
+    uploadFrameData();
+
+    Shader* CurrentProgram = 0;
+    // NOTE: Last uCompactVertices value of the current program, -1 when not known
+    int CompactVertices = -1;
+    bool LayersCleared = false;
+    // NOTE: Indirect commands waiting for a packet with different state
+    const DrawPacket* Pending = 0;
+    unsigned PendingFirst = 0;
+    unsigned PendingCount = 0;
+    for (unsigned OrderIdx = 0; OrderIdx < Count; ++OrderIdx) {
+        const DrawPacket& Packet = mPackets[mOrder[OrderIdx]];
+        if (Pending && Packet.Pool == Pending->Pool && sameState(Packet, *Pending)) {
+            PendingCount += commandCount(Packet);
+            continue;
+        }
+        if (Pending) {
+            Pending->Pool->Draw(PendingFirst, PendingCount);
+            Pending = 0;
+        }
+
+        if (Packet.Program != CurrentProgram) {
+            Packet.Program->Use();
+            CurrentProgram = Packet.Program;
+            CompactVertices = -1;
+        }
+        gGLState.BindVertexArray(Packet.VAO);
+        for (unsigned TextureIdx = 0; TextureIdx < 2; ++TextureIdx) {
+            if (Packet.Textures[TextureIdx]) {
+                unsigned Unit = (Packet.TextureTargets[TextureIdx] == GL_TEXTURE_2D_ARRAY ? 2 : 0) + TextureIdx;
+                gGLState.BindTexture(Unit, Packet.TextureTargets[TextureIdx], Packet.Textures[TextureIdx]);
+            }
+        }
+
+        if (Packet.Pool) {
+            Pending = &Packet;
+            PendingFirst = mFirstCommands[OrderIdx];
+            PendingCount = commandCount(Packet);
+            continue;
+        }
+
+        if (Packet.Params != RENDER_QUEUE_NO_PARAMS) {
+            const DrawParams& Params = mParams[Packet.Params];
+            CurrentProgram->SetTransform(Params.Transform);
+            if (CompactVertices != (int)Params.CompactVertices || Params.CompactVertices) {
+                CurrentProgram->SetVertexDecode(Params.CompactVertices, Params.UVTransform);
+                CompactVertices = Params.CompactVertices;
+            }
+        }
+
+        if (Packet.Instances) {
+            if (Packet.IndexType) {
+                Packet.Instances->DrawElements(Packet.Count, Packet.IndexType, Packet.First, Packet.FirstInstance, Packet.InstanceCount);
+            } else {
+                Packet.Instances->DrawArrays(Packet.Count, Packet.FirstInstance, Packet.InstanceCount);
+            }
+            continue;
+        }
+
+        // NOTE: Non-instanced draws sample the plain 2D textures, the layer attribute is constant
+        if (!LayersCleared) {
+            glVertexAttrib2f(TEXTURE_ARRAY_LAYER_ATTRIBUTE, -1.0f, -1.0f);
+            LayersCleared = true;
+        }
+        if (Packet.RangeCount) {
+            glMultiDrawElements(GL_TRIANGLES, &mRangeCounts[Packet.RangeFirst], Packet.IndexType, &mRangeOffsets[Packet.RangeFirst], Packet.RangeCount);
+        } else if (Packet.IndexType) {
+            glDrawElements(GL_TRIANGLES, Packet.Count, Packet.IndexType, (void*)(size_t)Packet.First);
+        } else {
+            glDrawArrays(GL_TRIANGLES, Packet.First, Packet.Count);
+        }
+        gFrameStats.DrawCalls++;
+    }
+    if (Pending) {
+        Pending->Pool->Draw(PendingFirst, PendingCount);
+    }
+    gFrameStats.DrawPackets += Count;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file renderqueue.hpp
+ * @brief Frame draw queue. Scene code submits draw packets, the queue sorts them by a
+ * 64-bit key and is the only code issuing GL calls while the frame draws
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "transformbatch.hpp"
+
+class Shader;
+class InstanceBuffer;
+class GeometryPool;
+
+// NOTE: Key layout, most significant first: pass (2 bits), program (10), material (20),
+// depth (24), 8 bits unused. Draws sort by pass, then by state, then front to back
+#define RENDER_KEY_PASS_SHIFT 62
+#define RENDER_KEY_PROGRAM_SHIFT 52
+#define RENDER_KEY_MATERIAL_SHIFT 32
+#define RENDER_KEY_DEPTH_SHIFT 8
+
+// NOTE: Packets without per-draw parameters, instanced draws carry theirs per instance
+#define RENDER_QUEUE_NO_PARAMS 0xFFFFFFFF
+
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 0,
+    // NOTE: Sorted back to front instead
+    RENDER_PASS_TRANSPARENT = 1
+};
+
+/**
+ * @brief Per-draw uniform values of a non-instanced packet
+ *
+ */
+struct DrawParams {
+    ObjectTransform Transform;
+    // NOTE: Compact vertex decode (see VertexFormat in mesh.hpp), UVTransform is unused otherwise
+    glm::vec4 UVTransform;
+    bool CompactVertices;
+};
+
+/**
+ * @brief Everything one draw needs. The diffuse and specular texture go to units 0 and 1 for
+ * GL_TEXTURE_2D and to units 2 and 3 for GL_TEXTURE_2D_ARRAY, a 0 texture leaves the unit as it is
+ *
+ */
+struct DrawPacket {
+    uint64_t Key;
+    Shader* Program;
+    GLuint VAO;
+    GLenum TextureTargets[2];
+    GLuint Textures[2];
+    // NOTE: Index returned by RenderQueue::AddParams, or RENDER_QUEUE_NO_PARAMS
+    unsigned Params;
+    // NOTE: 0 draws First/Count vertices, otherwise First is a byte offset into the element buffer
+    GLenum IndexType;
+    unsigned First;
+    unsigned Count;
+    // NOTE: Ranges added with RenderQueue::AddRange, drawn with one glMultiDrawElements instead of First/Count
+    unsigned RangeFirst;
+    unsigned RangeCount;
+    // NOTE: Instanced draws only, null otherwise
+    InstanceBuffer* Instances;
+    unsigned FirstInstance;
+    unsigned InstanceCount;
+    // NOTE: Pooled draws only, null otherwise. First/Count or the ranges index the pool's 32-bit
+    // element buffer and become indirect commands, Params become the commands' per-draw data
+    GeometryPool* Pool;
+    GLint BaseVertex;
+
+    DrawPacket();
+};
+
+class RenderQueue {
+public:
+    /**
+     * @brief Removes all packets of the previous frame, keeps the storage
+     *
+     */
+    void Clear();
+
+    /**
+     * @brief Stores per-draw uniform values
+     *
+     * @param params Values
+     * @returns Index for DrawPacket::Params
+     */
+    unsigned AddParams(const DrawParams& params);
+
+    /**
+     * @brief Stores an index range for a multi-range packet
+     *
+     * @param count Index count
+     * @param offset Byte offset into the element buffer
+     * @returns Index of the range, consecutive calls return consecutive indices
+     */
+    unsigned AddRange(GLsizei count, size_t offset);
+
+    /**
+     * @brief Queues a packet. Its key must be set, see MakeKey. Instanced packets only fill their
+     * InstanceBuffer, Flush uploads it
+     *
+     * @param packet Draw packet
+     */
+    void Submit(const DrawPacket& packet);
+
+    /**
+     * @brief Sorts the packets by key and issues them, skipping state the previous packet already set.
+     * Neighbouring pooled packets with the same program and textures share one multi-draw indirect call
+     *
+     */
+    void Flush();
+
+    /**
+     * @brief Builds a sort key
+     *
+     * @param pass Render pass
+     * @param program ProgramID, the low 10 bits are used
+     * @param material Material ID, the low 20 bits are used
+     * @param depth View depth of the draw, clip w of its center
+     * @returns Sort key
+     */
+    static uint64_t MakeKey(RenderPass pass, unsigned program, unsigned material, float depth);
+
+    /**
+     * @brief Builds the material part of a key from two texture names
+     *
+     */
+    static unsigned MakeMaterial(GLuint diffuse, GLuint specular);
+
+    /**
+     * @brief LSD radix sort of keys with a payload, 8 bits per pass. Passes where every key has the
+     * same byte are skipped, so the unused low byte and a single pass or program cost nothing
+     *
+     * @param keys Keys, sorted in place
+     * @param values Payload moved along with the keys
+     * @param scratchKeys Scratch storage, resized as needed
+     * @param scratchValues Scratch storage, resized as needed
+     */
+    static void RadixSort(std::vector<uint64_t>& keys, std::vector<unsigned>& values, std::vector<uint64_t>& scratchKeys, std::vector<unsigned>& scratchValues);
+
+private:
+    std::vector<DrawPacket> mPackets;
+    std::vector<DrawParams> mParams;
+    std::vector<GLsizei> mRangeCounts;
+    std::vector<const void*> mRangeOffsets;
+    std::vector<uint64_t> mKeys;
+    std::vector<unsigned> mOrder;
+    std::vector<uint64_t> mScratchKeys;
+    std::vector<unsigned> mScratchOrder;
+    // NOTE: First indirect command of each sorted packet, and the pools and instance buffers used this frame
+    std::vector<unsigned> mFirstCommands;
+    std::vector<GeometryPool*> mPools;
+    std::vector<InstanceBuffer*> mInstanceBuffers;
+
+    void uploadFrameData();
+    static unsigned commandCount(const DrawPacket& packet);
+    static bool sameState(const DrawPacket& a, const DrawPacket& b);
+};
@@ -1,103 +1,509 @@
 #include "shader.hpp"
+#include "assetpack.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "framestats.hpp"
+#include "glstate.hpp"
+#include "uniformblocks.hpp"
+#include "programcache.hpp"
 
-Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath) {
-    unsigned vs = loadAndCompileShader(vShaderPath, GL_VERTEX_SHADER);
-    unsigned fs = loadAndCompileShader(fShaderPath, GL_FRAGMENT_SHADER);
-    mId = createBasicProgram(vs, fs);
+static double
+millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Shader::sSerialCompile = false;
+
+#define SHADER_MAX_INCLUDE_DEPTH 8
+
+// NOTE: Source text of one stage. Points into the mapping unless #include lines had to be expanded
+struct ShaderSource {
+    Asset File;
+    std::string Expanded;
+    const char* Data;
+    size_t Size;
+};
+
+/**
+ * @brief Replaces #include "file" lines with the file's contents, paths relative to the including file.
+ * Included text starts with #line 1 <n>, so compile errors name the n-th included file as source string n
+ *
+ * @param path Path of the file being expanded
+ * @param source File contents
+ * @param length File length
+ * @param output Output, expanded text
+ * @param includeCount Included files so far, numbers the source strings
+ * @param depth Include nesting depth
+ *
+ * @returns true - Success, false - Missing include or nesting too deep
+ */
+static bool
+expandIncludes(const std::string& path, const char* source, size_t length, std::string& output, unsigned& includeCount, unsigned depth) {
+    if (depth > SHADER_MAX_INCLUDE_DEPTH) {
+        std::cerr << "[Err] Shader includes nest too deep in " << path << std::endl;
+        return false;
+    }
+
+    size_t Slash = path.find_last_of("/\\");
+    std::string Directory = Slash == std::string::npos ? "" : path.substr(0, Slash + 1);
+    unsigned SourceNumber = includeCount;
+    unsigned LineNumber = 1;
+    const char* End = source + length;
+    for (const char* Line = source; Line < End; ++LineNumber) {
+        const char* LineEnd = std::find(Line, End, '\n');
+        const char* Directive = Line;
+        while (Directive < LineEnd && (*Directive == ' ' || *Directive == '\t')) {
+            ++Directive;
+        }
+
+        const char* IncludeTag = "#include";
+        if ((size_t)(LineEnd - Directive) > 8 && std::equal(IncludeTag, IncludeTag + 8, Directive)) {
+            const char* NameBegin = std::find(Directive + 8, LineEnd, '"');
+            const char* NameEnd = NameBegin < LineEnd ? std::find(NameBegin + 1, LineEnd, '"') : LineEnd;
+            if (NameEnd >= LineEnd) {
+                std::cerr << "[Err] Malformed #include in " << path << ":" << LineNumber << std::endl;
+                return false;
+            }
+
+            std::string IncludePath = Directory + std::string(NameBegin + 1, NameEnd);
+            Asset Include;
+            if (!Include.Open(IncludePath)) {
+                std::cerr << "[Err] Failed to open shader include " << IncludePath << " from " << path << std::endl;
+                return false;
+            }
+            output += "#line 1 " + std::to_string(++includeCount) + "\n";
+            if (!expandIncludes(IncludePath, (const char*)Include.Data(), Include.Size(), output, includeCount, depth + 1)) {
+                return false;
+            }
+            if (output.back() != '\n') {
+                output += '\n';
+            }
+            output += "#line " + std::to_string(LineNumber + 1) + " " + std::to_string(SourceNumber) + "\n";
+        } else {
+            output.append(Line, LineEnd < End ? LineEnd + 1 : End);
+        }
+        Line = LineEnd < End ? LineEnd + 1 : End;
+    }
+    return true;
+}
+
+/**
+ * @brief Opens a shader and expands its includes. Sources without any stay zero-copy
+ *
+ * @param path Shader path
+ * @param source Output, shader source
+ *
+ * @returns true - Success, false - Failure
+ */
+static bool
+loadSource(const std::string& path, ShaderSource& source) {
+    if (!source.File.Open(path)) {
+        std::cerr << "[Err] Failed to open shader: " << path << std::endl;
+        return false;
+    }
+
+    source.Data = (const char*)source.File.Data();
+    source.Size = source.File.Size();
+    const char* IncludeTag = "#include";
+    if (std::search(source.Data, source.Data + source.Size, IncludeTag, IncludeTag + 8) == source.Data + source.Size) {
+        return true;
+    }
+
+    unsigned IncludeCount = 0;
+    if (!expandIncludes(path, source.Data, source.Size, source.Expanded, IncludeCount, 0)) {
+        return false;
+    }
+    source.Data = source.Expanded.data();
+    source.Size = source.Expanded.size();
+    return true;
+}
+
+Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath, const std::vector<std::string>& features, unsigned featureMask) {
+    mId = 0;
+    mVertexShader = 0;
+    mFragmentShader = 0;
+    mPending = false;
+    mFromCache = false;
+    mCacheKey = 0;
+    mVertexPath = vShaderPath;
+    mFragmentPath = fShaderPath;
+    mFeatures = features;
+    mFeatureMask = featureMask;
+    submit(ProgramCache::IsSupported());
+    if (sSerialCompile) {
+        finish();
+    }
+}
+
+void
+Shader::submit(bool useCache) {
+    static bool ParallelCompileEnabled = false;
+    if (!ParallelCompileEnabled && !sSerialCompile && GLEW_KHR_parallel_shader_compile) {
+        // NOTE: Lets the driver pick its own compiler thread count
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        ParallelCompileEnabled = true;
+    }
+
+    mSubmitTime = std::chrono::steady_clock::now();
+    std::string Defines = buildDefines(mFeatureMask);
+    // NOTE: The cache key covers the expanded text, so editing an included file invalidates it too
+    ShaderSource VertexSource;
+    ShaderSource FragmentSource;
+    if (!loadSource(mVertexPath, VertexSource) || !loadSource(mFragmentPath, FragmentSource)) {
+        return;
+    }
+
+    if (useCache) {
+        mCacheKey = ProgramCache::MakeKey(VertexSource.Data, VertexSource.Size, FragmentSource.Data, FragmentSource.Size, Defines);
+        mCachePath = ProgramCache::GetPath(mVertexPath, mFragmentPath, mFeatureMask);
+        mId = ProgramCache::Load(mCachePath, mCacheKey, mCachedCompileMS);
+        if (mId) {
+            mFromCache = true;
+            mPending = true;
+            return;
+        }
+    }
+
+    // NOTE: Nothing here waits on the compiler, status is only read in finish
+    mVertexShader = compileShader(VertexSource.Data, VertexSource.Size, Defines, GL_VERTEX_SHADER);
+    mFragmentShader = compileShader(FragmentSource.Data, FragmentSource.Size, Defines, GL_FRAGMENT_SHADER);
+    mId = createBasicProgram(mVertexShader, mFragmentShader);
+    mPending = true;
+}
+
+void
+Shader::finish() {
+    if (!mPending) {
+        return;
+    }
+    mPending = false;
+
+    int Success = 0;
+    glGetProgramiv(mId, GL_LINK_STATUS, &Success);
+    if (mFromCache) {
+        mFromCache = false;
+        if (!Success) {
+            // NOTE: The driver rejected the binary after all, compile from source instead
+            gGLState.DeleteProgram(mId);
+            mId = 0;
+            submit(false);
+            finish();
+            return;
+        }
+
+        double LoadMS = millisecondsSince(mSubmitTime);
+        ProgramCache::RecordHit(mCachedCompileMS - LoadMS);
+        std::cout << "Loaded " << mVertexPath << " + " << mFragmentPath << " (features 0x" << std::hex << mFeatureMask << std::dec
+                  << ") program binary in " << LoadMS << "ms (compiling took " << mCachedCompileMS << "ms)" << std::endl;
+    } else if (mId) {
+        bool Compiled = checkShader(mVertexPath, mVertexShader, GL_VERTEX_SHADER);
+        Compiled = checkShader(mFragmentPath, mFragmentShader, GL_FRAGMENT_SHADER) && Compiled;
+        if (Compiled && !Success) {
+            char InfoLog[512];
+            glGetProgramInfoLog(mId, 512, NULL, InfoLog);
+            std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
+        }
+
+        glDetachShader(mId, mVertexShader);
+        glDetachShader(mId, mFragmentShader);
+        glDeleteShader(mVertexShader);
+        glDeleteShader(mFragmentShader);
+        mVertexShader = 0;
+        mFragmentShader = 0;
+        if (!Success) {
+            gGLState.DeleteProgram(mId);
+            mId = 0;
+        } else if (mCacheKey) {
+            ProgramCache::RecordMiss();
+            ProgramCache::Save(mCachePath, mCacheKey, mId, (float)millisecondsSince(mSubmitTime));
+        }
+    }
+
+    if (!mId) {
+        return;
+    }
+    UniformBlocks::BindProgram(mId);
+    reflectUniforms();
+    mModelUniform = GetUniform<glm::mat4>("uModel");
+    mViewUniform = GetUniform<glm::mat4>("uView");
+    mProjectionUniform = GetUniform<glm::mat4>("uProjection");
+    mMVPUniform = GetUniform<glm::mat4>("uMVP");
+    mNormalMatrixUniform = GetUniform<glm::mat3>("uNormalMatrix");
+    mCompactVerticesUniform = GetUniform<int>("uCompactVertices");
+    mUVTransformUniform = GetUniform<glm::vec4>("uUVTransform");
+    if (!mSamplers.empty()) {
+        GLuint CurrentProgram = gGLState.GetProgram();
+        gGLState.UseProgram(mId);
+        for (unsigned SamplerIdx = 0; SamplerIdx < mSamplers.size(); ++SamplerIdx) {
+            SetUniform1i(mSamplers[SamplerIdx].first.c_str(), mSamplers[SamplerIdx].second);
+        }
+        gGLState.UseProgram(CurrentProgram);
+    }
 }
 
 unsigned
-Shader::GetId() const {
+Shader::GetId() {
+    finish();
     return mId;
 }
 
 void
-Shader::SetUniform1i(const std::string& uniform, int v) const {
-    glUniform1i(glGetUniformLocation(mId, uniform.c_str()), v);
+Shader::Use() {
+    gGLState.UseProgram(GetId());
+}
+
+bool
+Shader::IsReady() const {
+    if (!mPending || !GLEW_KHR_parallel_shader_compile) {
+        return true;
+    }
+
+    GLint Completed = GL_TRUE;
+    glGetProgramiv(mId, GL_COMPLETION_STATUS_KHR, &Completed);
+    return Completed == GL_TRUE;
 }
 
 void
-Shader::SetUniform1f(const std::string& uniform, float v) const {
-    glUniform1f(glGetUniformLocation(mId, uniform.c_str()), v);
+Shader::WarmUp(const std::vector<unsigned>& featureMasks) {
+    for (unsigned MaskIdx = 0; MaskIdx < featureMasks.size(); ++MaskIdx) {
+        GetVariant(featureMasks[MaskIdx]);
+    }
+}
+
+unsigned
+Shader::GetPendingCount() const {
+    unsigned PendingCount = IsReady() ? 0 : 1;
+    for (std::unordered_map<unsigned, std::unique_ptr<Shader> >::const_iterator VariantIt = mVariants.begin(); VariantIt != mVariants.end(); ++VariantIt) {
+        PendingCount += VariantIt->second->IsReady() ? 0 : 1;
+    }
+    return PendingCount;
+}
+
+unsigned
+Shader::FinishAll() {
+    finish();
+    unsigned ProgramCount = 1;
+    for (std::unordered_map<unsigned, std::unique_ptr<Shader> >::iterator VariantIt = mVariants.begin(); VariantIt != mVariants.end(); ++VariantIt) {
+        VariantIt->second->finish();
+        ProgramCount++;
+    }
+    return ProgramCount;
 }
 
 void
-Shader::SetUniform3f(const std::string& uniform, const glm::vec3& v) const {
-    glUniform3f(glGetUniformLocation(mId, uniform.c_str()), v.x, v.y, v.z);
+Shader::SetSerialCompile(bool serial) {
+    sSerialCompile = serial;
+}
+
+Shader&
+Shader::GetVariant(unsigned featureMask) {
+    if (featureMask == mFeatureMask) {
+        return *this;
+    }
+
+    std::unique_ptr<Shader>& Variant = mVariants[featureMask];
+    if (!Variant) {
+        Variant.reset(new Shader(mVertexPath, mFragmentPath, mFeatures, featureMask));
+        for (unsigned SamplerIdx = 0; SamplerIdx < mSamplers.size(); ++SamplerIdx) {
+            Variant->SetSampler(mSamplers[SamplerIdx].first.c_str(), mSamplers[SamplerIdx].second);
+        }
+    }
+    return *Variant;
+}
+
+unsigned
+Shader::GetFeatureMask() const {
+    return mFeatureMask;
 }
 
 void
-Shader::SetUniform4m(const std::string& uniform, const glm::mat4& m) const {
-    glUniformMatrix4fv(glGetUniformLocation(mId, uniform.c_str()), 1, GL_FALSE, &m[0][0]);
+Shader::SetSampler(const char* uniform, int unit) {
+    mSamplers.push_back(std::make_pair(std::string(uniform), unit));
+    // NOTE: Pending programs pick their samplers up in finish
+    if (!mPending && mId) {
+        GLuint CurrentProgram = gGLState.GetProgram();
+        gGLState.UseProgram(mId);
+        SetUniform1i(uniform, unit);
+        gGLState.UseProgram(CurrentProgram);
+    }
+    for (std::unordered_map<unsigned, std::unique_ptr<Shader> >::iterator VariantIt = mVariants.begin(); VariantIt != mVariants.end(); ++VariantIt) {
+        VariantIt->second->SetSampler(uniform, unit);
+    }
+}
+
+std::string
+Shader::buildDefines(unsigned featureMask) const {
+    std::string Defines;
+    for (unsigned FeatureIdx = 0; FeatureIdx < mFeatures.size(); ++FeatureIdx) {
+        if (featureMask & (1u << FeatureIdx)) {
+            Defines += "#define " + mFeatures[FeatureIdx] + "\n";
+        }
+    }
+    return Defines;
+}
+
+void
+Shader::SetUniform1i(const char* uniform, int v) const {
+    SetUniformValue(GetUniformLocation(uniform), v);
+}
+
+void
+Shader::SetUniform1f(const char* uniform, float v) const {
+    SetUniformValue(GetUniformLocation(uniform), v);
+}
+
+void
+Shader::SetUniform3f(const char* uniform, const glm::vec3& v) const {
+    SetUniformValue(GetUniformLocation(uniform), v);
+}
+
+void
+Shader::SetUniform4f(const char* uniform, const glm::vec4& v) const {
+    SetUniformValue(GetUniformLocation(uniform), v);
+}
+
+void
+Shader::SetUniform4m(const char* uniform, const glm::mat4& m) const {
+    SetUniformValue(GetUniformLocation(uniform), m);
 }
 
 void
 Shader::SetModel(const glm::mat4& m) const {
-    SetUniform4m("uModel", m);
+    mModelUniform.Set(m);
+}
+
+void
+Shader::SetTransform(const ObjectTransform& transform) const {
+    mModelUniform.Set(transform.Model);
+    mMVPUniform.Set(transform.MVP);
+    mNormalMatrixUniform.Set(glm::mat3(transform.Normal));
+}
+
+void
+Shader::SetVertexDecode(bool compactVertices, const glm::vec4& uvTransform) const {
+    mCompactVerticesUniform.Set(compactVertices);
+    if (compactVertices) {
+        mUVTransformUniform.Set(uvTransform);
+    }
 }
 
 void
 Shader::SetView(const glm::mat4& m) const {
-    SetUniform4m("uView", m);
+    mViewUniform.Set(m);
 }
 
 void Shader::SetProjection(const glm::mat4& m) const {
-    SetUniform4m("uProjection", m);
+    mProjectionUniform.Set(m);
+}
+
+GLint
+Shader::GetUniformLocation(const char* uniform) const {
+    std::string Name = uniform;
+    std::unordered_map<std::string, GLint>::const_iterator LocationIt = mUniformLocations.find(Name);
+    if (LocationIt != mUniformLocations.end()) {
+        return LocationIt->second;
+    }
+
+    GLint Location = glGetUniformLocation(mId, uniform);
+    gFrameStats.UniformLocationLookups++;
+    mUniformLocations[Name] = Location;
+    return Location;
+}
+
+void
+Shader::reflectUniforms() {
+    mUniformLocations.clear();
+    if (!mId) {
+        return;
+    }
+
+    GLint UniformCount = 0;
+    GLint MaxNameLength = 0;
+    glGetProgramiv(mId, GL_ACTIVE_UNIFORMS, &UniformCount);
+    glGetProgramiv(mId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &MaxNameLength);
+    std::vector<char> Name(MaxNameLength + 1);
+    for (GLint UniformIdx = 0; UniformIdx < UniformCount; ++UniformIdx) {
+        GLsizei NameLength = 0;
+        GLint ArraySize = 0;
+        GLenum Type;
+        glGetActiveUniform(mId, UniformIdx, (GLsizei)Name.size(), &NameLength, &ArraySize, &Type, Name.data());
+        // NOTE: Uniform block members have no location
+        GLint Location = glGetUniformLocation(mId, Name.data());
+        if (Location < 0) {
+            continue;
+        }
+        std::string BaseName(Name.data(), NameLength);
+        mUniformLocations[BaseName] = Location;
+
+        if (ArraySize > 1 || (NameLength > 3 && BaseName.compare(NameLength - 3, 3, "[0]") == 0)) {
+            BaseName.erase(BaseName.find_last_of('['));
+            mUniformLocations[BaseName] = Location;
+            for (GLint ElementIdx = 1; ElementIdx < ArraySize; ++ElementIdx) {
+                std::string ElementName = BaseName + "[" + std::to_string(ElementIdx) + "]";
+                mUniformLocations[ElementName] = glGetUniformLocation(mId, ElementName.c_str());
+            }
+        }
+    }
 }
 
 unsigned
-Shader::loadAndCompileShader(std::string filename, GLuint shaderType) {
+Shader::compileShader(const char* source, size_t length, const std::string& defines, GLuint shaderType) {
     unsigned ShaderID = 0;
-    std::ifstream In(filename);
-    std::string Str;
-
-    In.seekg(0, std::ios::end);
-    Str.reserve(In.tellg());
-    In.seekg(0, std::ios::beg);
+    // NOTE: Compiled straight from the mapping, the lengths stand in for the missing terminator.
+    // Defines have to follow #version, so the source goes in as the #version line, the defines
+    // with a #line that keeps error line numbers matching the file, and the rest
+    const char* Source = source;
+    size_t SourceLength = length;
+    size_t HeaderLength = 0;
+    const char* VersionTag = "#version";
+    const char* Version = std::search(Source, Source + SourceLength, VersionTag, VersionTag + 8);
+    if (Version != Source + SourceLength) {
+        const char* VersionEnd = (const char*)memchr(Version, '\n', SourceLength - (Version - Source));
+        HeaderLength = VersionEnd ? VersionEnd + 1 - Source : SourceLength;
+    }
+    unsigned HeaderLines = 1;
+    for (size_t CharIdx = 0; CharIdx < HeaderLength; ++CharIdx) {
+        HeaderLines += Source[CharIdx] == '\n';
+    }
+    std::string Injected = defines.empty() ? "" : defines + "#line " + std::to_string(HeaderLines) + "\n";
 
-    Str.assign((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
-    const char* CharContent = Str.c_str();
+    const char* Parts[] = { Source, Injected.c_str(), Source + HeaderLength };
+    GLint Lengths[] = { (GLint)HeaderLength, (GLint)Injected.size(), (GLint)(SourceLength - HeaderLength) };
 
     ShaderID = glCreateShader(shaderType);
-    glShaderSource(ShaderID, 1, &CharContent, NULL);
+    glShaderSource(ShaderID, 3, Parts, Lengths);
     glCompileShader(ShaderID);
 
+    return ShaderID;
+}
+
+bool
+Shader::checkShader(const std::string& filename, unsigned shader, GLuint shaderType) {
     int Success;
     char InfoLog[512];
-    glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &Success);
     if (!Success) {
-        glGetShaderInfoLog(ShaderID, 256, NULL, InfoLog);
+        glGetShaderInfoLog(shader, 256, NULL, InfoLog);
         std::string ShaderTypeName = shaderType == GL_VERTEX_SHADER ? "vertex" : "fragment";
         std::cout << "Error while compiling shader [" << ShaderTypeName << "]:" << std::endl << InfoLog << std::endl;
-        return 0;
+        return false;
     }
 
     std::cout << "Loaded " << filename << " shader" << std::endl;
-
-    return ShaderID;
+    return true;
 }
 
 unsigned
 Shader::createBasicProgram(unsigned vShader, unsigned fShader) {
     unsigned ProgramID = 0;
     ProgramID = glCreateProgram();
+    if (ProgramCache::IsSupported()) {
+        glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glAttachShader(ProgramID, vShader);
     glAttachShader(ProgramID, fShader);
     glLinkProgram(ProgramID);
 
-    int Success;
-    char InfoLog[512];
-    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
-    if (!Success) {
-        glGetProgramInfoLog(ProgramID, 512, NULL, InfoLog);
-        std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
-        return 0;
-    }
-
-    glDetachShader(ProgramID, vShader);
-    glDetachShader(ProgramID, fShader);
-    glDeleteShader(vShader);
-    glDeleteShader(fShader);
-
     return ProgramID;
-}
\ No newline at end of file
+}
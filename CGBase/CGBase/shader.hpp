@@ -13,8 +13,49 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <chrono>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include "transformbatch.hpp"
+
+inline void SetUniformValue(GLint location, int v) { glUniform1i(location, v); }
+inline void SetUniformValue(GLint location, float v) { glUniform1f(location, v); }
+inline void SetUniformValue(GLint location, const glm::vec3& v) { glUniform3f(location, v.x, v.y, v.z); }
+inline void SetUniformValue(GLint location, const glm::vec4& v) { glUniform4f(location, v.x, v.y, v.z, v.w); }
+inline void SetUniformValue(GLint location, const glm::mat3& m) { glUniformMatrix3fv(location, 1, GL_FALSE, &m[0][0]); }
+inline void SetUniformValue(GLint location, const glm::mat4& m) { glUniformMatrix4fv(location, 1, GL_FALSE, &m[0][0]); }
+
+/**
+ * @brief Uniform location resolved once through Shader::GetUniform.
+ * Set writes to the currently bound program without a name lookup
+ *
+ */
+template <typename T>
+class UniformHandle {
+public:
+    UniformHandle() : mLocation(-1) {}
+    explicit UniformHandle(GLint location) : mLocation(location) {}
+
+    /**
+     * @brief Returns whether the uniform is active in the program
+     *
+     */
+    bool IsValid() const { return mLocation >= 0; }
+
+    /**
+     * @brief Sets the uniform value. No-op for inactive uniforms, same as GL
+     *
+     * @param v Value
+     */
+    void Set(const T& v) const { SetUniformValue(mLocation, v); }
+
+private:
+    GLint mLocation;
+};
 
 class Shader {
 public:
@@ -22,8 +63,93 @@ public:
     static const unsigned COLOR_LOCATION = 1;
     unsigned mId;
 
-    Shader(const std::string& vShaderPath, const std::string& fShaderPath);
-    unsigned GetId() const;
+    /**
+     * @brief Ctor - submits the program: from a cached binary when one matches the
+     * sources and the driver, otherwise compile and link are started without waiting on them.
+     * The result is checked when the program is first needed, see GetId
+     *
+     * @param vShaderPath Vertex shader path
+     * @param fShaderPath Fragment shader path
+     * @param features Permutation features, bit i of a feature mask injects
+     * "#define features[i]" into both stages, e.g. "TEXTURED" or "POINT_LIGHT_COUNT 3"
+     * @param featureMask Features this program is built with
+     */
+    Shader(const std::string& vShaderPath, const std::string& fShaderPath,
+           const std::vector<std::string>& features = std::vector<std::string>(), unsigned featureMask = 0);
+
+    /**
+     * @brief Returns the permutation built with the given features. Each one is compiled on
+     * first use and kept, later calls are a table lookup. Call on the Shader that owns the features
+     *
+     * @param featureMask Bitmask over the features passed to the ctor
+     *
+     * @returns Permutation program, this shader itself for its own mask
+     */
+    Shader& GetVariant(unsigned featureMask);
+
+    /**
+     * @brief Returns the features this program was built with
+     *
+     */
+    unsigned GetFeatureMask() const;
+
+    /**
+     * @brief Assigns a sampler uniform to a texture unit in this program and all of its
+     * permutations, including ones compiled later. Leaves the bound program unchanged
+     *
+     * @param uniform Name of sampler uniform
+     * @param unit Texture unit
+     */
+    void SetSampler(const char* uniform, int unit);
+
+    /**
+     * @brief Returns the program, waiting for its compile and link if still pending.
+     * Reports errors and caches the binary the first time
+     *
+     * @returns Program ID, 0 if it failed to build
+     */
+    unsigned GetId();
+
+    /**
+     * @brief Makes the program current through gGLState, waiting for it like GetId
+     *
+     */
+    void Use();
+
+    /**
+     * @brief Returns whether the program finished building, without blocking.
+     * Always true without GL_KHR_parallel_shader_compile
+     *
+     */
+    bool IsReady() const;
+
+    /**
+     * @brief Submits the given permutations so they compile in the background
+     *
+     * @param featureMasks Feature masks to build
+     */
+    void WarmUp(const std::vector<unsigned>& featureMasks);
+
+    /**
+     * @brief Returns how many programs of this shader and its permutations are still compiling
+     *
+     */
+    unsigned GetPendingCount() const;
+
+    /**
+     * @brief Waits for this shader and all of its permutations
+     *
+     * @returns Number of programs
+     */
+    unsigned FinishAll();
+
+    /**
+     * @brief Makes every new shader wait for its own compile right away, to compare
+     * against the submit-then-poll path
+     *
+     * @param serial Serial compilation state
+     */
+    static void SetSerialCompile(bool serial);
 
     /**
      * @brief Sets int uniform value
@@ -31,7 +157,7 @@ public:
      * @param uniform Name of uniform
      * @param v Value
      */
-    void SetUniform1i(const std::string& uniform, int v) const;
+    void SetUniform1i(const char* uniform, int v) const;
 
     /**
      * @brief Sets float uniform value
@@ -39,7 +165,7 @@ public:
      * @param uniform Name of uniform
      * @param v Value
      */
-    void SetUniform1f(const std::string& uniform, float v) const;
+    void SetUniform1f(const char* uniform, float v) const;
 
     /**
     * @brief Sets float uniform value
@@ -47,7 +173,15 @@ public:
     * @param uniform Name of uniform
     * @param v Value
     */
-    void SetUniform3f(const std::string& uniform, const glm::vec3& v) const;
+    void SetUniform3f(const char* uniform, const glm::vec3& v) const;
+
+    /**
+    * @brief Sets vec4 uniform value
+    *
+    * @param uniform Name of uniform
+    * @param v Value
+    */
+    void SetUniform4f(const char* uniform, const glm::vec4& v) const;
 
     /**
      * @brief Sets 4x4 matrix uniform value
@@ -55,7 +189,7 @@ public:
      * @param uniform Name of uniform
      * @param m GLM matrix
      */
-    void SetUniform4m(const std::string& uniform, const glm::mat4& m) const;
+    void SetUniform4m(const char* uniform, const glm::mat4& m) const;
 
     /**
      * @brief Sets the Model matrix
@@ -64,6 +198,21 @@ public:
      */
     void SetModel(const glm::mat4& m) const;
 
+    /**
+     * @brief Sets the model, model-view-projection and normal matrices of an object
+     *
+     * @param transform Transform computed by a TransformBatch
+     */
+    void SetTransform(const ObjectTransform& transform) const;
+
+    /**
+     * @brief Sets how basic.vert decodes the bound vertices
+     *
+     * @param compactVertices Whether the vertices are in the compact quantized format
+     * @param uvTransform Scale and offset of the quantized UVs, only sent for compact vertices
+     */
+    void SetVertexDecode(bool compactVertices, const glm::vec4& uvTransform) const;
+
     /**
      * @brief Sets the View matrix
      *
@@ -77,22 +226,113 @@ public:
      * @param m Projection matrix
      */
     void SetProjection(const glm::mat4& m) const;
+
+    /**
+     * @brief Returns the location of a uniform from the table reflected after linking.
+     * Names missing from the table fall back to glGetUniformLocation once and are cached
+     *
+     * @param uniform Name of uniform
+     *
+     * @returns Uniform location, -1 if inactive
+     */
+    GLint GetUniformLocation(const char* uniform) const;
+
+    /**
+     * @brief Resolves a typed uniform handle, for uniforms set every frame
+     *
+     * @param uniform Name of uniform
+     *
+     * @returns Uniform handle
+     */
+    template <typename T>
+    UniformHandle<T> GetUniform(const char* uniform) const {
+        return UniformHandle<T>(GetUniformLocation(uniform));
+    }
+
 private:
+    static bool sSerialCompile;
+    std::string mVertexPath;
+    std::string mFragmentPath;
+    std::vector<std::string> mFeatures;
+    unsigned mFeatureMask;
+    std::unordered_map<unsigned, std::unique_ptr<Shader> > mVariants;
+    std::vector<std::pair<std::string, int> > mSamplers;
+    unsigned mVertexShader;
+    unsigned mFragmentShader;
+    bool mPending;
+    bool mFromCache;
+    uint64_t mCacheKey;
+    std::string mCachePath;
+    float mCachedCompileMS;
+    std::chrono::steady_clock::time_point mSubmitTime;
+
+    // NOTE: Keyed by name. Hot uniforms go through the handles below, so the string built per lookup doesn't matter
+    mutable std::unordered_map<std::string, GLint> mUniformLocations;
+    UniformHandle<glm::mat4> mModelUniform;
+    UniformHandle<glm::mat4> mViewUniform;
+    UniformHandle<glm::mat4> mProjectionUniform;
+    UniformHandle<glm::mat4> mMVPUniform;
+    UniformHandle<glm::mat3> mNormalMatrixUniform;
+    UniformHandle<int> mCompactVerticesUniform;
+    UniformHandle<glm::vec4> mUVTransformUniform;
+
+    /**
+     * @brief Fills the location table with every active uniform of the linked program.
+     * Array elements get their own entries, both "name" and "name[0]" map to the first
+     *
+     */
+    void reflectUniforms();
+
+
+    /**
+     * @brief Starts building the program, from the binary cache or from source
+     *
+     * @param useCache Whether to try the program binary cache
+     */
+    void submit(bool useCache);
 
     /**
-     * @brief Loads shader from file and returns the compiled shader's ID
+     * @brief Waits for a submitted program, reports errors, caches the binary and reflects it
      *
-     * @param filename File path to be loaded
+     */
+    void finish();
+
+    /**
+     * @brief Starts compiling shader source and returns the shader's ID
+     *
+     * @param source Shader source, #includes already expanded
+     * @param length Source length
+     * @param defines Feature #define lines, inserted after the #version line
      * @param shadertType Type of shader: vertex or fragment
      * 
-     * @returns Compiled shader's ID
+     * @returns Shader ID
      */
-    unsigned loadAndCompileShader(std::string filename, GLuint shaderType);
+    unsigned compileShader(const char* source, size_t length, const std::string& defines, GLuint shaderType);
+
     /**
-     * @brief Creates a shader program and returns the ID
+     * @brief Reports the compile status of a shader
      *
-     * @param filename File path to be loaded
+     * @param filename File path the source was loaded from, for the log
+     * @param shader Shader ID
      * @param shadertType Type of shader: vertex or fragment
+     *
+     * @returns true - Compiled, false - Compile error
+     */
+    static bool checkShader(const std::string& filename, unsigned shader, GLuint shaderType);
+
+    /**
+     * @brief Returns the #define lines of a feature mask
+     *
+     * @param featureMask Feature bitmask
+     *
+     * @returns #define lines
+     */
+    std::string buildDefines(unsigned featureMask) const;
+    /**
+     * @brief Creates a shader program and starts linking it
+     *
+     * @param vShader Vertex shader ID
+     * @param fShader Fragment shader ID
      * 
      * @returns Shader program ID
      */
@@ -3,19 +3,58 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aUV;
+// NOTE: Diffuse and specular texture array layers of the draw, -1 samples the plain 2D textures.
+// Set per draw with glVertexAttrib2f (TEXTURE_ARRAY_LAYER_ATTRIBUTE in texturearray.hpp), per instance when instanced
+layout (location = 3) in vec2 aLayers;
 
-uniform mat4 uProjection;
-uniform mat4 uView;
+// NOTE: Per-object matrices computed on the CPU (see TransformBatch), the normal matrix is
+// the inverse transpose of the model matrix's upper 3x3
+#ifdef INSTANCED
+// NOTE: Per-instance copies of the same matrices, see InstanceData in instancebuffer.hpp
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat4 aMVP;
+layout (location = 12) in mat3 aNormalMatrix;
+#define MODEL_MATRIX aModel
+#define MVP_MATRIX aMVP
+#define NORMAL_MATRIX aNormalMatrix
+#else
 uniform mat4 uModel;
+uniform mat4 uMVP;
+uniform mat3 uNormalMatrix;
+#define MODEL_MATRIX uModel
+#define MVP_MATRIX uMVP
+#define NORMAL_MATRIX uNormalMatrix
+#endif
+
+// NOTE: Compact vertices (see VertexFormat in mesh.hpp). Position dequantization
+// is folded into uModel and uMVP, normals arrive octahedral-encoded in aNormal.xy
+uniform int uCompactVertices;
+uniform vec4 uUVTransform;
 
 out vec2 UV;
 out vec3 vWorldSpaceFragment;
 out vec3 vWorldSpaceNormal;
+flat out vec2 vLayers;
 
-void main() {
-	vWorldSpaceFragment = vec3(uModel * vec4(aPos, 1.0f));
-	vWorldSpaceNormal = normalize(mat3(transpose(inverse(uModel))) * aNormal);
+vec3 OctDecode(vec2 e) {
+	vec3 n = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
 
+void main() {
+	vec3 Normal = aNormal;
 	UV = aUV;
-	gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0f);
-}
\ No newline at end of file
+	vLayers = aLayers;
+	if (uCompactVertices == 1) {
+		Normal = OctDecode(aNormal.xy);
+		UV = aUV * uUVTransform.xy + uUVTransform.zw;
+	}
+
+	vWorldSpaceFragment = vec3(MODEL_MATRIX * vec4(aPos, 1.0f));
+	vWorldSpaceNormal = normalize(NORMAL_MATRIX * Normal);
+
+	gl_Position = MVP_MATRIX * vec4(aPos, 1.0f);
+}
@@ -0,0 +1,6 @@
+// NOTE: Shared by every program, CameraBlock in uniformblocks.hpp
+layout (std140) uniform CameraBlock {
+	mat4 uView;
+	mat4 uProjection;
+	vec3 uViewPos;
+};
@@ -2,10 +2,8 @@
 
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 uProjection;
-uniform mat4 uView;
-uniform mat4 uModel;
+uniform mat4 uMVP;
 
 void main() {
-	gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0f);
+	gl_Position = uMVP * vec4(aPos, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+// NOTE: Phong lighting library. Light counts come from the permutation defines
+// (see ShadingFeature in main.cpp), the loops unroll and unused lights compile out
+#ifndef POINT_LIGHT_COUNT
+#define POINT_LIGHT_COUNT 0
+#endif
+#ifndef SPOTLIGHT_COUNT
+#define SPOTLIGHT_COUNT 0
+#endif
+
+// NOTE: Array capacities, must match LIGHTS_MAX_* in uniformblocks.hpp
+#define MAX_POINT_LIGHTS 4
+#define MAX_SPOTLIGHTS 2
+
+#if POINT_LIGHT_COUNT > MAX_POINT_LIGHTS || SPOTLIGHT_COUNT > MAX_SPOTLIGHTS
+#error Light count exceeds the LightsBlock capacity
+#endif
+
+// NOTE: Members are ordered so scalars fill the std140 padding after each vec3,
+// see uniformblocks.hpp for the matching C++ structs. Range is the distance where
+// attenuation drops under 1/256, precomputed on the CPU so far lights are skipped
+struct PositionalLight {
+	vec3 Position;
+	float Kc;
+	vec3 Ka;
+	float Kl;
+	vec3 Kd;
+	float Kq;
+	vec3 Ks;
+	float Range;
+};
+
+// NOTE: Direction is unit length. Intensity scales the attenuated spotlight
+struct DirectionalLight {
+	vec3 Position;
+	float Kc;
+	vec3 Direction;
+	float Kl;
+	vec3 Ka;
+	float Kq;
+	vec3 Kd;
+	float InnerCutOff;
+	vec3 Ks;
+	float OuterCutOff;
+	float Range;
+	float Intensity;
+};
+
+layout (std140) uniform LightsBlock {
+	DirectionalLight uDirLight;
+	PositionalLight uPointLights[MAX_POINT_LIGHTS];
+	DirectionalLight uSpotlights[MAX_SPOTLIGHTS];
+};
+
+// NOTE: Material colors are sampled once by the caller and shared by every light
+struct SurfaceSample {
+	vec3 Position;
+	vec3 Normal;
+	vec3 ViewDirection;
+	vec3 DiffuseColor;
+	vec3 SpecularColor;
+	float Shininess;
+};
+
+vec3 PhongTerms(SurfaceSample surface, vec3 lightVector, vec3 ka, vec3 kd, vec3 ks) {
+	float Diffuse = max(dot(surface.Normal, lightVector), 0.0f);
+	vec3 ReflectDirection = reflect(-lightVector, surface.Normal);
+	float Specular = pow(max(dot(surface.ViewDirection, ReflectDirection), 0.0f), surface.Shininess);
+	return (ka + Diffuse * kd) * surface.DiffuseColor + Specular * ks * surface.SpecularColor;
+}
+
+vec3 DirectionalLighting(SurfaceSample surface) {
+	return PhongTerms(surface, -uDirLight.Direction, uDirLight.Ka, uDirLight.Kd, uDirLight.Ks);
+}
+
+vec3 PointLighting(SurfaceSample surface) {
+	vec3 Color = vec3(0.0f);
+	for (int LightIdx = 0; LightIdx < POINT_LIGHT_COUNT; ++LightIdx) {
+		vec3 ToLight = uPointLights[LightIdx].Position - surface.Position;
+		float Distance = length(ToLight);
+		if (Distance > uPointLights[LightIdx].Range) {
+			continue;
+		}
+
+		float Attenuation = 1.0f / (uPointLights[LightIdx].Kc + Distance * (uPointLights[LightIdx].Kl + uPointLights[LightIdx].Kq * Distance));
+		Color += Attenuation * PhongTerms(surface, ToLight / Distance, uPointLights[LightIdx].Ka, uPointLights[LightIdx].Kd, uPointLights[LightIdx].Ks);
+	}
+	return Color;
+}
+
+vec3 SpotLighting(SurfaceSample surface) {
+	vec3 Color = vec3(0.0f);
+	for (int LightIdx = 0; LightIdx < SPOTLIGHT_COUNT; ++LightIdx) {
+		vec3 ToLight = uSpotlights[LightIdx].Position - surface.Position;
+		float Distance = length(ToLight);
+		if (Distance > uSpotlights[LightIdx].Range) {
+			continue;
+		}
+
+		// NOTE: Cone test first, fragments outside the cone skip the Phong terms
+		vec3 LightVector = ToLight / Distance;
+		float Theta = dot(LightVector, -uSpotlights[LightIdx].Direction);
+		float Epsilon = uSpotlights[LightIdx].InnerCutOff - uSpotlights[LightIdx].OuterCutOff;
+		float ConeIntensity = clamp((Theta - uSpotlights[LightIdx].OuterCutOff) / Epsilon, 0.0f, 1.0f);
+		if (ConeIntensity <= 0.0f) {
+			continue;
+		}
+
+		float Attenuation = uSpotlights[LightIdx].Intensity / (uSpotlights[LightIdx].Kc + Distance * (uSpotlights[LightIdx].Kl + uSpotlights[LightIdx].Kq * Distance));
+		Color += ConeIntensity * Attenuation * PhongTerms(surface, LightVector, uSpotlights[LightIdx].Ka, uSpotlights[LightIdx].Kd, uSpotlights[LightIdx].Ks);
+	}
+	return Color;
+}
@@ -1,151 +1,51 @@
 #version 330 core
 
-struct PositionalLight {
-	vec3 Position;
-	vec3 Ka;
-	vec3 Kd;
-	vec3 Ks;
-	float Kc;
-	float Kl;
-	float Kq;
-};
-
-struct DirectionalLight {
-	vec3 Position;
-	vec3 Direction;
-	vec3 Ka;
-	vec3 Kd;
-	vec3 Ks;
-	float InnerCutOff;
-	float OuterCutOff;
-	float Kc;
-	float Kl;
-	float Kq;
-	float Allowed;
-};
+#include "camera.glsl"
+#include "lighting.glsl"
 
 struct Material {
 	sampler2D Kd;
 	sampler2D Ks;
-	float Shininess;
+	sampler2DArray KdLayers;
+	sampler2DArray KsLayers;
+};
+
+layout (std140) uniform MaterialBlock {
+	vec3 uKd;
+	float uShininess;
+	vec3 uKs;
 };
 
-uniform PositionalLight uPointLight;
-uniform PositionalLight uPointLight2;
-uniform PositionalLight uPointLight3;
-uniform DirectionalLight uSpotlight;
-uniform DirectionalLight uSpotlight2;
-uniform DirectionalLight uDirLight;
 uniform Material uMaterial;
-uniform vec3 uViewPos;
 
 in vec2 UV;
 in vec3 vWorldSpaceFragment;
 in vec3 vWorldSpaceNormal;
+flat in vec2 vLayers;
 
 out vec4 FragColor;
 
 void main() {
-	vec3 ViewDirection = normalize(uViewPos - vWorldSpaceFragment);
-	// NOTE(Jovan): Directional light
-	vec3 DirLightVector = normalize(-uDirLight.Direction);
-	float DirDiffuse = max(dot(vWorldSpaceNormal, DirLightVector), 0.0f);
-	vec3 DirReflectDirection = reflect(-DirLightVector, vWorldSpaceNormal);
-	// NOTE(Jovan): 32 is the specular shininess factor. Hardcoded for now
-	float DirSpecular = pow(max(dot(ViewDirection, DirReflectDirection), 0.0f), uMaterial.Shininess);
-
-	vec3 DirAmbientColor = uDirLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 DirDiffuseColor = uDirLight.Kd * DirDiffuse * vec3(texture(uMaterial.Kd, UV));
-	vec3 DirSpecularColor = uDirLight.Ks * DirSpecular * vec3(texture(uMaterial.Ks, UV));
-	vec3 DirColor = DirAmbientColor + DirDiffuseColor + DirSpecularColor;
-
-	// Point light
-	vec3 PtLightVector = normalize(uPointLight.Position - vWorldSpaceFragment);
-	float PtDiffuse = max(dot(vWorldSpaceNormal, PtLightVector), 0.0f);
-	vec3 PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
-	float PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
-
-	vec3 PtAmbientColor = uPointLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtDiffuseColor = PtDiffuse * uPointLight.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtSpecularColor = PtSpecular * uPointLight.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float PtLightDistance = length(uPointLight.Position - vWorldSpaceFragment);
-	float PtAttenuation = 1.0f / (uPointLight.Kc + uPointLight.Kl * PtLightDistance + uPointLight.Kq * (PtLightDistance * PtLightDistance));
-	vec3 PtColor = PtAttenuation * (PtAmbientColor + PtDiffuseColor + PtSpecularColor);
-
-	// Point light 2
-	vec3 PtLightVector2 = normalize(uPointLight2.Position - vWorldSpaceFragment);
-	float PtDiffuse2 = max(dot(vWorldSpaceNormal, PtLightVector2), 0.0f);
-	vec3 PtReflectDirection2 = reflect(-PtLightVector2, vWorldSpaceNormal);
-	float PtSpecular2 = pow(max(dot(ViewDirection, PtReflectDirection2), 0.0f), uMaterial.Shininess);
-
-	vec3 PtAmbientColor2 = uPointLight2.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtDiffuseColor2 = PtDiffuse2 * uPointLight2.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtSpecularColor2 = PtSpecular2 * uPointLight2.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float PtLightDistance2 = length(uPointLight2.Position - vWorldSpaceFragment);
-	float PtAttenuation2 = 1.0f / (uPointLight2.Kc + uPointLight2.Kl * PtLightDistance2 + uPointLight2.Kq * (PtLightDistance2 * PtLightDistance2));
-	vec3 PtColor2 = PtAttenuation2 * (PtAmbientColor2 + PtDiffuseColor2 + PtSpecularColor2);
-
-	// Point light 3
-	vec3 PtLightVector3 = normalize(uPointLight3.Position - vWorldSpaceFragment);
-	float PtDiffuse3 = max(dot(vWorldSpaceNormal, PtLightVector3), 0.0f);
-	vec3 PtReflectDirection3 = reflect(-PtLightVector3, vWorldSpaceNormal);
-	float PtSpecular3 = pow(max(dot(ViewDirection, PtReflectDirection3), 0.0f), uMaterial.Shininess);
-
-	vec3 PtAmbientColor3 = uPointLight3.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtDiffuseColor3 = PtDiffuse3 * uPointLight3.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtSpecularColor3 = PtSpecular3 * uPointLight3.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float PtLightDistance3 = length(uPointLight3.Position - vWorldSpaceFragment);
-	float PtAttenuation3 = 1.0f / (uPointLight3.Kc + uPointLight3.Kl * PtLightDistance3 + uPointLight3.Kq * (PtLightDistance3 * PtLightDistance3));
-	vec3 PtColor3 = PtAttenuation3 * (PtAmbientColor3 + PtDiffuseColor3 + PtSpecularColor3);
-
-	// Spotlight
-	vec3 SpotlightVector = normalize(uSpotlight.Position - vWorldSpaceFragment);
-
-	float SpotDiffuse = max(dot(vWorldSpaceNormal, SpotlightVector), 0.0f);
-	vec3 SpotReflectDirection = reflect(-SpotlightVector, vWorldSpaceNormal);
-	float SpotSpecular = pow(max(dot(ViewDirection, SpotReflectDirection), 0.0f), uMaterial.Shininess);
-
-	vec3 SpotAmbientColor = uSpotlight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotDiffuseColor = SpotDiffuse * uSpotlight.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotSpecularColor = SpotSpecular * uSpotlight.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float SpotlightDistance = length(uSpotlight.Position - vWorldSpaceFragment);
-	float SpotAttenuation = 1.0f / (uSpotlight.Kc + uSpotlight.Kl * SpotlightDistance + uSpotlight.Kq * (SpotlightDistance * SpotlightDistance));
-
-	float Theta = dot(SpotlightVector, normalize(-uSpotlight.Direction));
-	float Epsilon = uSpotlight.InnerCutOff - uSpotlight.OuterCutOff;
-	float SpotIntensity = clamp((Theta - uSpotlight.OuterCutOff) / Epsilon, 0.0f, 1.0f);
-	vec3 SpotColor = SpotIntensity * SpotAttenuation * (SpotAmbientColor + SpotDiffuseColor + SpotSpecularColor);
-
-	// Spotlight2
-	vec3 SpotlightVector2 = normalize(uSpotlight2.Position - vWorldSpaceFragment);
-
-	float SpotDiffuse2 = max(dot(vWorldSpaceNormal, SpotlightVector2), 0.0f);
-	vec3 SpotReflectDirection2 = reflect(-SpotlightVector2, vWorldSpaceNormal);
-	float SpotSpecular2 = pow(max(dot(ViewDirection, SpotReflectDirection2), 0.0f), uMaterial.Shininess);
-
-	vec3 SpotAmbientColor2 = uSpotlight2.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotDiffuseColor2 = SpotDiffuse2 * uSpotlight2.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotSpecularColor2 = SpotSpecular2 * uSpotlight2.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float SpotlightDistance2 = length(uSpotlight2.Position - vWorldSpaceFragment);
-	float SpotAttenuation2 = 2.5f / (uSpotlight2.Kc + uSpotlight2.Kl * SpotlightDistance2 + uSpotlight2.Kq * (SpotlightDistance2 * SpotlightDistance2));
-
-	float Theta2 = dot(SpotlightVector2, normalize(-uSpotlight2.Direction));
-	float Epsilon2 = uSpotlight2.InnerCutOff - uSpotlight2.OuterCutOff;
-	float SpotIntensity2 = clamp((Theta2 - uSpotlight2.OuterCutOff) / Epsilon2, 0.0f, 1.0f);
-	vec3 SpotColor2 = SpotIntensity2 * SpotAttenuation2 * (SpotAmbientColor2 + SpotDiffuseColor2 + SpotSpecularColor2);
-	
-	vec3 FinalColor = DirColor + PtColor + PtColor2 + PtColor3;
-	if (uSpotlight.Allowed == 1) {
-		FinalColor += SpotColor + SpotColor2;
-	} 
-	if (uSpotlight2.Allowed == 1) {
-		FinalColor = SpotColor + SpotColor2;
-	} 
+	SurfaceSample Surface;
+#ifdef TEXTURED
+	Surface.DiffuseColor = vLayers.x < 0.0f ? vec3(texture(uMaterial.Kd, UV)) : vec3(texture(uMaterial.KdLayers, vec3(UV, vLayers.x)));
+	Surface.SpecularColor = vLayers.y < 0.0f ? vec3(texture(uMaterial.Ks, UV)) : vec3(texture(uMaterial.KsLayers, vec3(UV, vLayers.y)));
+#else
+	Surface.DiffuseColor = uKd;
+	Surface.SpecularColor = uKs;
+#endif
+	Surface.Position = vWorldSpaceFragment;
+	Surface.Normal = vWorldSpaceNormal;
+	Surface.ViewDirection = normalize(uViewPos - vWorldSpaceFragment);
+	Surface.Shininess = uShininess;
+
+	vec3 FinalColor = vec3(0.0f);
+	// NOTE: Spotlight-only mode lights the scene with the spotlights alone
+#ifndef SPOTLIGHT_ONLY
+	FinalColor += DirectionalLighting(Surface);
+	FinalColor += PointLighting(Surface);
+#endif
+	FinalColor += SpotLighting(Surface);
 
 	FragColor = vec4(FinalColor, 1.0f);
-}
\ No newline at end of file
+}
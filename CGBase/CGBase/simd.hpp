@@ -0,0 +1,28 @@
+/**
+ * @file simd.hpp
+ * @brief Instruction set detection for the SIMD code paths.
+ * Every SIMD kernel keeps a scalar fallback for builds without these
+ *
+ */
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define CG_SSE41 1
+#include <smmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define CG_AVX 1
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define CG_AVX2 1
+#include <immintrin.h>
+#endif
@@ -1,39 +1,349 @@
 #include "texture.hpp"
+#include <cstring>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "assetpack.hpp"
+#include "hash.hpp"
+#include "bcencoder.hpp"
+#include "texturecache.hpp"
+#include "mipbuilder.hpp"
+#include "glstate.hpp"
+
+bool Texture::sCompression = false;
+
+void
+Texture::SetCompression(bool enabled) {
+    sCompression = enabled;
+}
 
 unsigned
-Texture::LoadImageToTexture(const std::string& filePath) {
-    int TextureWidth;
-    int TextureHeight;
-    int TextureChannels;
+Texture::LoadImageToTexture(const std::string& filePath, bool srgb) {
+    TextureImage Image;
+    DecodeImage(filePath, Image, srgb);
+    return UploadImage(Image);
+}
+
+bool
+Texture::DecodeImage(const std::string& filePath, TextureImage& image, bool srgb, int width, int height) {
+    image.Path = filePath;
+    image.SRGB = srgb;
+    bool Resample = width && height;
+    std::string CachePath = filePath;
+    if (Resample) {
+        CachePath += "." + std::to_string(width) + "x" + std::to_string(height);
+    }
+    // NOTE: Data textures get their own cache, their mips differ from the sRGB ones
+    if (!srgb) {
+        CachePath += ".linear";
+    }
+    CachePath += TEXTURE_CACHE_EXTENSION;
+    if (sCompression && TextureCache::Load(CachePath, filePath, image)) {
+        hashImage(image);
+        return true;
+    }
+
     std::cout << "Loading texture: " << filePath << std::endl;
-    unsigned char* ImageData = stbi_load(filePath.c_str(), &TextureWidth, &TextureHeight, &TextureChannels, 0);
+    Asset Source;
+    unsigned char* Pixels = 0;
+    if (Source.Open(filePath)) {
+        Pixels = stbi_load_from_memory(Source.Data(), (int)Source.Size(), &image.Width, &image.Height, &image.Channels, 0);
+    }
 
-    if (!ImageData) {
+    if (!Pixels) {
+        if (filePath == MISSING_TEXTURE_PATH) {
+            std::cerr << "[Err] Failed to load default texture: " << filePath << std::endl;
+            return false;
+        }
         std::cerr << "Failed to load texture: " << filePath << " loading default instead" << std::endl;
-        return LoadImageToTexture(MISSING_TEXTURE_PATH);
+        return DecodeImage(MISSING_TEXTURE_PATH, image, srgb, width, height);
+    }
+
+    // NOTE: Single channel images are masks or heights, never colour
+    bool SRGBColor = srgb && image.Channels > 1;
+    const unsigned char* Level0 = Pixels;
+    std::vector<unsigned char> Resampled;
+    if (Resample && (image.Width != width || image.Height != height)) {
+        MipBuilder::Resample(Pixels, image.Width, image.Height, image.Channels, SRGBColor, width, height, Resampled);
+        Level0 = Resampled.data();
+        image.Width = width;
+        image.Height = height;
     }
-    stbi__vertical_flip(ImageData, TextureWidth, TextureHeight, TextureChannels);
-    GLint InternalFormat = -1;
-    switch (TextureChannels) {
-    case 1: InternalFormat = GL_RED; break;
-    case 3: InternalFormat = GL_RGB; break;
-    case 4: InternalFormat = GL_RGBA; break;
-    default: InternalFormat = GL_RGB; break;
+    // NOTE: The flip happens inside the mip builder's first pass
+    MipBuilder::Build(Level0, image.Width, image.Height, image.Channels, SRGBColor, image.LevelData, image.LevelSizes);
+    stbi_image_free(Pixels);
+
+    if (sCompression) {
+        compressImage(image, Resample);
+        TextureCache::Save(CachePath, filePath, image);
+    }
+    hashImage(image);
+    return true;
+}
+
+bool
+Texture::ReadImageInfo(const std::string& filePath, int& width, int& height, int& channels) {
+    Asset Source;
+    return Source.Open(filePath) && stbi_info_from_memory(Source.Data(), (int)Source.Size(), &width, &height, &channels) != 0;
+}
+
+void
+Texture::hashImage(TextureImage& image) {
+    // NOTE: Compressed images hash their levels, so a cache hit and a fresh compression agree
+    int Dimensions[3] = { image.Width, image.Height, image.CompressedFormat ? (int)image.CompressedFormat : image.Channels };
+    image.ContentHash = HashBytes(Dimensions, sizeof(Dimensions));
+    image.ContentHash = HashBytes(image.LevelData.data(), image.LevelData.size(), image.ContentHash);
+}
+
+static GLenum
+compressedFormat(int channels) {
+    switch (channels) {
+    case 1: return GL_COMPRESSED_RED_RGTC1;
+    // NOTE: Grey + alpha, sampled through a RRRG swizzle
+    case 2: return GL_COMPRESSED_RG_RGTC2;
+    case 4: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+}
+
+static BCFormat
+blockFormat(GLenum compressedFormat) {
+    switch (compressedFormat) {
+    case GL_COMPRESSED_RED_RGTC1: return BC_FORMAT_BC4;
+    case GL_COMPRESSED_RG_RGTC2: return BC_FORMAT_BC5;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return BC_FORMAT_BC3;
+    default: return BC_FORMAT_BC1;
+    }
+}
+
+/**
+ * @brief Returns client format and sized internal format for an uncompressed image
+ *
+ */
+static void
+channelFormats(int channels, GLenum& format, GLenum& internalFormat) {
+    switch (channels) {
+    case 1: format = GL_RED; internalFormat = GL_R8; break;
+    case 2: format = GL_RG; internalFormat = GL_RG8; break;
+    case 4: format = GL_RGBA; internalFormat = GL_RGBA8; break;
+    default: format = GL_RGB; internalFormat = GL_RGB8; break;
+    }
+}
+
+void
+Texture::compressImage(TextureImage& image, bool alphaByChannels) {
+    image.CompressedFormat = compressedFormat(image.Channels);
+    // NOTE: Opaque RGBA fits BC1 at half the size, unless the format has to follow the channel count
+    if (image.Channels == 4 && !alphaByChannels) {
+        size_t PixelCount = (size_t)image.Width * image.Height;
+        bool Opaque = true;
+        for (size_t PixelIdx = 0; PixelIdx < PixelCount && Opaque; ++PixelIdx) {
+            Opaque = image.LevelData[PixelIdx * 4 + 3] == 255;
+        }
+        if (Opaque) {
+            image.CompressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        }
+    }
+    BCFormat Format = blockFormat(image.CompressedFormat);
+
+    // NOTE: Every level is encoded from the mip builder's chain
+    int Width = image.Width;
+    int Height = image.Height;
+    const unsigned char* Level = image.LevelData.data();
+    std::vector<unsigned char> Compressed;
+    for (unsigned LevelIdx = 0; LevelIdx < image.LevelSizes.size(); ++LevelIdx) {
+        size_t LevelSize = BCEncoder::GetCompressedSize(Format, Width, Height);
+        Compressed.resize(Compressed.size() + LevelSize);
+        BCEncoder::Encode(Format, Level, Width, Height, image.Channels, Compressed.data() + Compressed.size() - LevelSize);
+        Level += image.LevelSizes[LevelIdx];
+        image.LevelSizes[LevelIdx] = LevelSize;
+        Width = Width > 1 ? Width / 2 : 1;
+        Height = Height > 1 ? Height / 2 : 1;
+    }
+    image.LevelData.swap(Compressed);
+}
+
+void
+Texture::UploadLevels(const TextureImage& image, const unsigned char* data) {
+    GLenum Format;
+    GLenum InternalFormat;
+    channelFormats(image.Channels, Format, InternalFormat);
+    if (image.CompressedFormat) {
+        InternalFormat = image.CompressedFormat;
+    }
+
+    GLsizei LevelCount = image.LevelSizes.size();
+    bool Immutable = GLEW_ARB_texture_storage != 0;
+    if (Immutable) {
+        glTexStorage2D(GL_TEXTURE_2D, LevelCount, InternalFormat, image.Width, image.Height);
+    }
+    // NOTE: Odd sized RGB levels have rows that aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int Width = image.Width;
+    int Height = image.Height;
+    for (GLsizei LevelIdx = 0; LevelIdx < LevelCount; ++LevelIdx) {
+        GLsizei LevelSize = image.LevelSizes[LevelIdx];
+        if (image.CompressedFormat && Immutable) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, LevelIdx, 0, 0, Width, Height, InternalFormat, LevelSize, data);
+        } else if (image.CompressedFormat) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, LevelIdx, InternalFormat, Width, Height, 0, LevelSize, data);
+        } else if (Immutable) {
+            glTexSubImage2D(GL_TEXTURE_2D, LevelIdx, 0, 0, Width, Height, Format, GL_UNSIGNED_BYTE, data);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, LevelIdx, InternalFormat, Width, Height, 0, Format, GL_UNSIGNED_BYTE, data);
+        }
+        data += LevelSize;
+        Width = Width > 1 ? Width / 2 : 1;
+        Height = Height > 1 ? Height / 2 : 1;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LevelCount - 1);
+    if (image.Channels == 2 || image.CompressedFormat == GL_COMPRESSED_RG_RGTC2) {
+        GLint Swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, Swizzle);
+    }
+}
+
+void
+Texture::UploadLayer(const TextureImage& image, unsigned layer, const unsigned char* data) {
+    GLenum Format;
+    GLenum InternalFormat;
+    channelFormats(image.Channels, Format, InternalFormat);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int Width = image.Width;
+    int Height = image.Height;
+    for (unsigned LevelIdx = 0; LevelIdx < image.LevelSizes.size(); ++LevelIdx) {
+        if (image.CompressedFormat) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, LevelIdx, 0, 0, layer, Width, Height, 1, image.CompressedFormat, image.LevelSizes[LevelIdx], data);
+        } else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, LevelIdx, 0, 0, layer, Width, Height, 1, Format, GL_UNSIGNED_BYTE, data);
+        }
+        data += image.LevelSizes[LevelIdx];
+        Width = Width > 1 ? Width / 2 : 1;
+        Height = Height > 1 ? Height / 2 : 1;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+GLenum
+Texture::GetInternalFormat(int channels) {
+    GLenum Format;
+    GLenum InternalFormat;
+    channelFormats(channels, Format, InternalFormat);
+    return sCompression ? compressedFormat(channels) : InternalFormat;
+}
+
+unsigned
+Texture::CreateArray(int channels, int width, int height, unsigned layers) {
+    GLenum Format;
+    GLenum UncompressedFormat;
+    channelFormats(channels, Format, UncompressedFormat);
+    GLenum InternalFormat = GetInternalFormat(channels);
+    bool Compressed = InternalFormat != UncompressedFormat;
+
+    // NOTE: One grey 4x4 block, or one grey pixel, repeated over every level
+    unsigned char GreyPixels[16 * 4];
+    for (unsigned ValueIdx = 0; ValueIdx < 16 * (unsigned)channels; ++ValueIdx) {
+        bool IsAlpha = (channels == 2 || channels == 4) && ValueIdx % channels == (unsigned)channels - 1;
+        GreyPixels[ValueIdx] = IsAlpha ? 255 : 128;
+    }
+    std::vector<unsigned char> Block(GreyPixels, GreyPixels + channels);
+    if (Compressed) {
+        Block.resize(BCEncoder::GetCompressedSize(blockFormat(InternalFormat), 4, 4));
+        BCEncoder::Encode(blockFormat(InternalFormat), GreyPixels, 4, 4, channels, Block.data());
+    }
+    size_t BaseSize = Compressed ? BCEncoder::GetCompressedSize(blockFormat(InternalFormat), width, height) : (size_t)width * height * channels;
+    std::vector<unsigned char> Fill(BaseSize * layers);
+    for (size_t Offset = 0; Offset < Fill.size(); Offset += Block.size()) {
+        memcpy(&Fill[Offset], Block.data(), Block.size());
+    }
+
+    unsigned Texture;
+    unsigned LevelCount = MipBuilder::GetLevelCount(width, height);
+    bool Immutable = GLEW_ARB_texture_storage != 0;
+    glGenTextures(1, &Texture);
+    gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, Texture);
+    if (Immutable) {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, LevelCount, InternalFormat, width, height, layers);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int Width = width;
+    int Height = height;
+    for (unsigned LevelIdx = 0; LevelIdx < LevelCount; ++LevelIdx) {
+        GLsizei LevelSize = (Compressed ? BCEncoder::GetCompressedSize(blockFormat(InternalFormat), Width, Height) : (size_t)Width * Height * channels) * layers;
+        if (Compressed && Immutable) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, LevelIdx, 0, 0, 0, Width, Height, layers, InternalFormat, LevelSize, Fill.data());
+        } else if (Compressed) {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, LevelIdx, InternalFormat, Width, Height, layers, 0, LevelSize, Fill.data());
+        } else if (Immutable) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, LevelIdx, 0, 0, 0, Width, Height, layers, Format, GL_UNSIGNED_BYTE, Fill.data());
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, LevelIdx, InternalFormat, Width, Height, layers, 0, Format, GL_UNSIGNED_BYTE, Fill.data());
+        }
+        Width = Width > 1 ? Width / 2 : 1;
+        Height = Height > 1 ? Height / 2 : 1;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, LevelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (channels == 2) {
+        GLint Swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, Swizzle);
+    }
+    gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+    return Texture;
+}
+
+unsigned
+Texture::UploadImage(TextureImage& image) {
+    if (image.LevelData.empty()) {
+        return 0;
     }
 
     unsigned Texture;
     glGenTextures(1, &Texture);
-    glBindTexture(GL_TEXTURE_2D, Texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, TextureWidth, TextureHeight, 0, InternalFormat, GL_UNSIGNED_BYTE, ImageData);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    gGLState.BindTexture(0, GL_TEXTURE_2D, Texture);
+    UploadLevels(image, image.LevelData.data());
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    stbi_image_free(ImageData);
+    gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+    FreeImage(image);
     return Texture;
-}
\ No newline at end of file
+}
+
+bool
+Texture::MatchesImage(unsigned texture, const TextureImage& image) {
+    GLenum Format;
+    GLenum InternalFormat;
+    channelFormats(image.Channels, Format, InternalFormat);
+    std::vector<unsigned char> Level;
+    const unsigned char* Expected = image.LevelData.data();
+    bool Matches = true;
+    gGLState.BindTexture(0, GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (unsigned LevelIdx = 0; LevelIdx < image.LevelSizes.size() && Matches; ++LevelIdx) {
+        Level.resize(image.LevelSizes[LevelIdx]);
+        if (image.CompressedFormat) {
+            glGetCompressedTexImage(GL_TEXTURE_2D, LevelIdx, Level.data());
+        } else {
+            glGetTexImage(GL_TEXTURE_2D, LevelIdx, Format, GL_UNSIGNED_BYTE, Level.data());
+        }
+        Matches = memcmp(Level.data(), Expected, Level.size()) == 0;
+        Expected += Level.size();
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+    return Matches;
+}
+
+void
+Texture::FreeImage(TextureImage& image) {
+    std::vector<unsigned char>().swap(image.LevelData);
+}
@@ -1,10 +1,35 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <GL/glew.h>
 #include <iostream>
 
 static const std::string MISSING_TEXTURE_PATH = "res/missing_texture";
 
+/**
+ * @brief Decoded image waiting for upload. LevelData holds the whole mip chain bottom up,
+ * block compressed when CompressedFormat is set
+ *
+ */
+struct TextureImage {
+	std::string Path;
+	int Width;
+	int Height;
+	int Channels;
+	// NOTE: Hash of the dimensions and level data,
+	// lets TextureRegistry share identical images
+	uint64_t ContentHash;
+	// NOTE: GL compressed internal format, 0 for uncompressed images
+	unsigned CompressedFormat;
+	// NOTE: false for data (specular, masks), its mips are filtered without gamma decoding
+	bool SRGB;
+	std::vector<unsigned> LevelSizes;
+	std::vector<unsigned char> LevelData;
+
+	TextureImage() : Width(0), Height(0), Channels(0), ContentHash(0), CompressedFormat(0), SRGB(true) {}
+};
+
 class Texture {
 public:
 	/**
@@ -14,7 +39,113 @@ public:
 	 * negated with the addition of loss of quality
 	 *
 	 * @param filePath Image file path
+	 * @param srgb Whether the image holds sRGB colour, see DecodeImage
+	 * @returns TextureID
+	 */
+	static unsigned LoadImageToTexture(const std::string& filePath, bool srgb = true);
+
+	/**
+	 * @brief Decodes an image file, flips it and builds its mip chain, then hashes it. With
+	 * compression enabled, prefers the block compressed cache next to the file and creates
+	 * it on a miss. Touches no GL state, so it is safe to call from worker threads.
+	 * Falls back to the missing texture
+	 *
+	 * @param filePath Image file path
+	 * @param image Output image
+	 * @param srgb true for colour (diffuse), false for data (specular, masks). Single channel
+	 * images are always treated as data. Decides whether mips are filtered in linear space
+	 * @param width Resample to this width, 0 keeps the original size
+	 * @param height Resample to this height, 0 keeps the original size
+	 * @returns true - Success, false - Neither the file nor the fallback could be decoded
+	 */
+	static bool DecodeImage(const std::string& filePath, TextureImage& image, bool srgb, int width = 0, int height = 0);
+
+	/**
+	 * @brief Reads dimensions and channel count from the image header without decoding it
+	 *
+	 * @param filePath Image file path
+	 * @param width Output width
+	 * @param height Output height
+	 * @param channels Output channel count
+	 * @returns true - Success, false - Unreadable or unsupported file
+	 */
+	static bool ReadImageInfo(const std::string& filePath, int& width, int& height, int& channels);
+
+	/**
+	 * @brief Allocates the bound GL_TEXTURE_2D and uploads every level of the image.
+	 * Uses immutable storage when ARB_texture_storage is available
+	 *
+	 * @param image Decoded image, only the format, dimensions and level sizes are read
+	 * @param data Level data, or an offset when a pixel unpack buffer is bound
+	 */
+	static void UploadLevels(const TextureImage& image, const unsigned char* data);
+
+	/**
+	 * @brief Uploads every level of the image into one layer of the bound GL_TEXTURE_2D_ARRAY
+	 *
+	 * @param image Decoded image, must match the array's format and dimensions
+	 * @param layer Array layer
+	 * @param data Level data, or an offset when a pixel unpack buffer is bound
+	 */
+	static void UploadLayer(const TextureImage& image, unsigned layer, const unsigned char* data);
+
+	/**
+	 * @brief Creates a texture array with a full mip chain, every layer filled with grey.
+	 * Layers decoded with DecodeImage at the same size and channel count fit it
+	 *
+	 * @param channels Channels per pixel of the layers
+	 * @param width Layer width
+	 * @param height Layer height
+	 * @param layers Layer count
 	 * @returns TextureID
 	 */
-	static unsigned LoadImageToTexture(const std::string& filePath);
+	static unsigned CreateArray(int channels, int width, int height, unsigned layers);
+
+	/**
+	 * @brief Returns the internal format a decoded image with the given channel count is uploaded as.
+	 * Resampled images always get the same format for a channel count, so they can share arrays
+	 *
+	 * @param channels Channels per pixel
+	 * @returns Sized or block compressed internal format
+	 */
+	static GLenum GetInternalFormat(int channels);
+
+	/**
+	 * @brief Enables block compression for every image decoded afterwards.
+	 * Enable only when the context supports EXT_texture_compression_s3tc
+	 *
+	 * @param enabled Compression state
+	 */
+	static void SetCompression(bool enabled);
+
+	/**
+	 * @brief Creates an OpenGL texture from a decoded image and frees its level data
+	 *
+	 * @param image Decoded image
+	 * @returns TextureID, 0 if the image holds no pixels
+	 */
+	static unsigned UploadImage(TextureImage& image);
+
+	/**
+	 * @brief Reads a texture created by UploadImage back and compares it with an image.
+	 * Stalls until the GPU catches up, meant for the rare content hash hit at load time
+	 *
+	 * @param texture TextureID
+	 * @param image Decoded image with the same dimensions, format and level sizes
+	 * @returns true - Every level is byte for byte identical
+	 */
+	static bool MatchesImage(unsigned texture, const TextureImage& image);
+
+	/**
+	 * @brief Frees level data without uploading it
+	 *
+	 * @param image Decoded image
+	 */
+	static void FreeImage(TextureImage& image);
+
+private:
+	static bool sCompression;
+
+	static void compressImage(TextureImage& image, bool alphaByChannels);
+	static void hashImage(TextureImage& image);
 };
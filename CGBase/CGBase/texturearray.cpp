@@ -0,0 +1,98 @@
+#include "texturearray.hpp"
+#include <iostream>
+#include "glstate.hpp"
+
+TextureArrayBuilder::TextureArrayBuilder() {
+    mStreamer = 0;
+}
+
+unsigned
+TextureArrayBuilder::Add(const std::string& filePath, bool srgb) {
+    for (unsigned SlotIdx = 0; SlotIdx < mSlots.size(); ++SlotIdx) {
+        if (mSlots[SlotIdx].Path == filePath && mSlots[SlotIdx].SRGB == srgb) {
+            return SlotIdx;
+        }
+    }
+
+    Slot NewSlot;
+    NewSlot.Path = filePath;
+    NewSlot.Width = 0;
+    NewSlot.Height = 0;
+    NewSlot.Channels = 0;
+    NewSlot.SRGB = srgb;
+    NewSlot.Group = 0;
+    NewSlot.Layer = 0;
+    mSlots.push_back(NewSlot);
+    return mSlots.size() - 1;
+}
+
+void
+TextureArrayBuilder::Build(TextureStreamer& streamer) {
+    for (unsigned SlotIdx = 0; SlotIdx < mSlots.size(); ++SlotIdx) {
+        Slot& Current = mSlots[SlotIdx];
+        // NOTE: Unreadable files decode as the missing texture, or stay grey if that fails too
+        if (!Texture::ReadImageInfo(Current.Path, Current.Width, Current.Height, Current.Channels)
+            && !Texture::ReadImageInfo(MISSING_TEXTURE_PATH, Current.Width, Current.Height, Current.Channels)) {
+            Current.Width = 0;
+            Current.Height = 0;
+            Current.Channels = 3;
+        }
+
+        int Size = 1;
+        while (Size < TEXTURE_ARRAY_MAX_SIZE && (Size < Current.Width || Size < Current.Height)) {
+            Size *= 2;
+        }
+        unsigned GroupIdx = 0;
+        while (GroupIdx < mGroups.size() && (mGroups[GroupIdx].Channels != Current.Channels || mGroups[GroupIdx].Size != Size)) {
+            ++GroupIdx;
+        }
+        if (GroupIdx == mGroups.size()) {
+            Group NewGroup = { Current.Channels, Size, 0, 0 };
+            mGroups.push_back(NewGroup);
+        }
+
+        Current.Group = GroupIdx;
+        Current.Layer = mGroups[GroupIdx].LayerCount++;
+    }
+
+    // NOTE: UVs are normalized, so squaring a layer only changes the resolution it is stored at
+    for (unsigned GroupIdx = 0; GroupIdx < mGroups.size(); ++GroupIdx) {
+        Group& Current = mGroups[GroupIdx];
+        Current.Texture = Texture::CreateArray(Current.Channels, Current.Size, Current.Size, Current.LayerCount);
+    }
+    for (unsigned SlotIdx = 0; SlotIdx < mSlots.size(); ++SlotIdx) {
+        const Slot& Current = mSlots[SlotIdx];
+        const Group& Owner = mGroups[Current.Group];
+        streamer.RequestLayer(Current.Path, Owner.Texture, Current.Layer, Owner.Size, Owner.Size, Current.SRGB);
+    }
+    mStreamer = &streamer;
+
+    std::cout << "[Info] Texture arrays: " << mSlots.size() << " textures in " << mGroups.size() << " arrays" << std::endl;
+}
+
+TextureArrayLayer
+TextureArrayBuilder::GetLayer(unsigned slot) const {
+    const Slot& Current = mSlots[slot];
+    TextureArrayLayer Result = { mGroups[Current.Group].Texture, Current.Layer };
+    return Result;
+}
+
+TextureArrayLayer
+TextureArrayBuilder::Resolve(const TextureArrayLayer& layer) const {
+    unsigned Standalone = mStreamer ? mStreamer->GetLayerFallback(layer.Texture, layer.Layer) : 0;
+    if (!Standalone) {
+        return layer;
+    }
+    TextureArrayLayer Result = { Standalone, INSTANCE_NO_LAYER };
+    return Result;
+}
+
+void
+TextureArrayBuilder::Release() {
+    for (unsigned GroupIdx = 0; GroupIdx < mGroups.size(); ++GroupIdx) {
+        gGLState.DeleteTexture(mGroups[GroupIdx].Texture);
+    }
+    mGroups.clear();
+    mSlots.clear();
+    mStreamer = 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file texturearray.hpp
+ * @brief Packs textures with the same channel count and size class into shared GL_TEXTURE_2D_ARRAY
+ * objects, so draws that differ only by texture select a layer instead of rebinding
+ *
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include "instancebuffer.hpp"
+#include "texturestreamer.hpp"
+
+// NOTE: Largest layer size, bigger images are resampled down to it
+#define TEXTURE_ARRAY_MAX_SIZE 1024
+// NOTE: Generic vertex attribute with the diffuse and specular layer of a draw, see basic.vert.
+// Draws that sample plain 2D textures set it to -1
+#define TEXTURE_ARRAY_LAYER_ATTRIBUTE 3
+
+// NOTE: Layer is INSTANCE_NO_LAYER when Texture is a plain 2D texture, see TextureArrayBuilder::Resolve
+struct TextureArrayLayer {
+    unsigned Texture;
+    unsigned Layer;
+};
+
+class TextureArrayBuilder {
+public:
+    TextureArrayBuilder();
+
+    /**
+     * @brief Adds an image file. Adding the same path twice returns the same slot
+     *
+     * @param filePath Image file path
+     * @param srgb Whether the image holds sRGB colour. false for specular maps, see Texture::DecodeImage
+     *
+     * @returns Slot, resolved with GetLayer after Build
+     */
+    unsigned Add(const std::string& filePath, bool srgb = true);
+
+    /**
+     * @brief Groups the added images by channel count and by size rounded up to a power of two,
+     * creates one array per group and queues every image on the streamer. Layers are square,
+     * so no image is upscaled past its own size class. Must run on the GL thread
+     *
+     * @param streamer Streamer decoding and uploading the layers
+     */
+    void Build(TextureStreamer& streamer);
+
+    /**
+     * @brief Returns the array and layer of a slot
+     *
+     * @param slot Slot returned by Add
+     *
+     * @returns Array and layer, usable right after Build
+     */
+    TextureArrayLayer GetLayer(unsigned slot) const;
+
+    /**
+     * @brief Swaps in the standalone 2D texture the streamer used if the layer's image
+     * didn't fit its array. Cheap, meant to be called on every draw
+     *
+     * @param layer Layer returned by GetLayer
+     *
+     * @returns The layer itself, or the 2D texture with Layer INSTANCE_NO_LAYER
+     */
+    TextureArrayLayer Resolve(const TextureArrayLayer& layer) const;
+
+    /**
+     * @brief Deletes the arrays. Must run on the GL thread
+     *
+     */
+    void Release();
+
+private:
+    struct Slot {
+        std::string Path;
+        int Width;
+        int Height;
+        int Channels;
+        bool SRGB;
+        unsigned Group;
+        unsigned Layer;
+    };
+
+    struct Group {
+        int Channels;
+        int Size;
+        unsigned Texture;
+        unsigned LayerCount;
+    };
+
+    std::vector<Slot> mSlots;
+    std::vector<Group> mGroups;
+    // NOTE: Set by Build
+    const TextureStreamer* mStreamer;
+};
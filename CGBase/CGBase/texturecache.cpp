@@ -0,0 +1,186 @@
+#include "texturecache.hpp"
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include "assetpack.hpp"
+#include "mappedfile.hpp"
+#include "hash.hpp"
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const uint32_t KTX_ENDIANNESS = 0x04030201;
+static const char STAMP_KEY[] = "CGBase.source";
+static const char ORIENTATION_KEY[] = "KTXorientation";
+// NOTE: Rows are stored bottom up, the way GL expects them
+static const char ORIENTATION_VALUE[] = "S=r,T=u";
+
+static size_t
+alignTo4(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+static GLenum
+baseInternalFormat(unsigned compressedFormat) {
+    switch (compressedFormat) {
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return GL_RGBA;
+    case GL_COMPRESSED_RED_RGTC1: return GL_RED;
+    case GL_COMPRESSED_RG_RGTC2: return GL_RG;
+    default: return GL_RGB;
+    }
+}
+
+bool
+TextureCache::stampSource(const std::string& sourcePath, TextureCacheStamp& stamp, bool hash) {
+    struct stat SourceStat;
+    if (stat(sourcePath.c_str(), &SourceStat) != 0) {
+        return false;
+    }
+
+    memset(&stamp, 0, sizeof(stamp));
+    stamp.Version = TEXTURE_CACHE_VERSION;
+    stamp.SourceSize = (uint64_t)SourceStat.st_size;
+    stamp.SourceMTime = (int64_t)SourceStat.st_mtime;
+    if (hash) {
+        MappedFile Source;
+        if (!Source.Open(sourcePath)) {
+            return false;
+        }
+        stamp.SourceHash = HashBytes(Source.Data(), Source.Size());
+    }
+    return true;
+}
+
+bool
+TextureCache::Load(const std::string& cachePath, const std::string& sourcePath, TextureImage& image) {
+    Asset Cache;
+    if (!Cache.Open(cachePath) || Cache.Size() < sizeof(KTXHeader)) {
+        return false;
+    }
+
+    KTXHeader Header;
+    memcpy(&Header, Cache.Data(), sizeof(Header));
+    if (memcmp(Header.Identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) || Header.Endianness != KTX_ENDIANNESS
+        || Header.NumberOfFaces != 1 || Header.PixelDepth || Header.NumberOfArrayElements || !Header.NumberOfMipmapLevels) {
+        return false;
+    }
+
+    const unsigned char* Cursor = Cache.Data() + sizeof(Header);
+    const unsigned char* End = Cache.Data() + Cache.Size();
+    if ((size_t)(End - Cursor) < Header.BytesOfKeyValueData) {
+        return false;
+    }
+
+    // NOTE: Key/value pairs are a length, a null terminated key and the value, padded to 4 bytes
+    const unsigned char* KeyValueEnd = Cursor + Header.BytesOfKeyValueData;
+    bool HasStamp = false;
+    TextureCacheStamp CachedStamp;
+    while (KeyValueEnd - Cursor >= 4) {
+        uint32_t PairBytes;
+        memcpy(&PairBytes, Cursor, sizeof(PairBytes));
+        Cursor += sizeof(PairBytes);
+        if ((size_t)(KeyValueEnd - Cursor) < PairBytes) {
+            return false;
+        }
+        if (PairBytes == sizeof(STAMP_KEY) + sizeof(CachedStamp) && !memcmp(Cursor, STAMP_KEY, sizeof(STAMP_KEY))) {
+            memcpy(&CachedStamp, Cursor + sizeof(STAMP_KEY), sizeof(CachedStamp));
+            HasStamp = true;
+        }
+        Cursor += alignTo4(PairBytes);
+    }
+    Cursor = KeyValueEnd;
+    if (!HasStamp || CachedStamp.Version != TEXTURE_CACHE_VERSION) {
+        return false;
+    }
+
+    TextureCacheStamp SourceStamp;
+    if (stampSource(sourcePath, SourceStamp, false)) {
+        bool StampMatches = SourceStamp.SourceSize == CachedStamp.SourceSize && SourceStamp.SourceMTime == CachedStamp.SourceMTime;
+        if (!StampMatches && !(SourceStamp.SourceSize == CachedStamp.SourceSize && stampSource(sourcePath, SourceStamp, true)
+            && SourceStamp.SourceHash == CachedStamp.SourceHash)) {
+            std::cout << "[Info] " << sourcePath << " changed since it was compressed, rebuilding" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<unsigned> LevelSizes;
+    std::vector<unsigned char> Data;
+    for (unsigned LevelIdx = 0; LevelIdx < Header.NumberOfMipmapLevels; ++LevelIdx) {
+        uint32_t ImageSize;
+        if (End - Cursor < 4) {
+            return false;
+        }
+        memcpy(&ImageSize, Cursor, sizeof(ImageSize));
+        Cursor += sizeof(ImageSize);
+        if ((size_t)(End - Cursor) < ImageSize) {
+            std::cerr << "[Err] Texture cache " << cachePath << " is truncated" << std::endl;
+            return false;
+        }
+        LevelSizes.push_back(ImageSize);
+        Data.insert(Data.end(), Cursor, Cursor + ImageSize);
+        Cursor += alignTo4(ImageSize);
+    }
+
+    image.Width = Header.PixelWidth;
+    image.Height = Header.PixelHeight;
+    image.Channels = 0;
+    image.CompressedFormat = Header.GLInternalFormat;
+    image.LevelSizes.swap(LevelSizes);
+    image.LevelData.swap(Data);
+    return true;
+}
+
+bool
+TextureCache::Save(const std::string& cachePath, const std::string& sourcePath, const TextureImage& image) {
+    TextureCacheStamp Stamp;
+    if (!stampSource(sourcePath, Stamp, true)) {
+        std::cerr << "[Err] Failed to stamp texture cache, source " << sourcePath << " is unreadable" << std::endl;
+        return false;
+    }
+
+    uint32_t StampPairBytes = sizeof(STAMP_KEY) + sizeof(Stamp);
+    uint32_t OrientationPairBytes = sizeof(ORIENTATION_KEY) + sizeof(ORIENTATION_VALUE);
+    KTXHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    Header.Endianness = KTX_ENDIANNESS;
+    Header.GLTypeSize = 1;
+    Header.GLInternalFormat = image.CompressedFormat;
+    Header.GLBaseInternalFormat = baseInternalFormat(image.CompressedFormat);
+    Header.PixelWidth = image.Width;
+    Header.PixelHeight = image.Height;
+    Header.NumberOfFaces = 1;
+    Header.NumberOfMipmapLevels = image.LevelSizes.size();
+    Header.BytesOfKeyValueData = 4 + alignTo4(StampPairBytes) + 4 + alignTo4(OrientationPairBytes);
+
+    std::ofstream Out(cachePath, std::ios::binary | std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to open texture cache for writing: " << cachePath << std::endl;
+        return false;
+    }
+
+    const char Padding[4] = { 0 };
+    Out.write((const char*)&Header, sizeof(Header));
+    Out.write((const char*)&StampPairBytes, sizeof(StampPairBytes));
+    Out.write(STAMP_KEY, sizeof(STAMP_KEY));
+    Out.write((const char*)&Stamp, sizeof(Stamp));
+    Out.write(Padding, alignTo4(StampPairBytes) - StampPairBytes);
+    Out.write((const char*)&OrientationPairBytes, sizeof(OrientationPairBytes));
+    Out.write(ORIENTATION_KEY, sizeof(ORIENTATION_KEY));
+    Out.write(ORIENTATION_VALUE, sizeof(ORIENTATION_VALUE));
+    Out.write(Padding, alignTo4(OrientationPairBytes) - OrientationPairBytes);
+
+    const unsigned char* Level = image.LevelData.data();
+    for (unsigned LevelIdx = 0; LevelIdx < image.LevelSizes.size(); ++LevelIdx) {
+        uint32_t ImageSize = image.LevelSizes[LevelIdx];
+        Out.write((const char*)&ImageSize, sizeof(ImageSize));
+        Out.write((const char*)Level, ImageSize);
+        Out.write(Padding, alignTo4(ImageSize) - ImageSize);
+        Level += ImageSize;
+    }
+
+    if (!Out) {
+        std::cerr << "[Err] Failed to write texture cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file texturecache.hpp
+ * @brief On-disk cache of block compressed textures with all mip levels, stored as KTX 1.1
+ * next to the source image
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include "texture.hpp"
+
+#define TEXTURE_CACHE_EXTENSION ".ktx"
+// NOTE: Bump whenever the encoder or mip generation changes output
+#define TEXTURE_CACHE_VERSION 2
+
+struct KTXHeader {
+    unsigned char Identifier[12];
+    uint32_t Endianness;
+    uint32_t GLType;
+    uint32_t GLTypeSize;
+    uint32_t GLFormat;
+    uint32_t GLInternalFormat;
+    uint32_t GLBaseInternalFormat;
+    uint32_t PixelWidth;
+    uint32_t PixelHeight;
+    uint32_t PixelDepth;
+    uint32_t NumberOfArrayElements;
+    uint32_t NumberOfFaces;
+    uint32_t NumberOfMipmapLevels;
+    uint32_t BytesOfKeyValueData;
+};
+
+/**
+ * @brief Stored in the "CGBase.source" key, ties the cache to the exact source file
+ *
+ */
+struct TextureCacheStamp {
+    uint32_t Version;
+    uint32_t Reserved;
+    uint64_t SourceSize;
+    int64_t SourceMTime;
+    uint64_t SourceHash;
+};
+
+class TextureCache {
+public:
+    /**
+     * @brief Loads compressed levels if the cache exists and matches the source.
+     * Accepts a matching size and mtime, falls back to hashing the source when only the mtime differs
+     *
+     * @param cachePath Cache file path
+     * @param sourcePath Source image the cache was made from
+     * @param image Output, compressed fields and dimensions are filled in
+     *
+     * @returns true - Cache hit, false - Missing, stale or unreadable
+     */
+    static bool Load(const std::string& cachePath, const std::string& sourcePath, TextureImage& image);
+
+    /**
+     * @brief Writes the compressed levels of an image
+     *
+     * @param cachePath Cache file path
+     * @param sourcePath Source image, stamped into the cache
+     * @param image Image with compressed levels
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool Save(const std::string& cachePath, const std::string& sourcePath, const TextureImage& image);
+
+private:
+    static bool stampSource(const std::string& sourcePath, TextureCacheStamp& stamp, bool hash);
+};
@@ -0,0 +1,208 @@
+#include "textureregistry.hpp"
+#include <cctype>
+#include <vector>
+#include "glstate.hpp"
+
+TextureRegistry gTextureRegistry;
+
+TextureRegistry::TextureRegistry() {
+    mPathHits = 0;
+    mContentHits = 0;
+    mMisses = 0;
+    mBytesSaved = 0;
+}
+
+std::string
+TextureRegistry::canonicalPath(const std::string& filePath) {
+    // NOTE: Unify separators and drop "." and "dir/.." so one file always maps to one key
+    std::vector<std::string> Parts;
+    size_t Start = 0;
+    while (Start <= filePath.size()) {
+        size_t End = filePath.find_first_of("/\\", Start);
+        if (End == std::string::npos) {
+            End = filePath.size();
+        }
+
+        std::string Part = filePath.substr(Start, End - Start);
+        if (Part == ".." && !Parts.empty() && Parts.back() != "..") {
+            Parts.pop_back();
+        } else if (!Part.empty() && Part != ".") {
+            Parts.push_back(Part);
+        }
+        Start = End + 1;
+    }
+
+    std::string Canonical = !filePath.empty() && (filePath[0] == '/' || filePath[0] == '\\') ? "/" : "";
+    for (unsigned PartIdx = 0; PartIdx < Parts.size(); ++PartIdx) {
+        Canonical += (PartIdx ? "/" : "") + Parts[PartIdx];
+    }
+#ifdef _WIN32
+    // NOTE: Windows paths are case insensitive
+    for (unsigned CharIdx = 0; CharIdx < Canonical.size(); ++CharIdx) {
+        Canonical[CharIdx] = (char)tolower((unsigned char)Canonical[CharIdx]);
+    }
+#endif
+    return Canonical;
+}
+
+std::string
+TextureRegistry::pathKey(const std::string& filePath, bool srgb) {
+    // NOTE: The same file decoded as data has differently filtered mips
+    return srgb ? canonicalPath(filePath) : canonicalPath(filePath) + "|linear";
+}
+
+size_t
+TextureRegistry::textureBytes(const TextureImage& image) {
+    return image.LevelData.size();
+}
+
+unsigned
+TextureRegistry::acquireExisting(unsigned texture) {
+    Entry& Existing = mEntries[texture];
+    Existing.RefCount++;
+    mBytesSaved += Existing.Bytes;
+    return texture;
+}
+
+bool
+TextureRegistry::isSameImage(unsigned texture, const TextureImage& image) {
+    const Entry& Existing = mEntries[texture];
+    if (Existing.Width != image.Width || Existing.Height != image.Height || Existing.Channels != image.Channels
+        || Existing.CompressedFormat != image.CompressedFormat || Existing.LevelSizes != image.LevelSizes) {
+        return false;
+    }
+    // NOTE: The hash only narrows it down, a collision would hand out the wrong texture
+    return Texture::MatchesImage(texture, image);
+}
+
+bool
+TextureRegistry::Contains(const std::string& filePath, bool srgb) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    return mPathTextures.count(pathKey(filePath, srgb)) != 0;
+}
+
+unsigned
+TextureRegistry::Acquire(const std::string& filePath, bool srgb) {
+    if (Contains(filePath, srgb)) {
+        TextureImage Image;
+        Image.Path = filePath;
+        Image.SRGB = srgb;
+        return Acquire(Image);
+    }
+
+    TextureImage Image;
+    Texture::DecodeImage(filePath, Image, srgb);
+    unsigned Texture = Acquire(Image);
+    // NOTE: A failed decode comes back as the missing texture, remember the requested path too
+    std::lock_guard<std::mutex> Lock(mMutex);
+    if (Texture && !mPathTextures.count(pathKey(filePath, srgb))) {
+        mPathTextures[pathKey(filePath, srgb)] = Texture;
+    }
+    return Texture;
+}
+
+unsigned
+TextureRegistry::Acquire(TextureImage& image) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    std::string Path = pathKey(image.Path, image.SRGB);
+    if (image.Path.empty() && image.LevelData.empty()) {
+        return 0;
+    }
+
+    std::unordered_map<std::string, unsigned>::iterator PathIt = mPathTextures.find(Path);
+    if (PathIt != mPathTextures.end()) {
+        Texture::FreeImage(image);
+        mPathHits++;
+        return acquireExisting(PathIt->second);
+    }
+
+    if (image.LevelData.empty()) {
+        return 0;
+    }
+
+    std::unordered_map<uint64_t, unsigned>::iterator HashIt = mHashTextures.find(image.ContentHash);
+    if (HashIt != mHashTextures.end() && isSameImage(HashIt->second, image)) {
+        Texture::FreeImage(image);
+        mPathTextures[Path] = HashIt->second;
+        mContentHits++;
+        return acquireExisting(HashIt->second);
+    }
+
+    Entry NewEntry;
+    NewEntry.Path = Path;
+    NewEntry.ContentHash = image.ContentHash;
+    NewEntry.Bytes = textureBytes(image);
+    NewEntry.RefCount = 1;
+    NewEntry.Width = image.Width;
+    NewEntry.Height = image.Height;
+    NewEntry.Channels = image.Channels;
+    NewEntry.CompressedFormat = image.CompressedFormat;
+    NewEntry.LevelSizes = image.LevelSizes;
+    unsigned Texture = Texture::UploadImage(image);
+    if (!Texture) {
+        return 0;
+    }
+
+    mEntries[Texture] = NewEntry;
+    mPathTextures[Path] = Texture;
+    // NOTE: On a collision the first texture keeps the hash, the new one is only shared by path
+    if (!mHashTextures.count(NewEntry.ContentHash)) {
+        mHashTextures[NewEntry.ContentHash] = Texture;
+    }
+    mMisses++;
+    return Texture;
+}
+
+unsigned
+TextureRegistry::AcquireStreamed(const std::string& filePath, TextureStreamer& streamer, bool srgb) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    std::string Path = pathKey(filePath, srgb);
+    std::unordered_map<std::string, unsigned>::iterator PathIt = mPathTextures.find(Path);
+    if (PathIt != mPathTextures.end()) {
+        mPathHits++;
+        return acquireExisting(PathIt->second);
+    }
+
+    Entry NewEntry;
+    NewEntry.Path = Path;
+    NewEntry.ContentHash = 0;
+    NewEntry.Bytes = 0;
+    NewEntry.RefCount = 1;
+    NewEntry.Width = 0;
+    NewEntry.Height = 0;
+    NewEntry.Channels = 0;
+    NewEntry.CompressedFormat = 0;
+    unsigned Texture = streamer.Request(filePath, srgb);
+    mEntries[Texture] = NewEntry;
+    mPathTextures[Path] = Texture;
+    mMisses++;
+    return Texture;
+}
+
+void
+TextureRegistry::Release(unsigned texture) {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    std::unordered_map<unsigned, Entry>::iterator EntryIt = mEntries.find(texture);
+    if (EntryIt == mEntries.end() || --EntryIt->second.RefCount) {
+        return;
+    }
+
+    // NOTE: Several paths may alias one texture
+    for (std::unordered_map<std::string, unsigned>::iterator PathIt = mPathTextures.begin(); PathIt != mPathTextures.end();) {
+        PathIt = PathIt->second == texture ? mPathTextures.erase(PathIt) : ++PathIt;
+    }
+    std::unordered_map<uint64_t, unsigned>::iterator HashIt = mHashTextures.find(EntryIt->second.ContentHash);
+    if (HashIt != mHashTextures.end() && HashIt->second == texture) {
+        mHashTextures.erase(HashIt);
+    }
+    mEntries.erase(EntryIt);
+    gGLState.DeleteTexture(texture);
+}
+
+void
+TextureRegistry::PrintStats() {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    std::cout << "[Info] Texture registry: " << mEntries.size() << " textures, " << mMisses << " uploaded, "
+              << mPathHits << " path hits, " << mContentHits << " content hits, "
+              << mBytesSaved / 1024 << " KiB of uploads saved" << std::endl;
+}
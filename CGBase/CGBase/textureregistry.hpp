@@ -0,0 +1,109 @@
+/**
+ * @file textureregistry.hpp
+ * @brief Shared, reference counted GL textures. Deduplicates by canonical path and
+ * by the content hash of the decoded pixels, verified against the resident texture
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "texture.hpp"
+#include "texturestreamer.hpp"
+
+class TextureRegistry {
+public:
+    TextureRegistry();
+
+    /**
+     * @brief Returns the texture for an image file, decoding and uploading it only if
+     * neither the path nor identical pixels are already resident. Must run on the GL thread
+     *
+     * @param filePath Image file path
+     * @param srgb Whether the image holds sRGB colour, see Texture::DecodeImage
+     *
+     * @returns TextureID, 0 on failure. Release it when no longer used
+     */
+    unsigned Acquire(const std::string& filePath, bool srgb = true);
+
+    /**
+     * @brief Returns the texture for an already decoded image. Level data is freed either
+     * way. Must run on the GL thread
+     *
+     * @param image Decoded image, or an image with only Path set if Contains(Path) was true
+     *
+     * @returns TextureID, 0 if the image is empty and its path unknown
+     */
+    unsigned Acquire(TextureImage& image);
+
+    /**
+     * @brief Returns the texture for an image file without blocking. Unknown paths are
+     * queued on the streamer and share its placeholder handle. Streamed textures are only
+     * deduplicated by path, their pixels aren't seen until the streamer uploads them
+     *
+     * @param filePath Image file path
+     * @param streamer Streamer that decodes and uploads the file
+     * @param srgb Whether the image holds sRGB colour, see Texture::DecodeImage
+     *
+     * @returns TextureID. Release it when no longer used
+     */
+    unsigned AcquireStreamed(const std::string& filePath, TextureStreamer& streamer, bool srgb = true);
+
+    /**
+     * @brief Drops a reference, deleting the texture when the last one goes away
+     *
+     * @param texture TextureID returned by Acquire
+     */
+    void Release(unsigned texture);
+
+    /**
+     * @brief Checks for a resident path. Safe to call from worker threads to skip decoding
+     *
+     * @param filePath Image file path
+     * @param srgb Whether the image holds sRGB colour. Colour and data uses of one file are kept apart
+     *
+     * @returns true - Acquire(filePath, srgb) won't decode
+     */
+    bool Contains(const std::string& filePath, bool srgb = true);
+
+    /**
+     * @brief Prints resident texture count, hit/miss counts and upload bytes saved
+     *
+     */
+    void PrintStats();
+
+private:
+    struct Entry {
+        std::string Path;
+        uint64_t ContentHash;
+        size_t Bytes;
+        unsigned RefCount;
+        // NOTE: Compared before the pixels on a content hash hit
+        int Width;
+        int Height;
+        int Channels;
+        unsigned CompressedFormat;
+        std::vector<unsigned> LevelSizes;
+    };
+
+    std::mutex mMutex;
+    std::unordered_map<std::string, unsigned> mPathTextures;
+    std::unordered_map<uint64_t, unsigned> mHashTextures;
+    std::unordered_map<unsigned, Entry> mEntries;
+    unsigned mPathHits;
+    unsigned mContentHits;
+    unsigned mMisses;
+    size_t mBytesSaved;
+
+    unsigned acquireExisting(unsigned texture);
+    bool isSameImage(unsigned texture, const TextureImage& image);
+    static std::string canonicalPath(const std::string& filePath);
+    static std::string pathKey(const std::string& filePath, bool srgb);
+    static size_t textureBytes(const TextureImage& image);
+};
+
+extern TextureRegistry gTextureRegistry;
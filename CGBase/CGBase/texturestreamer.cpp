@@ -0,0 +1,295 @@
+#include "texturestreamer.hpp"
+#include <cstring>
+#include <utility>
+#include <iostream>
+#include "framestats.hpp"
+#include "glstate.hpp"
+
+// NOTE: Keeps every ring region aligned for any pixel type
+static const size_t RING_ALIGNMENT = 16;
+static const unsigned char PLACEHOLDER_PIXEL[4] = { 128, 128, 128, 255 };
+
+TextureStreamer::TextureStreamer(size_t ringBytes, size_t frameBudget) {
+    mRingBytes = ringBytes;
+    mFrameBudget = frameBudget;
+    mPBO = 0;
+    mMapped = 0;
+    mRingHead = 0;
+    mRingUsed = 0;
+    mStopping = false;
+    mPendingCount = 0;
+    mUploadedBytes = 0;
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mStopping = true;
+    }
+    mRingSpace.notify_all();
+    mWorkers.Wait();
+    for (std::list<Upload>::iterator UploadIt = mUploads.begin(); UploadIt != mUploads.end(); ++UploadIt) {
+        delete[] UploadIt->Pixels;
+    }
+}
+
+bool
+TextureStreamer::Init() {
+    if (!GLEW_ARB_buffer_storage) {
+        std::cout << "[Info] ARB_buffer_storage unavailable, textures stream from client memory" << std::endl;
+        return true;
+    }
+
+    glGenBuffers(1, &mPBO);
+    gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, mPBO);
+    GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, mRingBytes, 0, Flags);
+    mMapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mRingBytes, Flags);
+    gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!mMapped) {
+        std::cerr << "[Err] Failed to map texture streaming buffer" << std::endl;
+        gGLState.DeleteBuffer(mPBO);
+        mPBO = 0;
+        return false;
+    }
+
+    return true;
+}
+
+unsigned
+TextureStreamer::createPlaceholder() {
+    unsigned Texture;
+    glGenTextures(1, &Texture);
+    gGLState.BindTexture(0, GL_TEXTURE_2D, Texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_PIXEL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+    return Texture;
+}
+
+unsigned
+TextureStreamer::Request(const std::string& filePath, bool srgb) {
+    unsigned Texture = createPlaceholder();
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mPendingCount++;
+    }
+    mWorkers.Submit([this, filePath, Texture, srgb]() { decode(filePath, Texture, -1, 0, 0, srgb); });
+    return Texture;
+}
+
+void
+TextureStreamer::RequestLayer(const std::string& filePath, unsigned texture, unsigned layer, int width, int height, bool srgb) {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mPendingCount++;
+    }
+    mWorkers.Submit([this, filePath, texture, layer, width, height, srgb]() { decode(filePath, texture, layer, width, height, srgb); });
+}
+
+unsigned
+TextureStreamer::GetLayerFallback(unsigned texture, unsigned layer) const {
+    if (mLayerFallbacks.empty()) {
+        return 0;
+    }
+    std::map<std::pair<unsigned, unsigned>, unsigned>::const_iterator FallbackIt = mLayerFallbacks.find(std::make_pair(texture, layer));
+    return FallbackIt != mLayerFallbacks.end() ? FallbackIt->second : 0;
+}
+
+bool
+TextureStreamer::allocateRing(size_t size, size_t& offset, size_t& ringBytes) {
+    size = (size + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+    // NOTE: Nothing in flight, start over at the front instead of skipping the tail
+    if (!mRingUsed) {
+        mRingHead = 0;
+    }
+    offset = mRingHead;
+    ringBytes = size;
+    // NOTE: Regions are contiguous, skipping the tail of the ring counts as part of this region
+    if (offset + size > mRingBytes) {
+        // NOTE: Region plus tail won't fit until the ring drains completely, copy to the heap instead of waiting
+        if (size + (mRingBytes - offset) > mRingBytes) {
+            offset = 0;
+            ringBytes = 0;
+            return true;
+        }
+        ringBytes += mRingBytes - offset;
+        offset = 0;
+    }
+    if (mRingUsed + ringBytes > mRingBytes) {
+        return false;
+    }
+
+    mRingHead = offset + size;
+    mRingUsed += ringBytes;
+    return true;
+}
+
+void
+TextureStreamer::decode(const std::string& filePath, unsigned texture, int layer, int width, int height, bool srgb) {
+    Upload Decoded;
+    Decoded.Texture = texture;
+    Decoded.Layer = layer;
+    Decoded.Offset = 0;
+    Decoded.RingBytes = 0;
+    Decoded.Pixels = 0;
+    Decoded.Ready = false;
+    bool Success = Texture::DecodeImage(filePath, Decoded.Image, srgb, width, height);
+    TextureImage& Image = Decoded.Image;
+    Decoded.Bytes = Image.LevelData.size();
+
+    std::unique_lock<std::mutex> Lock(mMutex);
+    if (Success && mMapped && Decoded.Bytes <= mRingBytes) {
+        while (!mStopping && !allocateRing(Decoded.Bytes, Decoded.Offset, Decoded.RingBytes)) {
+            mRingSpace.wait(Lock);
+        }
+    }
+    if (!Success || mStopping) {
+        // NOTE: Leaves the placeholder in place
+        mPendingCount--;
+        Lock.unlock();
+        Texture::FreeImage(Image);
+        return;
+    }
+
+    // NOTE: Queued under the lock that allocated the region, keeping allocation order
+    mUploads.push_back(std::move(Decoded));
+    Upload& Queued = mUploads.back();
+    Lock.unlock();
+
+    unsigned char* Destination = Queued.RingBytes ? mMapped + Queued.Offset : new unsigned char[Queued.Bytes];
+    memcpy(Destination, Queued.Image.LevelData.data(), Queued.Bytes);
+
+    Lock.lock();
+    Texture::FreeImage(Queued.Image);
+    Queued.Pixels = Queued.RingBytes ? 0 : Destination;
+    Queued.Ready = true;
+}
+
+void
+TextureStreamer::retireFinished(bool wait) {
+    while (!mRetirements.empty()) {
+        GLenum Status = glClientWaitSync(mRetirements.front().Fence, 0, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (Status != GL_ALREADY_SIGNALED && Status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        glDeleteSync(mRetirements.front().Fence);
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            mRingUsed -= mRetirements.front().RingBytes;
+        }
+        mRetirements.pop_front();
+        mRingSpace.notify_all();
+    }
+}
+
+void
+TextureStreamer::Update() {
+    retireFinished(false);
+
+    size_t UploadedBytes = 0;
+    size_t RetiredRingBytes = 0;
+    bool Finished = false;
+    if (mPBO) {
+        gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, mPBO);
+    }
+    while (UploadedBytes < mFrameBudget) {
+        Upload Current;
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            if (mUploads.empty() || !mUploads.front().Ready) {
+                break;
+            }
+            Current = mUploads.front();
+            mUploads.pop_front();
+        }
+
+        // NOTE: Regions that don't fit the ring come from client memory, which needs the PBO unbound
+        if (mPBO && !Current.RingBytes) {
+            gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        const TextureImage& Image = Current.Image;
+        const unsigned char* Source = Current.RingBytes ? (const unsigned char*)Current.Offset : Current.Pixels;
+        if (Current.Layer < 0) {
+            // NOTE: The placeholder level is mutable, so immutable storage may still replace it
+            gGLState.BindTexture(0, GL_TEXTURE_2D, Current.Texture);
+            Texture::UploadLevels(Image, Source);
+        } else {
+            GLint ArrayFormat = 0;
+            gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, Current.Texture);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_INTERNAL_FORMAT, &ArrayFormat);
+            GLenum ImageFormat = Image.CompressedFormat ? Image.CompressedFormat : Texture::GetInternalFormat(Image.Channels);
+            bool FitsArray = (GLenum)ArrayFormat == ImageFormat;
+            if (FitsArray) {
+                Texture::UploadLayer(Image, Current.Layer, Source);
+            }
+            gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+            // NOTE: A fallback image may not fit the array, it gets a 2D texture of its own instead
+            if (!FitsArray) {
+                std::cout << "[Info] Texture " << Image.Path << " doesn't match its array format, streamed as a standalone texture" << std::endl;
+                unsigned Standalone = createPlaceholder();
+                gGLState.BindTexture(0, GL_TEXTURE_2D, Standalone);
+                Texture::UploadLevels(Image, Source);
+                mLayerFallbacks[std::make_pair(Current.Texture, (unsigned)Current.Layer)] = Standalone;
+            }
+        }
+        if (mPBO && !Current.RingBytes) {
+            gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, mPBO);
+        }
+
+        delete[] Current.Pixels;
+        UploadedBytes += Current.Bytes;
+        RetiredRingBytes += Current.RingBytes;
+        std::lock_guard<std::mutex> Lock(mMutex);
+        Finished = !--mPendingCount;
+    }
+    mUploadedBytes += UploadedBytes;
+    // NOTE: Logged once the loop let go of the lock, decode workers wait on it
+    if (Finished) {
+        std::cout << "[Info] Texture streaming done, " << mUploadedBytes / 1024 << " KiB uploaded" << std::endl;
+    }
+    gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+    if (mPBO) {
+        gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // NOTE: One fence covers every region read this frame
+    if (RetiredRingBytes) {
+        Retirement Batch = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), RetiredRingBytes };
+        mRetirements.push_back(Batch);
+    }
+    gFrameStats.TextureBytesStreamed += UploadedBytes;
+}
+
+unsigned
+TextureStreamer::GetPendingCount() {
+    std::lock_guard<std::mutex> Lock(mMutex);
+    return mPendingCount;
+}
+
+void
+TextureStreamer::Shutdown() {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mStopping = true;
+    }
+    mRingSpace.notify_all();
+    mWorkers.Wait();
+    retireFinished(true);
+    if (mPBO) {
+        gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, mPBO);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        gGLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        gGLState.DeleteBuffer(mPBO);
+        mPBO = 0;
+        mMapped = 0;
+    }
+    for (std::map<std::pair<unsigned, unsigned>, unsigned>::iterator FallbackIt = mLayerFallbacks.begin(); FallbackIt != mLayerFallbacks.end(); ++FallbackIt) {
+        gGLState.DeleteTexture(FallbackIt->second);
+    }
+    mLayerFallbacks.clear();
+}
@@ -0,0 +1,144 @@
+/**
+ * @file texturestreamer.hpp
+ * @brief Asynchronous texture loading. Workers decode (or read the compressed cache) straight into a persistently mapped
+ * pixel unpack ring buffer, the GL thread uploads from it under a per-frame byte budget
+ *
+ */
+
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <GL/glew.h>
+#include "threadpool.hpp"
+#include "texture.hpp"
+
+#define TEXTURE_STREAMER_RING_BYTES (64u << 20)
+#define TEXTURE_STREAMER_FRAME_BUDGET (8u << 20)
+
+class TextureStreamer {
+public:
+    /**
+     * @brief Ctor - starts the decode workers. Call Init on the GL thread before requesting
+     *
+     * @param ringBytes Size of the pixel unpack ring buffer
+     * @param frameBudget Bytes uploaded per Update, at least one texture always goes through
+     */
+    TextureStreamer(size_t ringBytes = TEXTURE_STREAMER_RING_BYTES, size_t frameBudget = TEXTURE_STREAMER_FRAME_BUDGET);
+
+    /**
+     * @brief Dtor - stops the workers. Doesn't touch GL, call Shutdown while the context is alive
+     *
+     */
+    ~TextureStreamer();
+
+    /**
+     * @brief Creates the ring buffer. Persistently mapped if ARB_buffer_storage is available,
+     * otherwise workers decode to client memory and Update uploads from there
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Init();
+
+    /**
+     * @brief Queues an image file for streaming. Must run on the GL thread
+     *
+     * @param filePath Image file path
+     * @param srgb Whether the image holds sRGB colour, see Texture::DecodeImage
+     *
+     * @returns TextureID, usable right away. Samples as a 1x1 placeholder until its upload is done
+     */
+    unsigned Request(const std::string& filePath, bool srgb = true);
+
+    /**
+     * @brief Queues an image file for streaming into one layer of a texture array created with
+     * Texture::CreateArray. The image is resampled to the layer size on the worker. Must run on the GL thread
+     *
+     * @param filePath Image file path
+     * @param texture Texture array
+     * @param layer Array layer
+     * @param width Layer width
+     * @param height Layer height
+     * @param srgb Whether the image holds sRGB colour, see Texture::DecodeImage
+     */
+    void RequestLayer(const std::string& filePath, unsigned texture, unsigned layer, int width, int height, bool srgb = true);
+
+    /**
+     * @brief Returns the standalone 2D texture a layer's image went to because it didn't match
+     * the array's format, e.g. a missing texture decoded in place of an unreadable file
+     *
+     * @param texture Texture array
+     * @param layer Array layer
+     *
+     * @returns TextureID, 0 while the layer is in the array
+     */
+    unsigned GetLayerFallback(unsigned texture, unsigned layer) const;
+
+    /**
+     * @brief Uploads decoded textures within the frame budget and recycles ring space
+     * the GPU is done reading. Call once per frame on the GL thread
+     *
+     */
+    void Update();
+
+    /**
+     * @brief Returns number of requested textures that aren't uploaded yet
+     *
+     * @returns Pending texture count
+     */
+    unsigned GetPendingCount();
+
+    /**
+     * @brief Drops pending work and frees GL objects. Must run on the GL thread
+     *
+     */
+    void Shutdown();
+
+private:
+    struct Upload {
+        unsigned Texture;
+        // NOTE: Array layer, -1 for 2D textures
+        int Layer;
+        // NOTE: Dimensions and format only, the data lives in the ring or in Pixels
+        TextureImage Image;
+        size_t Bytes;
+        // NOTE: Ring region, or client memory when the ring isn't persistently mapped
+        size_t Offset;
+        size_t RingBytes;
+        unsigned char* Pixels;
+        bool Ready;
+    };
+
+    struct Retirement {
+        GLsync Fence;
+        size_t RingBytes;
+    };
+
+    size_t mRingBytes;
+    size_t mFrameBudget;
+    unsigned mPBO;
+    unsigned char* mMapped;
+    size_t mRingHead;
+    size_t mRingUsed;
+    bool mStopping;
+    unsigned mPendingCount;
+    size_t mUploadedBytes;
+    // NOTE: Uploads in ring allocation order, so ring space is retired first in first out
+    std::list<Upload> mUploads;
+    // NOTE: (array, layer) to the 2D texture holding its image. Only touched on the GL thread
+    std::map<std::pair<unsigned, unsigned>, unsigned> mLayerFallbacks;
+    std::deque<Retirement> mRetirements;
+    std::mutex mMutex;
+    std::condition_variable mRingSpace;
+    ThreadPool mWorkers;
+
+    static unsigned createPlaceholder();
+    void decode(const std::string& filePath, unsigned texture, int layer, int width, int height, bool srgb);
+    // NOTE: false - wait for ring space, true with ringBytes 0 - use a heap copy
+    bool allocateRing(size_t size, size_t& offset, size_t& ringBytes);
+    void retireFinished(bool wait);
+};
@@ -0,0 +1,75 @@
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    mActiveJobs = 0;
+    mStopping = false;
+    if (!threadCount) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (!threadCount) {
+        threadCount = 1;
+    }
+
+    mWorkers.reserve(threadCount);
+    for (unsigned ThreadIdx = 0; ThreadIdx < threadCount; ++ThreadIdx) {
+        mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mStopping = true;
+    }
+    mJobAvailable.notify_all();
+    for (unsigned ThreadIdx = 0; ThreadIdx < mWorkers.size(); ++ThreadIdx) {
+        mWorkers[ThreadIdx].join();
+    }
+}
+
+void
+ThreadPool::Submit(const std::function<void()>& job) {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mJobs.push_back(job);
+    }
+    mJobAvailable.notify_one();
+}
+
+void
+ThreadPool::Wait() {
+    std::unique_lock<std::mutex> Lock(mMutex);
+    mJobsDone.wait(Lock, [this] { return mJobs.empty() && mActiveJobs == 0; });
+}
+
+unsigned
+ThreadPool::GetThreadCount() const {
+    return mWorkers.size();
+}
+
+void
+ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> Job;
+        {
+            std::unique_lock<std::mutex> Lock(mMutex);
+            mJobAvailable.wait(Lock, [this] { return mStopping || !mJobs.empty(); });
+            if (mJobs.empty()) {
+                return;
+            }
+            Job = mJobs.front();
+            mJobs.pop_front();
+            ++mActiveJobs;
+        }
+
+        Job();
+
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            --mActiveJobs;
+            if (mJobs.empty() && mActiveJobs == 0) {
+                mJobsDone.notify_all();
+            }
+        }
+    }
+}
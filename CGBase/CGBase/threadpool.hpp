@@ -0,0 +1,60 @@
+/**
+ * @file threadpool.hpp
+ * @brief Fixed size worker pool for CPU side loading work
+ *
+ */
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    /**
+     * @brief Ctor - spawns worker threads
+     *
+     * @param threadCount Number of workers, 0 uses one per hardware thread
+     */
+    ThreadPool(unsigned threadCount = 0);
+
+    /**
+     * @brief Dtor - finishes queued jobs and joins the workers
+     *
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Queues a job. Jobs must not touch GL, there is no context on the workers
+     *
+     * @param job Job to run
+     */
+    void Submit(const std::function<void()>& job);
+
+    /**
+     * @brief Blocks until every submitted job has finished
+     *
+     */
+    void Wait();
+
+    /**
+     * @brief Returns number of worker threads
+     *
+     * @returns Worker count
+     */
+    unsigned GetThreadCount() const;
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::deque<std::function<void()> > mJobs;
+    std::mutex mMutex;
+    std::condition_variable mJobAvailable;
+    std::condition_variable mJobsDone;
+    unsigned mActiveJobs;
+    bool mStopping;
+
+    void workerLoop();
+};
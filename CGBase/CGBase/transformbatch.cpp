@@ -0,0 +1,92 @@
+#include "transformbatch.hpp"
+#include "simd.hpp"
+
+void
+TransformBatch::Clear() {
+    mTransforms.clear();
+}
+
+unsigned
+TransformBatch::Add(const glm::mat4& model) {
+    ObjectTransform Transform;
+    Transform.Model = model;
+    mTransforms.push_back(Transform);
+    return mTransforms.size() - 1;
+}
+
+#ifdef CG_SSE2
+/**
+ * @brief Cross product of the xyz lanes, w stays 0 when both inputs have w 0
+ *
+ */
+static inline __m128
+crossSSE(__m128 a, __m128 b) {
+    __m128 AYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 BYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 C = _mm_sub_ps(_mm_mul_ps(a, BYZX), _mm_mul_ps(AYZX, b));
+    return _mm_shuffle_ps(C, C, _MM_SHUFFLE(3, 0, 2, 1));
+}
+#endif
+
+void
+TransformBatch::Compute(const glm::mat4& viewProjection) {
+    unsigned Count = mTransforms.size();
+#ifdef CG_SSE2
+    __m128 VP[4];
+    for (unsigned ColumnIdx = 0; ColumnIdx < 4; ++ColumnIdx) {
+        VP[ColumnIdx] = _mm_loadu_ps(&viewProjection[ColumnIdx][0]);
+    }
+    const __m128 XYZMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+    for (unsigned ObjectIdx = 0; ObjectIdx < Count; ++ObjectIdx) {
+        ObjectTransform& Transform = mTransforms[ObjectIdx];
+        __m128 M[4];
+        for (unsigned ColumnIdx = 0; ColumnIdx < 4; ++ColumnIdx) {
+            M[ColumnIdx] = _mm_loadu_ps(&Transform.Model[ColumnIdx][0]);
+        }
+
+        // NOTE: Each MVP column is VP times the model column, a sum of broadcast products
+        for (unsigned ColumnIdx = 0; ColumnIdx < 4; ++ColumnIdx) {
+            __m128 C = M[ColumnIdx];
+            __m128 R = _mm_mul_ps(VP[0], _mm_shuffle_ps(C, C, _MM_SHUFFLE(0, 0, 0, 0)));
+            R = _mm_add_ps(R, _mm_mul_ps(VP[1], _mm_shuffle_ps(C, C, _MM_SHUFFLE(1, 1, 1, 1))));
+            R = _mm_add_ps(R, _mm_mul_ps(VP[2], _mm_shuffle_ps(C, C, _MM_SHUFFLE(2, 2, 2, 2))));
+            R = _mm_add_ps(R, _mm_mul_ps(VP[3], _mm_shuffle_ps(C, C, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(&Transform.MVP[ColumnIdx][0], R);
+        }
+
+        // NOTE: The inverse transpose of a 3x3 is its cofactor matrix over the determinant,
+        // and the cofactor columns are cross products of the other two columns
+        __m128 A0 = _mm_and_ps(M[0], XYZMask);
+        __m128 A1 = _mm_and_ps(M[1], XYZMask);
+        __m128 A2 = _mm_and_ps(M[2], XYZMask);
+        __m128 C0 = crossSSE(A1, A2);
+        __m128 C1 = crossSSE(A2, A0);
+        __m128 C2 = crossSSE(A0, A1);
+        __m128 Det = _mm_mul_ps(A0, C0);
+        Det = _mm_add_ps(Det, _mm_shuffle_ps(Det, Det, _MM_SHUFFLE(2, 3, 0, 1)));
+        Det = _mm_add_ps(Det, _mm_shuffle_ps(Det, Det, _MM_SHUFFLE(1, 0, 3, 2)));
+        __m128 InvDet = _mm_div_ps(_mm_set1_ps(1.0f), Det);
+        _mm_storeu_ps(&Transform.Normal[0][0], _mm_mul_ps(C0, InvDet));
+        _mm_storeu_ps(&Transform.Normal[1][0], _mm_mul_ps(C1, InvDet));
+        _mm_storeu_ps(&Transform.Normal[2][0], _mm_mul_ps(C2, InvDet));
+        _mm_storeu_ps(&Transform.Normal[3][0], _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+    }
+#else
+    for (unsigned ObjectIdx = 0; ObjectIdx < Count; ++ObjectIdx) {
+        ObjectTransform& Transform = mTransforms[ObjectIdx];
+        Transform.MVP = viewProjection * Transform.Model;
+        Transform.Normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(Transform.Model))));
+    }
+#endif
+}
+
+const ObjectTransform&
+TransformBatch::Get(unsigned index) const {
+    return mTransforms[index];
+}
+
+unsigned
+TransformBatch::GetCount() const {
+    return mTransforms.size();
+}
@@ -0,0 +1,66 @@
+/**
+ * @file transformbatch.hpp
+ * @brief Per-object transforms of a frame. Model-view-projection and normal matrices are
+ * computed once per object on the CPU instead of per vertex in the shaders
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Ready-made matrices of one object, what the vertex shader receives per draw
+ *
+ */
+struct ObjectTransform {
+    glm::mat4 Model;
+    glm::mat4 MVP;
+    // NOTE: Inverse transpose of the upper 3x3 of Model, the fourth row and column are unused
+    glm::mat4 Normal;
+};
+
+/**
+ * @brief Collects the model matrices of a frame and computes the derived matrices of all
+ * of them in one pass over contiguous storage
+ *
+ */
+class TransformBatch {
+public:
+    /**
+     * @brief Removes all objects, keeps the storage
+     *
+     */
+    void Clear();
+
+    /**
+     * @brief Adds an object. Its derived matrices are valid after the next Compute
+     *
+     * @param model Model matrix
+     * @returns Index of the object for Get
+     */
+    unsigned Add(const glm::mat4& model);
+
+    /**
+     * @brief Computes MVP and normal matrices of every object, SSE when available
+     *
+     * @param viewProjection Projection * View of the frame
+     */
+    void Compute(const glm::mat4& viewProjection);
+
+    /**
+     * @brief Returns the transform of an object
+     *
+     * @param index Index returned by Add
+     */
+    const ObjectTransform& Get(unsigned index) const;
+
+    /**
+     * @brief Returns the number of objects
+     *
+     */
+    unsigned GetCount() const;
+
+private:
+    std::vector<ObjectTransform> mTransforms;
+};
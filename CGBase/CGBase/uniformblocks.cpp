@@ -0,0 +1,173 @@
+#include "uniformblocks.hpp"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "framestats.hpp"
+#include "glstate.hpp"
+
+static const char* sBlockNames[] = { "CameraBlock", "LightsBlock", "MaterialBlock" };
+static const GLuint sBlockBindings[] = { UNIFORM_BINDING_CAMERA, UNIFORM_BINDING_LIGHTS, UNIFORM_BINDING_MATERIAL };
+
+UniformBlocks::UniformBlocks() {
+    mBuffer = 0;
+    mDirty = 0;
+    mBufferSize = 0;
+    memset(mOffsets, 0, sizeof(mOffsets));
+    memset((void*)&mCamera, 0, sizeof(mCamera));
+    memset((void*)&mLights, 0, sizeof(mLights));
+    memset((void*)&mMaterial, 0, sizeof(mMaterial));
+}
+
+const void*
+UniformBlocks::blockData(unsigned block) const {
+    switch (block) {
+    case BLOCK_CAMERA: return &mCamera;
+    case BLOCK_LIGHTS: return &mLights;
+    default: return &mMaterial;
+    }
+}
+
+size_t
+UniformBlocks::blockSize(unsigned block) {
+    switch (block) {
+    case BLOCK_CAMERA: return sizeof(CameraBlock);
+    case BLOCK_LIGHTS: return sizeof(LightsBlock);
+    default: return sizeof(MaterialBlock);
+    }
+}
+
+bool
+UniformBlocks::Create() {
+    GLint OffsetAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &OffsetAlignment);
+    mBufferSize = 0;
+    for (unsigned BlockIdx = 0; BlockIdx < BLOCK_COUNT; ++BlockIdx) {
+        mOffsets[BlockIdx] = mBufferSize;
+        mBufferSize = (mBufferSize + blockSize(BlockIdx) + OffsetAlignment - 1) / OffsetAlignment * OffsetAlignment;
+    }
+
+    glGenBuffers(1, &mBuffer);
+    if (!mBuffer) {
+        std::cerr << "[Err] Failed to create uniform buffer" << std::endl;
+        return false;
+    }
+    gGLState.BindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, mBufferSize, 0, GL_DYNAMIC_DRAW);
+    // NOTE: Ranged binds also set the generic binding, mBuffer stays bound there
+    for (unsigned BlockIdx = 0; BlockIdx < BLOCK_COUNT; ++BlockIdx) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, sBlockBindings[BlockIdx], mBuffer, mOffsets[BlockIdx], blockSize(BlockIdx));
+    }
+    mDirty = (1u << BLOCK_COUNT) - 1;
+    return true;
+}
+
+void
+UniformBlocks::Destroy() {
+    gGLState.DeleteBuffer(mBuffer);
+    mBuffer = 0;
+}
+
+CameraBlock&
+UniformBlocks::EditCamera() {
+    mDirty |= 1u << BLOCK_CAMERA;
+    return mCamera;
+}
+
+LightsBlock&
+UniformBlocks::EditLights() {
+    mDirty |= 1u << BLOCK_LIGHTS;
+    return mLights;
+}
+
+MaterialBlock&
+UniformBlocks::EditMaterial() {
+    mDirty |= 1u << BLOCK_MATERIAL;
+    return mMaterial;
+}
+
+const CameraBlock&
+UniformBlocks::GetCamera() const {
+    return mCamera;
+}
+
+const LightsBlock&
+UniformBlocks::GetLights() const {
+    return mLights;
+}
+
+void
+UniformBlocks::setBlock(unsigned block, void* current, const void* value) {
+    if (!memcmp(current, value, blockSize(block))) {
+        return;
+    }
+    memcpy(current, value, blockSize(block));
+    mDirty |= 1u << block;
+}
+
+void
+UniformBlocks::SetCamera(const CameraBlock& camera) {
+    setBlock(BLOCK_CAMERA, &mCamera, &camera);
+}
+
+void
+UniformBlocks::SetLights(const LightsBlock& lights) {
+    setBlock(BLOCK_LIGHTS, &mLights, &lights);
+}
+
+void
+UniformBlocks::Upload() {
+    if (!mDirty || !mBuffer) {
+        return;
+    }
+
+    // NOTE: One update spanning the first to the last dirty block. Clean blocks in
+    // between go along with their unchanged contents, still cheaper than a second call
+    unsigned First = BLOCK_COUNT;
+    unsigned Last = 0;
+    for (unsigned BlockIdx = 0; BlockIdx < BLOCK_COUNT; ++BlockIdx) {
+        if (mDirty & (1u << BlockIdx)) {
+            First = First == BLOCK_COUNT ? BlockIdx : First;
+            Last = BlockIdx;
+        }
+    }
+
+    size_t Begin = mOffsets[First];
+    size_t End = mOffsets[Last] + blockSize(Last);
+    mStaging.assign(End - Begin, 0);
+    for (unsigned BlockIdx = First; BlockIdx <= Last; ++BlockIdx) {
+        memcpy(mStaging.data() + mOffsets[BlockIdx] - Begin, blockData(BlockIdx), blockSize(BlockIdx));
+    }
+
+    gGLState.BindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, Begin, mStaging.size(), mStaging.data());
+    gFrameStats.UniformBufferUpdates++;
+    gFrameStats.UniformBufferBytes += mStaging.size();
+    mDirty = 0;
+}
+
+void
+UniformBlocks::BindProgram(GLuint program) {
+    for (unsigned BlockIdx = 0; BlockIdx < BLOCK_COUNT; ++BlockIdx) {
+        GLuint BlockIndex = glGetUniformBlockIndex(program, sBlockNames[BlockIdx]);
+        if (BlockIndex != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, BlockIndex, sBlockBindings[BlockIdx]);
+        }
+    }
+}
+
+float
+UniformBlocks::AttenuationRange(float kc, float kl, float kq, float intensity) {
+    // NOTE: Solves intensity / (kc + kl * d + kq * d^2) = 1 / 256 for d
+    float C = kc - 256.0f * intensity;
+    if (C >= 0.0f) {
+        return 0.0f;
+    }
+    if (kq > 0.0f) {
+        return (-kl + std::sqrt(kl * kl - 4.0f * kq * C)) / (2.0f * kq);
+    }
+    if (kl > 0.0f) {
+        return -C / kl;
+    }
+    return FLT_MAX;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file uniformblocks.hpp
+ * @brief std140 uniform blocks shared by every program. The C++ structs mirror the
+ * GLSL blocks byte for byte, the static_asserts catch layout drift at compile time
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// NOTE: Fixed binding points, Shader binds any of the named blocks it finds after linking
+#define UNIFORM_BINDING_CAMERA 0
+#define UNIFORM_BINDING_LIGHTS 1
+#define UNIFORM_BINDING_MATERIAL 2
+
+// NOTE: Light array capacities, must match MAX_* in shaders/lighting.glsl
+#define LIGHTS_MAX_POINT_LIGHTS 4
+#define LIGHTS_MAX_SPOTLIGHTS 2
+
+// NOTE: std140 aligns vec3 to 16 bytes. Scalars fill the gap after a vec3,
+// structs and arrays are rounded up to 16 bytes
+
+struct CameraBlock {
+    glm::mat4 View;
+    glm::mat4 Projection;
+    glm::vec3 Position;
+    float Pad0;
+};
+
+struct PositionalLightBlock {
+    glm::vec3 Position;
+    float Kc;
+    glm::vec3 Ka;
+    float Kl;
+    glm::vec3 Kd;
+    float Kq;
+    glm::vec3 Ks;
+    float Range;
+};
+
+// NOTE: Also used for spotlights. Direction must be unit length
+struct DirectionalLightBlock {
+    glm::vec3 Position;
+    float Kc;
+    glm::vec3 Direction;
+    float Kl;
+    glm::vec3 Ka;
+    float Kq;
+    glm::vec3 Kd;
+    float InnerCutOff;
+    glm::vec3 Ks;
+    float OuterCutOff;
+    float Range;
+    float Intensity;
+    float Pad0[2];
+};
+
+struct LightsBlock {
+    DirectionalLightBlock DirLight;
+    PositionalLightBlock PointLights[LIGHTS_MAX_POINT_LIGHTS];
+    DirectionalLightBlock Spotlights[LIGHTS_MAX_SPOTLIGHTS];
+};
+
+// NOTE: Kd and Ks color untextured permutations
+struct MaterialBlock {
+    glm::vec3 Kd;
+    float Shininess;
+    glm::vec3 Ks;
+    float Pad0;
+};
+
+static_assert(offsetof(CameraBlock, Projection) == 64 && offsetof(CameraBlock, Position) == 128 && sizeof(CameraBlock) == 144, "CameraBlock doesn't match std140");
+static_assert(offsetof(PositionalLightBlock, Kc) == 12 && offsetof(PositionalLightBlock, Kq) == 44 && offsetof(PositionalLightBlock, Ks) == 48
+              && offsetof(PositionalLightBlock, Range) == 60
+              && sizeof(PositionalLightBlock) == 64, "PositionalLightBlock doesn't match std140");
+static_assert(offsetof(DirectionalLightBlock, Direction) == 16 && offsetof(DirectionalLightBlock, OuterCutOff) == 76
+              && offsetof(DirectionalLightBlock, Intensity) == 84 && sizeof(DirectionalLightBlock) == 96, "DirectionalLightBlock doesn't match std140");
+static_assert(offsetof(LightsBlock, PointLights) == 96 && offsetof(LightsBlock, Spotlights) == 96 + 64 * LIGHTS_MAX_POINT_LIGHTS
+              && sizeof(LightsBlock) == 96 + 64 * LIGHTS_MAX_POINT_LIGHTS + 96 * LIGHTS_MAX_SPOTLIGHTS, "LightsBlock doesn't match std140");
+static_assert(offsetof(MaterialBlock, Shininess) == 12 && offsetof(MaterialBlock, Ks) == 16 && sizeof(MaterialBlock) == 32, "MaterialBlock doesn't match std140");
+
+/**
+ * @brief Owns one uniform buffer holding all shared blocks at aligned offsets. Blocks are
+ * edited on a CPU copy, Upload sends the changed ones with a single glBufferSubData
+ *
+ */
+class UniformBlocks {
+public:
+    UniformBlocks();
+
+    /**
+     * @brief Creates the buffer and binds each block range to its binding point
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Create();
+
+    /**
+     * @brief Deletes the buffer
+     *
+     */
+    void Destroy();
+
+    /**
+     * @brief Returns the camera block for writing and marks it dirty
+     *
+     */
+    CameraBlock& EditCamera();
+
+    /**
+     * @brief Returns the lights block for writing and marks it dirty
+     *
+     */
+    LightsBlock& EditLights();
+
+    /**
+     * @brief Returns the material block for writing and marks it dirty
+     *
+     */
+    MaterialBlock& EditMaterial();
+
+    /**
+     * @brief Returns the current camera block, for per-frame updates through SetCamera
+     *
+     */
+    const CameraBlock& GetCamera() const;
+
+    /**
+     * @brief Returns the current lights block, for per-frame updates through SetLights
+     *
+     */
+    const LightsBlock& GetLights() const;
+
+    /**
+     * @brief Replaces the camera block, marking it dirty only if any byte changed
+     *
+     * @param camera New contents, best copied from GetCamera so the padding matches
+     */
+    void SetCamera(const CameraBlock& camera);
+
+    /**
+     * @brief Replaces the lights block, marking it dirty only if any byte changed
+     *
+     * @param lights New contents, best copied from GetLights so the padding matches
+     */
+    void SetLights(const LightsBlock& lights);
+
+    /**
+     * @brief Uploads the dirty blocks, nothing if none changed. Call before the draws that read them
+     *
+     */
+    void Upload();
+
+    /**
+     * @brief Points the shared blocks a program declares at their binding points
+     *
+     * @param program Linked program
+     */
+    static void BindProgram(GLuint program);
+
+    /**
+     * @brief Distance at which a light's attenuation falls under 1/256, written to the
+     * light's Range so the shader skips fragments it can't visibly reach
+     *
+     * @param kc Constant attenuation factor
+     * @param kl Linear attenuation factor
+     * @param kq Quadratic attenuation factor
+     * @param intensity Attenuation numerator, 1 for point lights
+     * @returns Light range, unbounded if the light never falls off
+     */
+    static float AttenuationRange(float kc, float kl, float kq, float intensity = 1.0f);
+
+private:
+    enum Block {
+        BLOCK_CAMERA = 0,
+        BLOCK_LIGHTS,
+        BLOCK_MATERIAL,
+        BLOCK_COUNT
+    };
+
+    GLuint mBuffer;
+    unsigned mDirty;
+    size_t mOffsets[BLOCK_COUNT];
+    size_t mBufferSize;
+    CameraBlock mCamera;
+    LightsBlock mLights;
+    MaterialBlock mMaterial;
+    std::vector<unsigned char> mStaging;
+
+    const void* blockData(unsigned block) const;
+    void setBlock(unsigned block, void* current, const void* value);
+    static size_t blockSize(unsigned block);
+};